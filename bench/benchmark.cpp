@@ -0,0 +1,291 @@
+#include "benchmark.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+namespace ImageProcessing {
+namespace bench {
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+Result summarise(const std::string& name, uint64_t pixels, uint64_t bytes, std::vector<double> samples) {
+    Result result;
+    result.name = name;
+    result.pixels = pixels;
+    result.bytes = bytes;
+    result.samples = static_cast<int>(samples.size());
+    if (samples.empty()) return result;
+
+    std::sort(samples.begin(), samples.end());
+    size_t mid = samples.size() / 2;
+    result.median_ms = (samples.size() % 2) ? samples[mid] : 0.5 * (samples[mid - 1] + samples[mid]);
+    result.min_ms = samples.front();
+
+    double sum = 0.0;
+    for (double ms : samples) sum += ms;
+    result.mean_ms = sum / samples.size();
+
+    double variance = 0.0;
+    for (double ms : samples) variance += (ms - result.mean_ms) * (ms - result.mean_ms);
+    result.stddev_ms = std::sqrt(variance / samples.size());
+    return result;
+}
+
+// Value of "key": in one line of a writeResults file
+bool findField(const std::string& line, const std::string& key, std::string& value) {
+    std::string pattern = "\"" + key + "\":";
+    size_t at = line.find(pattern);
+    if (at == std::string::npos) return false;
+    at = line.find_first_not_of(' ', at + pattern.size());
+    if (at == std::string::npos) return false;
+
+    if (line[at] == '"') {
+        size_t end = line.find('"', at + 1);
+        if (end == std::string::npos) return false;
+        value = line.substr(at + 1, end - at - 1);
+    } else {
+        size_t end = line.find_first_of(",}", at);
+        value = line.substr(at, end == std::string::npos ? std::string::npos : end - at);
+    }
+    return true;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --filter TEXT       run benchmarks whose name contains TEXT\n"
+              << "  --list              list benchmark names and exit\n"
+              << "  --quick             small frames for a fast smoke run\n"
+              << "  --min-time SECONDS  timed budget per benchmark (default 0.5)\n"
+              << "  --samples N         minimum samples per benchmark (default 5)\n"
+              << "  --threads N         thread pool size (default: all cores)\n"
+              << "  --json PATH         write results as JSON\n"
+              << "  --baseline PATH     compare against an earlier --json file\n"
+              << "  --threshold PCT     median change counted as a regression (default 10)\n"
+              << "  --work-dir DIR      scratch directory for EXR files (default $TMPDIR or /tmp)\n";
+}
+
+} // namespace
+
+void Suite::add(const std::string& name, uint64_t pixels, const std::function<void()>& body,
+                const std::function<void()>& setup, uint64_t bytes) {
+    addChecked(name, pixels, [body]() { body(); return true; }, setup, bytes);
+}
+
+void Suite::addChecked(const std::string& name, uint64_t pixels, const std::function<bool()>& body,
+                       const std::function<void()>& setup, uint64_t bytes) {
+    entries_.push_back({name, pixels, bytes, body, setup});
+}
+
+int Suite::run(const Options& options) {
+    if (options.list) {
+        for (const Entry& entry : entries_) {
+            std::cout << entry.name << "\n";
+        }
+        return 0;
+    }
+
+    if (options.threads > 0) {
+        ThreadPool::global().setThreadCount(options.threads);
+    }
+
+    std::vector<Result> baseline;
+    std::map<std::string, double> baseline_median;
+    if (!options.baseline_path.empty()) {
+        if (!readResults(options.baseline_path, baseline)) {
+            std::cerr << "Failed to read baseline: " << options.baseline_path << std::endl;
+            return 1;
+        }
+        for (const Result& result : baseline) {
+            baseline_median[result.name] = result.median_ms;
+        }
+    }
+
+    std::printf("%-48s %8s %11s %11s %9s %10s\n", "benchmark", "samples", "median ms", "min ms", "MP/s",
+                baseline.empty() ? "" : "vs base");
+
+    std::vector<Result> results;
+    int regressions = 0;
+    int failures = 0;
+    for (const Entry& entry : entries_) {
+        if (!options.filter.empty() && entry.name.find(options.filter) == std::string::npos) continue;
+
+        if (entry.setup) entry.setup();
+        if (!entry.body()) {
+            std::printf("%-48s %8s\n", entry.name.c_str(), "FAILED");
+            ++failures;
+            continue;
+        }
+
+        std::vector<double> samples;
+        double elapsed_ms = 0.0;
+        while (static_cast<int>(samples.size()) < options.max_samples &&
+               (static_cast<int>(samples.size()) < options.min_samples ||
+                elapsed_ms < options.min_seconds * 1000.0)) {
+            if (entry.setup) entry.setup();
+            auto start = std::chrono::steady_clock::now();
+            entry.body();
+            double ms = millisecondsSince(start);
+            samples.push_back(ms);
+            elapsed_ms += ms;
+        }
+
+        Result result = summarise(entry.name, entry.pixels, entry.bytes, samples);
+        results.push_back(result);
+
+        std::string change;
+        auto base = baseline_median.find(entry.name);
+        if (base != baseline_median.end() && base->second > 0.0) {
+            double ratio = result.median_ms / base->second - 1.0;
+            char text[32];
+            std::snprintf(text, sizeof(text), "%+.1f%%%s", ratio * 100.0,
+                          ratio > options.threshold ? " !" : "");
+            change = text;
+            if (ratio > options.threshold) ++regressions;
+        } else if (!baseline.empty()) {
+            change = "new";
+        }
+
+        std::printf("%-48s %8d %11.3f %11.3f %9.1f %10s\n", result.name.c_str(), result.samples,
+                    result.median_ms, result.min_ms, result.megapixelsPerSecond(), change.c_str());
+        std::fflush(stdout);
+    }
+
+    if (!options.json_path.empty() && !writeResults(options.json_path, results, options)) {
+        return 1;
+    }
+
+    if (failures > 0) {
+        std::printf("%d benchmark(s) failed\n", failures);
+    }
+    if (regressions > 0) {
+        std::printf("%d benchmark(s) regressed by more than %.0f%%\n", regressions, options.threshold * 100.0);
+    }
+    return (failures > 0 || regressions > 0) ? 1 : 0;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    const char* tmp = std::getenv("TMPDIR");
+    options.work_dir = (tmp && *tmp) ? tmp : "/tmp";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--quick") {
+            options.quick = true;
+        } else if (arg == "--list") {
+            options.list = true;
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && has_value) {
+            options.min_seconds = std::atof(argv[++i]);
+        } else if (arg == "--samples" && has_value) {
+            options.min_samples = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--threads" && has_value) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (arg == "--json" && has_value) {
+            options.json_path = argv[++i];
+        } else if (arg == "--baseline" && has_value) {
+            options.baseline_path = argv[++i];
+        } else if (arg == "--threshold" && has_value) {
+            options.threshold = std::atof(argv[++i]) / 100.0;
+        } else if (arg == "--work-dir" && has_value) {
+            options.work_dir = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool writeResults(const std::string& path, const std::vector<Result>& results, const Options& options) {
+    std::ofstream file(path.c_str());
+    if (!file) {
+        std::cerr << "Failed to write results: " << path << std::endl;
+        return false;
+    }
+
+    // One benchmark object per line keeps the files diffable and lets
+    // readResults get by without a JSON library
+    file << "{\n";
+    file << "  \"format\": \"scbw-bench-1\",\n";
+    file << "  \"threads\": " << ThreadPool::global().threadCount() << ",\n";
+    file << "  \"quick\": " << (options.quick ? "true" : "false") << ",\n";
+    file << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "    {\"name\": \"%s\", \"samples\": %d, \"median_ms\": %.4f, \"min_ms\": %.4f, "
+                      "\"mean_ms\": %.4f, \"stddev_ms\": %.4f, \"pixels\": %llu, \"bytes\": %llu, "
+                      "\"megapixels_per_second\": %.3f}%s\n",
+                      r.name.c_str(), r.samples, r.median_ms, r.min_ms, r.mean_ms, r.stddev_ms,
+                      static_cast<unsigned long long>(r.pixels), static_cast<unsigned long long>(r.bytes),
+                      r.megapixelsPerSecond(), (i + 1 < results.size()) ? "," : "");
+        file << line;
+    }
+    file << "  ]\n}\n";
+
+    if (!file) {
+        std::cerr << "Failed to write results: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool readResults(const std::string& path, std::vector<Result>& results) {
+    std::ifstream file(path.c_str());
+    if (!file) return false;
+
+    results.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string name, median, value;
+        if (!findField(line, "name", name) || !findField(line, "median_ms", median)) continue;
+
+        Result result;
+        result.name = name;
+        result.median_ms = std::atof(median.c_str());
+        if (findField(line, "samples", value)) result.samples = std::atoi(value.c_str());
+        if (findField(line, "min_ms", value)) result.min_ms = std::atof(value.c_str());
+        if (findField(line, "mean_ms", value)) result.mean_ms = std::atof(value.c_str());
+        if (findField(line, "stddev_ms", value)) result.stddev_ms = std::atof(value.c_str());
+        if (findField(line, "pixels", value)) result.pixels = std::strtoull(value.c_str(), nullptr, 10);
+        if (findField(line, "bytes", value)) result.bytes = std::strtoull(value.c_str(), nullptr, 10);
+        results.push_back(result);
+    }
+    return true;
+}
+
+void fillTestImage(ImageData& image, uint32_t seed) {
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            // Per-row seeds keep the content independent of the thread count
+            uint32_t state = seed * 2654435761u + static_cast<uint32_t>(y) * 40503u + 1u;
+            for (int x = 0; x < image.width; ++x) {
+                for (int c = 0; c < image.channels; ++c) {
+                    state = state * 1664525u + 1013904223u;
+                    float noise = static_cast<float>(state >> 8) / 16777216.0f;
+                    float gradient = (c == 0) ? static_cast<float>(x) / image.width
+                                   : (c == 1) ? static_cast<float>(y) / image.height
+                                   : 0.5f + 0.5f * std::sin(0.01f * (x + y) + c);
+                    image(x, y, c) = (c == 3) ? 1.0f : 0.8f * gradient + 0.2f * noise;
+                }
+            }
+        }
+    });
+}
+
+} // namespace bench
+} // namespace ImageProcessing
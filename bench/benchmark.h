@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+namespace bench {
+
+struct Options {
+    std::string filter;             // Substring a benchmark name must contain
+    double min_seconds = 0.5;       // Timed budget per benchmark
+    int min_samples = 5;
+    int max_samples = 1000;
+    int threads = 0;                // 0 keeps the pool default
+    bool quick = false;             // Small frames for smoke runs
+    bool list = false;
+    std::string json_path;          // Results written here when set
+    std::string baseline_path;      // Earlier --json output to compare against
+    double threshold = 0.10;        // Relative median change reported as a regression
+    std::string work_dir;           // Scratch directory for EXR files
+};
+
+struct Result {
+    std::string name;
+    int samples = 0;
+    double median_ms = 0.0;
+    double min_ms = 0.0;
+    double mean_ms = 0.0;
+    double stddev_ms = 0.0;
+    uint64_t pixels = 0;            // Per iteration
+    uint64_t bytes = 0;             // Per iteration, for I/O benchmarks
+    double megapixelsPerSecond() const { return median_ms > 0.0 ? pixels / (median_ms * 1000.0) : 0.0; }
+};
+
+// Runs each benchmark once untimed to warm caches and the frame pool, then
+// times samples until both min_seconds and min_samples are met. `setup` runs
+// before every sample outside the timed region, so in-place kernels can
+// restore their input. The median is the headline number; it is the figure
+// compared against a baseline.
+class Suite {
+public:
+    void add(const std::string& name, uint64_t pixels, const std::function<void()>& body,
+             const std::function<void()>& setup = std::function<void()>(), uint64_t bytes = 0);
+    // For bodies that can fail, such as file I/O: a false return from the
+    // warm-up run reports the benchmark as failed instead of timing it
+    void addChecked(const std::string& name, uint64_t pixels, const std::function<bool()>& body,
+                    const std::function<void()>& setup = std::function<void()>(), uint64_t bytes = 0);
+
+    // Returns the process exit code: 1 if a benchmark failed or regressed
+    // against the baseline by more than the threshold, 0 otherwise
+    int run(const Options& options);
+
+private:
+    struct Entry {
+        std::string name;
+        uint64_t pixels;
+        uint64_t bytes;
+        std::function<bool()> body;
+        std::function<void()> setup;
+    };
+
+    std::vector<Entry> entries_;
+};
+
+// Returns false (after printing usage) on an unknown or malformed argument
+bool parseOptions(int argc, char** argv, Options& options);
+
+bool writeResults(const std::string& path, const std::vector<Result>& results, const Options& options);
+// Reads the benchmarks array of a file written by writeResults
+bool readResults(const std::string& path, std::vector<Result>& results);
+
+// Deterministic test frame: smooth gradients plus seeded noise, so both
+// filters and EXR codecs see realistic content
+void fillTestImage(ImageData& image, uint32_t seed);
+
+} // namespace bench
+} // namespace ImageProcessing
@@ -0,0 +1,363 @@
+#include "benchmark.h"
+#include "exr_processor.h"
+#include "color_lut.h"
+#include "raw_frame.h"
+#include "resampler.h"
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sys/stat.h>
+
+using namespace ImageProcessing;
+
+namespace {
+
+struct FrameSize {
+    int width;
+    int height;
+    std::string label() const { return std::to_string(width) + "x" + std::to_string(height); }
+    uint64_t pixels() const { return static_cast<uint64_t>(width) * height; }
+};
+
+struct Codec {
+    const char* name;
+    Imf::Compression compression;
+};
+
+const Codec kCodecs[] = {
+    {"none", Imf::NO_COMPRESSION},
+    {"rle", Imf::RLE_COMPRESSION},
+    {"zips", Imf::ZIPS_COMPRESSION},
+    {"zip", Imf::ZIP_COMPRESSION},
+    {"piz", Imf::PIZ_COMPRESSION},
+    {"pxr24", Imf::PXR24_COMPRESSION},
+    {"b44", Imf::B44_COMPRESSION},
+    {"dwaa", Imf::DWAA_COMPRESSION},
+};
+
+const char* const kBlendModeNames[] = {
+    "normal", "multiply", "screen", "overlay", "soft_light",
+    "hard_light", "color_dodge", "color_burn", "linear_dodge", "linear_burn",
+};
+
+std::shared_ptr<ImageData> makeImage(const FrameSize& size, int channels, uint32_t seed) {
+    auto image = std::make_shared<ImageData>(size.width, size.height, channels);
+    bench::fillTestImage(*image, seed);
+    return image;
+}
+
+std::vector<RenderPass> makePasses(const FrameSize& size) {
+    // A typical small AOV set: 11 channels over four layers
+    std::vector<RenderPass> passes;
+    passes.emplace_back("beauty", size.width, size.height, 4);
+    passes.emplace_back("diffuse", size.width, size.height, 3);
+    passes.emplace_back("normal", size.width, size.height, 3);
+    passes.emplace_back("depth", size.width, size.height, 1);
+    uint32_t seed = 100;
+    for (RenderPass& pass : passes) {
+        bench::fillTestImage(pass.image, seed++);
+    }
+    return passes;
+}
+
+EXRWriteOptions halfOptions(Imf::Compression compression) {
+    EXRWriteOptions options;
+    options.compression = compression;
+    options.pixel_type = Imf::HALF;
+    return options;
+}
+
+uint64_t fileSize(const std::string& path) {
+    struct stat info;
+    return (stat(path.c_str(), &info) == 0) ? static_cast<uint64_t>(info.st_size) : 0;
+}
+
+// Kernels that work in place get a fresh copy of the source before every sample
+void addInPlace(bench::Suite& suite, const std::string& name, std::shared_ptr<ImageData> source,
+                const std::function<void(ImageData&)>& kernel) {
+    auto work = std::make_shared<ImageData>();
+    suite.add(name, static_cast<uint64_t>(source->width) * source->height,
+              [work, kernel]() { kernel(*work); },
+              [work, source]() { *work = *source; });
+}
+
+void addFilterBenchmarks(bench::Suite& suite, const FrameSize& size) {
+    auto source = makeImage(size, 4, 1);
+    std::string res = "/" + size.label();
+    Imath::Box2i roi(Imath::V2i(size.width / 4, size.height / 4),
+                     Imath::V2i(size.width / 4 + 255, size.height / 4 + 255));
+    std::vector<float> kernel9 = {0.05f, 0.09f, 0.12f, 0.15f, 0.18f, 0.15f, 0.12f, 0.09f, 0.05f};
+
+    addInPlace(suite, "filter.gaussian_blur/sigma2" + res, source,
+               [](ImageData& image) { ImageFilters::gaussianBlur(image, 2.0f); });
+    addInPlace(suite, "filter.gaussian_blur/sigma16" + res, source,
+               [](ImageData& image) { ImageFilters::gaussianBlur(image, 16.0f); });
+    addInPlace(suite, "filter.gaussian_blur_roi/sigma2/256x256" + res, source,
+               [roi](ImageData& image) { ImageFilters::gaussianBlur(image, 2.0f, roi); });
+    addInPlace(suite, "filter.separable_convolve/9tap" + res, source,
+               [kernel9](ImageData& image) { ImageFilters::separableConvolve(image, kernel9); });
+    addInPlace(suite, "filter.stacked_box_blur/sigma32" + res, source,
+               [](ImageData& image) { ImageFilters::stackedBoxBlur(image, 32.0f); });
+    addInPlace(suite, "filter.sharpen" + res, source,
+               [](ImageData& image) { ImageFilters::sharpen(image, 0.5f); });
+    addInPlace(suite, "filter.sobel" + res, source,
+               [](ImageData& image) { ImageFilters::sobelEdgeDetection(image); });
+    addInPlace(suite, "filter.laplacian" + res, source,
+               [](ImageData& image) { ImageFilters::laplacianEdgeDetection(image); });
+    auto mask = std::make_shared<ImageData>();
+    suite.add("filter.sobel_mask" + res, static_cast<uint64_t>(size.width) * size.height,
+              [source, mask]() { ImageFilters::sobelEdgeMask(*source, *mask); });
+    addInPlace(suite, "filter.unsharp_mask" + res, source,
+               [](ImageData& image) { ImageFilters::unsharpMask(image, 1.5f, 0.5f, 0.0f); });
+    addInPlace(suite, "exr.sharpen" + res, source,
+               [](ImageData& image) { EXRProcessor().applySharpen(image, 0.5f); });
+}
+
+void addCompositeBenchmarks(bench::Suite& suite, const FrameSize& size) {
+    auto base = makeImage(size, 4, 2);
+    auto overlay = makeImage(size, 4, 3);
+    auto half_base = std::make_shared<HalfImageData>();
+    auto half_overlay = std::make_shared<HalfImageData>();
+    convertToHalf(*base, *half_base);
+    convertToHalf(*overlay, *half_overlay);
+    std::string res = "/" + size.label();
+
+    for (int mode = Compositor::NORMAL; mode <= Compositor::LINEAR_BURN; ++mode) {
+        Compositor::BlendMode blend_mode = static_cast<Compositor::BlendMode>(mode);
+        auto result = std::make_shared<ImageData>();
+        suite.add(std::string("blend.") + kBlendModeNames[mode] + res, size.pixels(),
+                  [=]() { Compositor::blend(*base, *overlay, *result, blend_mode, 0.8f); });
+    }
+    for (int mode = Compositor::NORMAL; mode <= Compositor::LINEAR_BURN; ++mode) {
+        Compositor::BlendMode blend_mode = static_cast<Compositor::BlendMode>(mode);
+        auto result = std::make_shared<HalfImageData>();
+        suite.add(std::string("blend_half.") + kBlendModeNames[mode] + res, size.pixels(),
+                  [=]() { Compositor::blend(*half_base, *half_overlay, *result, blend_mode, 0.8f); });
+    }
+
+    auto mask = makeImage(size, 1, 4);
+    auto stacked = std::make_shared<ImageData>();
+    suite.add("composite_layers/4" + res, size.pixels(), [=]() {
+        std::vector<Compositor::Layer> layers = {
+            {base.get(), Compositor::NORMAL, 1.0f, nullptr},
+            {overlay.get(), Compositor::SCREEN, 0.5f, nullptr},
+            {overlay.get(), Compositor::MULTIPLY, 0.7f, mask.get()},
+            {base.get(), Compositor::LINEAR_DODGE, 0.3f, nullptr},
+        };
+        Compositor::compositeLayers(layers, *stacked);
+    });
+
+    // Recomposite after a 64x64 patch of the top layer changed: diffing
+    // every layer, and diffing only the one the caller says it edited
+    auto edited = makeImage(size, 4, 6);
+    auto incremental = std::make_shared<IncrementalCompositor>();
+    std::vector<Compositor::Layer> edited_layers = {
+        {base.get(), Compositor::NORMAL, 1.0f, nullptr},
+        {overlay.get(), Compositor::SCREEN, 0.5f, nullptr},
+        {overlay.get(), Compositor::MULTIPLY, 0.7f, mask.get()},
+        {edited.get(), Compositor::LINEAR_DODGE, 0.3f, nullptr},
+    };
+    incremental->composite(edited_layers);
+    auto touch = [edited]() {
+        for (int y = 0; y < std::min(64, edited->height); ++y) {
+            for (int x = 0; x < std::min(64, edited->width); ++x) {
+                float& value = (*edited)(x, y, 0);
+                value = 1.0f - value;
+            }
+        }
+    };
+    suite.add("composite_layers/4_incremental" + res, size.pixels(), [=]() {
+        touch();
+        incremental->composite(edited_layers);
+    });
+    suite.add("composite_layers/4_update" + res, size.pixels(), [=]() {
+        touch();
+        incremental->update(edited_layers, {3});
+    });
+    addInPlace(suite, "premultiply_alpha" + res, base,
+               [](ImageData& image) { Compositor::premultiplyAlpha(image); });
+}
+
+void addResampleAndColourBenchmarks(bench::Suite& suite, const FrameSize& size) {
+    auto source = makeImage(size, 4, 5);
+    auto output = std::make_shared<ImageData>();
+    std::string res = "/" + size.label();
+    FrameSize half_size = {size.width / 2, size.height / 2};
+    FrameSize quarter_size = {size.width / 4, size.height / 4};
+
+    // resizeImage's default filter, pinned so older resize/* baselines stay comparable
+    suite.add("resize/down2x" + res, half_size.pixels(), [=]() {
+        EXRProcessor().resizeImage(*source, *output, half_size.width, half_size.height, ResampleFilter::BILINEAR);
+    });
+    suite.add("resize/down4x" + res, quarter_size.pixels(), [=]() {
+        EXRProcessor().resizeImage(*source, *output, quarter_size.width, quarter_size.height,
+                                   ResampleFilter::BILINEAR);
+    });
+    suite.add("resize/up2x" + res, size.pixels() * 4, [=]() {
+        EXRProcessor().resizeImage(*source, *output, size.width * 2, size.height * 2, ResampleFilter::BILINEAR);
+    });
+
+    // Prebuilt taps, as a sequence render reuses them for every frame
+    const std::pair<const char*, ResampleFilter> filters[] = {
+        {"box", ResampleFilter::BOX},
+        {"bilinear", ResampleFilter::BILINEAR},
+        {"mitchell", ResampleFilter::MITCHELL},
+        {"lanczos3", ResampleFilter::LANCZOS3},
+    };
+    for (const auto& filter : filters) {
+        auto resampler = std::make_shared<Resampler>(size.width, size.height, half_size.width, half_size.height,
+                                                     filter.second);
+        suite.add(std::string("resample.") + filter.first + "/down2x" + res, half_size.pixels(), [=]() {
+            resampler->resample(*source, *output);
+        });
+    }
+
+    addInPlace(suite, "colour.to_linear" + res, source,
+               [](ImageData& image) { EXRProcessor().convertToLinear(image); });
+    addInPlace(suite, "colour.to_srgb" + res, source,
+               [](ImageData& image) { EXRProcessor().convertToSRGB(image); });
+    addInPlace(suite, "colour.tone_map" + res, source,
+               [](ImageData& image) { EXRProcessor().applyToneMapping(image, 1.0f, 2.2f); });
+    addInPlace(suite, "colour.display_tone_map" + res, source,
+               [](ImageData& image) { EXRProcessor().applyDisplayToneMapping(image, 1.0f, 2.2f); });
+
+    auto lut_1d = std::make_shared<ColorLUT>(ColorLUT::bake1D(
+        [](float v) { return color::linearToSRGB(v); }, 4096));
+    auto lut_3d = std::make_shared<ColorLUT>(ColorLUT::bake3D(
+        [](const float* in, float* out) {
+            for (int c = 0; c < 3; ++c) out[c] = color::reinhardToneMap(in[c], 1.0f, 1.0f / 2.2f);
+        }, 33, 0.0f, 4.0f));
+    addInPlace(suite, "colour.lut_1d" + res, source, [lut_1d](ImageData& image) { lut_1d->apply(image); });
+    addInPlace(suite, "colour.lut_3d" + res, source, [lut_3d](ImageData& image) { lut_3d->apply(image); });
+
+    auto half = std::make_shared<HalfImageData>();
+    convertToHalf(*source, *half);
+    auto half_work = std::make_shared<HalfImageData>();
+    suite.add("colour.to_half" + res, size.pixels(), [=]() { convertToHalf(*source, *half_work); });
+    suite.add("colour.to_float" + res, size.pixels(), [=]() { convertToFloat(*half, *output); });
+    suite.add("colour.to_linear_half" + res, size.pixels(),
+              [=]() { EXRProcessor().convertToLinear(*half_work); },
+              [=]() { *half_work = *half; });
+}
+
+void addEXRBenchmarks(bench::Suite& suite, const FrameSize& size, const bench::Options& options,
+                      std::vector<std::string>& scratch) {
+    std::string res = "/" + size.label();
+    const std::string& work_dir = options.work_dir;
+    auto wanted = [&](const std::string& name) {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    };
+    auto passes = std::make_shared<std::vector<RenderPass>>(makePasses(size));
+    auto rgba = std::make_shared<ImageData>((*passes)[0].image);
+
+    for (const Codec& codec : kCodecs) {
+        std::string load_name = std::string("exr.load/") + codec.name + res;
+        std::string layered_name = std::string("exr.load_multiplane/") + codec.name + res;
+        std::string stem = work_dir + "/scbw_bench_" + codec.name + "_" + size.label();
+        std::string rgba_path = stem + ".exr";
+        std::string layered_path = stem + "_layers.exr";
+        EXRWriteOptions write_options = halfOptions(codec.compression);
+
+        // Half-float fixtures, only written for benchmarks that will run
+        if (!options.list && (wanted(load_name) || wanted(layered_name))) {
+            scratch.push_back(rgba_path);
+            scratch.push_back(layered_path);
+            if (!EXRProcessor().saveEXR(rgba_path, *rgba, write_options) ||
+                !EXRProcessor().saveMultiPlaneEXR(layered_path, *passes, write_options)) {
+                continue;
+            }
+        }
+
+        auto image = std::make_shared<ImageData>();
+        suite.addChecked(load_name, size.pixels(),
+                         [=]() { return EXRProcessor().loadEXR(rgba_path, *image); },
+                         std::function<void()>(), fileSize(rgba_path));
+
+        auto loaded = std::make_shared<std::vector<RenderPass>>();
+        suite.addChecked(layered_name, size.pixels(),
+                         [=]() { return EXRProcessor().loadMultiPlaneEXR(layered_path, *loaded); },
+                         [=]() { loaded->clear(); }, fileSize(layered_path));
+
+        std::string save_path = stem + "_save.exr";
+        std::string save_layered_path = stem + "_save_layers.exr";
+        scratch.push_back(save_path);
+        scratch.push_back(save_layered_path);
+        suite.addChecked(std::string("exr.save/") + codec.name + res, size.pixels(),
+                         [=]() { return EXRProcessor().saveEXR(save_path, *rgba, write_options); });
+        suite.addChecked(std::string("exr.save_multiplane/") + codec.name + res, size.pixels(),
+                         [=]() { return EXRProcessor().saveMultiPlaneEXR(save_layered_path, *passes,
+                                                                         write_options); });
+    }
+
+    // Lossy beauty with lossless float data passes, one part per pass
+    EXRWriteOptions mixed = halfOptions(Imf::ZIP_COMPRESSION);
+    mixed.pass_compression["beauty"] = Imf::DWAA_COMPRESSION;
+    mixed.channel_types["depth"] = Imf::FLOAT;
+    mixed.channel_types["normal"] = Imf::FLOAT;
+    EXRWriteOptions tiled = halfOptions(Imf::ZIP_COMPRESSION);
+    tiled.tiled = true;
+
+    std::string mixed_path = work_dir + "/scbw_bench_mixed_" + size.label() + ".exr";
+    std::string tiled_path = work_dir + "/scbw_bench_tiled_" + size.label() + ".exr";
+    scratch.push_back(mixed_path);
+    scratch.push_back(tiled_path);
+    suite.addChecked("exr.save_multiplane/mixed_parts" + res, size.pixels(),
+                     [=]() { return EXRProcessor().saveMultiPlaneEXR(mixed_path, *passes, mixed); });
+    suite.addChecked("exr.save_multiplane/zip_tiled" + res, size.pixels(),
+                     [=]() { return EXRProcessor().saveMultiPlaneEXR(tiled_path, *passes, tiled); });
+
+    // Uncompressed hand-off format, for comparison with the codecs above
+    std::string raw_path = work_dir + "/scbw_bench_raw_" + size.label() + ".scbwraw";
+    scratch.push_back(raw_path);
+    if (!options.list && (wanted("raw.load_multiplane/half" + res) || wanted("raw.open_view/half" + res))) {
+        saveRawFrame(raw_path, *passes, RawSampleType::HALF);
+    }
+    suite.addChecked("raw.save/half" + res, size.pixels(),
+                     [=]() { return saveRawFrame(raw_path, *passes, RawSampleType::HALF); });
+    auto raw_loaded = std::make_shared<std::vector<RenderPass>>();
+    suite.addChecked("raw.load_multiplane/half" + res, size.pixels(),
+                     [=]() { return EXRProcessor().loadMultiPlaneEXR(raw_path, *raw_loaded); },
+                     [=]() { raw_loaded->clear(); });
+    // Opening maps the header only; the view touches a single pass
+    suite.addChecked("raw.open_view/half" + res, size.pixels(), [=]() {
+        RawFrame frame;
+        BasicChannelView<const half> view;
+        return frame.open(raw_path) && frame.channel((*passes)[0].name, 0, view);
+    });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Options options;
+    if (!bench::parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    // Kernels are measured on HD frames; codecs also on UHD, where I/O
+    // throughput and memory traffic dominate
+    std::vector<FrameSize> kernel_sizes = {{1920, 1080}};
+    std::vector<FrameSize> io_sizes = {{1920, 1080}, {3840, 2160}};
+    if (options.quick) {
+        kernel_sizes = {{640, 360}};
+        io_sizes = {{640, 360}};
+    }
+
+    bench::Suite suite;
+    std::vector<std::string> scratch;
+    for (const FrameSize& size : kernel_sizes) {
+        addFilterBenchmarks(suite, size);
+        addCompositeBenchmarks(suite, size);
+        addResampleAndColourBenchmarks(suite, size);
+    }
+    for (const FrameSize& size : io_sizes) {
+        addEXRBenchmarks(suite, size, options, scratch);
+    }
+
+    int status = suite.run(options);
+
+    for (const std::string& path : scratch) {
+        std::remove(path.c_str());
+    }
+    return status;
+}
@@ -2,9 +2,11 @@
 #include <vector>
 #include <functional>
 #include <cstdlib>
+#include <cstdio>
 #include <ctime>
 #include <cmath>
 #include "../include/exr_processor.h"
+#include "../include/batch_processor.h"
 
 using namespace ImageProcessing;
 
@@ -114,12 +116,9 @@ void demonstrateMultiPassRendering() {
     
     // Save individual passes
     std::cout << "Saving individual passes..." << std::endl;
-    processor.saveEXR("pass_beauty.exr", beauty->image);
-    processor.saveEXR("pass_depth.exr", depth->image);
-    processor.saveEXR("pass_normal.exr", normal->image);
-    processor.saveEXR("pass_albedo.exr", albedo->image);
-    processor.saveEXR("pass_specular.exr", specular->image);
-    processor.saveEXR("pass_emission.exr", emission->image);
+    if (!processor.saveRenderPasses("pass_")) {
+        std::cerr << "Failed to save render passes" << std::endl;
+    }
     
     // Create composite
     std::vector<std::string> pass_names = {"beauty", "depth", "normal", "albedo", "specular", "emission"};
@@ -209,6 +208,35 @@ void demonstrateCompositing() {
     std::cout << "✓ Compositing demo complete" << std::endl;
 }
 
+void demonstrateBatchProcessing() {
+    std::cout << "\n=== Batch Processing Demo ===" << std::endl;
+    
+    EXRProcessor processor;
+    const int frame_count = 8;
+    
+    // Write a short sequence to feed the pipeline
+    for (int frame = 1; frame <= frame_count; ++frame) {
+        ImageData image;
+        createTestImage(image, 512, 512, (frame % 2) ? "radial" : "checker");
+        char filename[64];
+        std::snprintf(filename, sizeof(filename), "batch_in.%04d.exr", frame);
+        processor.saveEXR(filename, image);
+    }
+    
+    BatchProcessor batch(2);
+    batch.addGaussianBlur(2.0f);
+    batch.addToneMapping(1.5f, 2.2f);
+    
+    if (batch.processSequence("batch_in.%04d.exr", "batch_out.%04d.exr", 1, frame_count)) {
+        const BatchStats& stats = batch.stats();
+        std::cout << "Processed " << stats.frames << " frames in " << stats.wall_seconds << "s"
+                  << " (load " << stats.load_seconds << "s, process " << stats.process_seconds
+                  << "s, save " << stats.save_seconds << "s)" << std::endl;
+    }
+    
+    std::cout << "✓ Batch processing demo complete" << std::endl;
+}
+
 int main() {
     std::cout << "EXR Processing Examples" << std::endl;
     std::cout << "======================" << std::endl;
@@ -219,6 +247,7 @@ int main() {
         demonstrateMultiPassRendering();
         demonstrateFiltering();
         demonstrateCompositing();
+        demonstrateBatchProcessing();
         
         std::cout << "\n=== All Examples Complete ===" << std::endl;
         std::cout << "Check the current directory for generated EXR files." << std::endl;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// One step of the per-frame operation chain run by BatchProcessor
+struct BatchOperation {
+    std::string name;
+    std::function<void(ImageData&)> apply;
+};
+
+struct BatchStats {
+    int frames = 0;
+    int failed = 0;
+    double load_seconds = 0.0;      // Time spent decoding, summed over frames
+    double process_seconds = 0.0;
+    double save_seconds = 0.0;
+    double wall_seconds = 0.0;      // Less than the sum above when the stages overlap
+};
+
+// Runs an operation chain over a frame sequence as a three-stage pipeline:
+// a loader thread decodes frame N+1 while the calling thread processes frame N
+// and a saver thread encodes frame N-1. The queues between the stages hold at
+// most `queue_depth` frames, so a slow stage holds back the others instead of
+// letting decoded frames pile up in memory. Frame buffers are recycled from the
+// saver back to the loader.
+class BatchProcessor {
+public:
+    explicit BatchProcessor(int queue_depth = 2);
+
+    // Operation chain, applied in order to every frame
+    void addOperation(const BatchOperation& operation);
+    void addGaussianBlur(float sigma);
+    void addSharpen(float strength);
+    void addEdgeDetection();
+    // Resizes every frame, reusing the filter taps across frames of the same
+    // size; Lanczos3 unless another filter is given
+    void addResize(int width, int height, ResampleFilter filter = ResampleFilter::LANCZOS3);
+    void addToneMapping(float exposure = 1.0f, float gamma = 2.2f);
+    void clearOperations();
+
+    // Processes inputs[i] into outputs[i]; returns false if any frame failed
+    bool process(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs);
+    // Same over printf-style patterns such as "beauty.%04d.exr"
+    bool processSequence(const std::string& input_pattern, const std::string& output_pattern,
+                         int first_frame, int last_frame, int step = 1);
+
+    static std::vector<std::string> expandFramePattern(const std::string& pattern,
+                                                       int first_frame, int last_frame, int step = 1);
+
+    // Settings handed to the EXRProcessor used by each stage
+    void setPixelLayout(PixelLayout layout) { pixel_layout_ = layout; }
+    void setOutputPixelType(Imf::PixelType type) { output_pixel_type_ = type; }
+
+    void setQueueDepth(int queue_depth);
+    int queueDepth() const { return queue_depth_; }
+    const BatchStats& stats() const { return stats_; }
+
+private:
+    int queue_depth_;
+    std::vector<BatchOperation> operations_;
+    PixelLayout pixel_layout_;
+    Imf::PixelType output_pixel_type_;
+    BatchStats stats_;
+};
+
+} // namespace ImageProcessing
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+#include "exr_processor.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace ImageProcessing {
+
+// Transfer functions built on polynomial log2/exp2 instead of std::pow.
+// Written against the simd helpers like the blend modes, so they run on
+// full vectors and on plain floats for tails. fastLog2 is within 2e-7
+// absolute and fastExp2 within 3e-7 relative, so fastPow stays within 4e-6
+// relative while |y * log2(x)| < 64 - far inside a half-float ULP (4.9e-4).
+// fastPow returns 0 for x <= 0, where std::pow would give NaN for the
+// fractional exponents used here.
+namespace color {
+
+template <class V>
+inline V fastLog2(V x) {
+    // Mantissa in [sqrt(1/2), sqrt(2)), then the atanh series for log2(m)
+    V e = simd::exponent(x);
+    V m = simd::mantissa(x);
+    auto high = simd::gt(m, V(1.41421356f));
+    m = simd::select(high, m * V(0.5f), m);
+    e = simd::select(high, e + V(1.0f), e);
+
+    V s = (m - V(1.0f)) / (m + V(1.0f));
+    V s2 = s * s;
+    V series = V(0.412198583f) + s2 * V(0.320598898f);
+    series = V(0.577078016f) + s2 * series;
+    series = V(0.961796694f) + s2 * series;
+    series = V(2.88539008f) + s2 * series;
+    return e + s * series;
+}
+
+// 2^f - 1 for f in [-0.5, 0.5]
+template <class V>
+inline V exp2FractionMinusOne(V f) {
+    V p = V(0.00133335581f) + f * V(0.000154035304f);
+    p = V(0.00961812911f) + f * p;
+    p = V(0.0555041087f) + f * p;
+    p = V(0.240226507f) + f * p;
+    p = V(0.693147181f) + f * p;
+    return f * p;
+}
+
+template <class V>
+inline V fastExp2(V y) {
+    y = simd::min(simd::max(y, V(-126.0f)), V(127.0f));
+    V n = simd::round(y);
+    return (V(1.0f) + exp2FractionMinusOne(y - n)) * simd::exp2i(n);
+}
+
+// 2^y - 1 without the cancellation of fastExp2(y) - 1 near y = 0
+template <class V>
+inline V fastExp2MinusOne(V y) {
+    y = simd::min(simd::max(y, V(-126.0f)), V(127.0f));
+    V n = simd::round(y);
+    V scale = simd::exp2i(n);
+    return exp2FractionMinusOne(y - n) * scale + (scale - V(1.0f));
+}
+
+template <class V>
+inline V fastPow(V x, float y) {
+    return simd::select(simd::gt(x, V(1.17549435e-38f)), fastExp2(V(y) * fastLog2(x)), V(0.0f));
+}
+
+// Both branches are evaluated; the unused one is masked out
+template <class V>
+inline V srgbToLinear(V v) {
+    V curve = fastPow((v + V(0.055f)) * V(1.0f / 1.055f), 2.4f);
+    return simd::select(simd::le(v, V(0.04045f)), v * V(1.0f / 12.92f), curve);
+}
+
+template <class V>
+inline V linearToSRGB(V v) {
+    V curve = V(1.055f) * fastPow(v, 1.0f / 2.4f) - V(0.055f);
+    return simd::select(simd::le(v, V(0.0031308f)), v * V(12.92f), curve);
+}
+
+// EXRProcessor::applyToneMapping: exponential roll-off, then display gamma
+template <class V>
+inline V filmicToneMap(V v, float exposure, float inv_gamma) {
+    return fastPow(V(0.0f) - fastExp2MinusOne(v * V(-1.44269504f * exposure)), inv_gamma);
+}
+
+// The viewer's GLSL tonemap(): Reinhard, then display gamma
+template <class V>
+inline V reinhardToneMap(V v, float exposure, float inv_gamma) {
+    V c = v * V(exposure);
+    return fastPow(c / (V(1.0f) + c), inv_gamma);
+}
+
+struct SRGBToLinear {
+    template <class V> V operator()(V v) const { return srgbToLinear(v); }
+};
+
+struct LinearToSRGB {
+    template <class V> V operator()(V v) const { return linearToSRGB(v); }
+};
+
+struct FilmicToneMap {
+    float exposure, inv_gamma;
+    template <class V> V operator()(V v) const { return filmicToneMap(v, exposure, inv_gamma); }
+};
+
+struct ReinhardToneMap {
+    float exposure, inv_gamma;
+    template <class V> V operator()(V v) const { return reinhardToneMap(v, exposure, inv_gamma); }
+};
+
+// Applies fn to `count` contiguous samples, a vector at a time
+template <class Fn>
+inline void transformRun(float* values, size_t count, const Fn& fn) {
+    size_t i = 0;
+    for (; i + simd::VecF::width <= count; i += simd::VecF::width) {
+        fn(simd::VecF::load(values + i)).store(values + i);
+    }
+    for (; i < count; ++i) {
+        values[i] = fn(values[i]);
+    }
+}
+
+// Interleaved pixels with alpha (channel 3) left untouched. Whole pixels go
+// through the vector path and alpha is restored afterwards, which is cheaper
+// than breaking the run up around every fourth sample.
+template <class Fn>
+inline void transformInterleaved(float* pixels, size_t count, int channels, const Fn& fn) {
+    const size_t kBlock = 256;
+    float alpha[kBlock];
+    for (size_t start = 0; start < count; start += kBlock) {
+        size_t n = std::min(kBlock, count - start);
+        float* p = pixels + start * channels;
+        if (channels > 3) {
+            for (size_t i = 0; i < n; ++i) alpha[i] = p[i * channels + 3];
+        }
+        transformRun(p, n * channels, fn);
+        if (channels > 3) {
+            for (size_t i = 0; i < n; ++i) p[i * channels + 3] = alpha[i];
+        }
+    }
+}
+
+// Every sample except alpha, in either layout
+template <class Fn>
+void transformSamples(ImageData& image, const Fn& fn) {
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            if (image.layout == PixelLayout::PLANAR) {
+                for (int c = 0; c < image.channels; ++c) {
+                    if (c == 3) continue;
+                    transformRun(image.data.data() + image.index(0, y, c), image.width, fn);
+                }
+            } else {
+                transformInterleaved(image.data.data() + image.index(0, y, 0), image.width, image.channels, fn);
+            }
+        }
+    });
+}
+
+} // namespace color
+
+// 1D (per channel) or 3D colour lookup table in the .cube format written by
+// OCIO's ociobakelut, Resolve and most grading tools. Inputs are mapped from
+// [domain_min, domain_max] onto the lattice and clamped; 1D tables are
+// interpolated linearly per channel, 3D tables trilinearly, which is the
+// same filtering the viewer's GL_LINEAR LUT texture applies, so CPU output
+// and the display match.
+class ColorLUT {
+public:
+    enum Type { LUT_1D, LUT_3D };
+
+    ColorLUT();
+
+    bool loadCube(const std::string& filepath);
+    bool saveCube(const std::string& filepath) const;
+
+    // Samples a per-channel curve or an RGB transform on a uniform lattice
+    static ColorLUT bake1D(const std::function<float(float)>& curve, int size,
+                           float domain_min = 0.0f, float domain_max = 1.0f);
+    static ColorLUT bake3D(const std::function<void(const float* rgb_in, float* rgb_out)>& transform,
+                           int size, float domain_min = 0.0f, float domain_max = 1.0f);
+
+    // Exposure scales RGB before the lookup, as in the viewer. Only the
+    // first three channels are changed; returns false for fewer than three.
+    bool apply(ImageData& image, float exposure = 1.0f) const;
+    void lookup(const float* rgb_in, float* rgb_out) const;
+
+    bool empty() const { return table_.empty(); }
+    Type type() const { return type_; }
+    int size() const { return size_; }
+    const float* domainMin() const { return domain_min_; }
+    const float* domainMax() const { return domain_max_; }
+    const std::string& title() const { return title_; }
+    // RGB triplets; for 3D tables red varies fastest, then green, then blue
+    const std::vector<float>& table() const { return table_; }
+
+private:
+    Type type_;
+    int size_;
+    float domain_min_[3];
+    float domain_max_[3];
+    std::string title_;
+    std::vector<float> table_;
+};
+
+} // namespace ImageProcessing
@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <functional>
+#include <cstdint>
 #include <OpenEXR/ImfHeader.h>
 #include <OpenEXR/ImfInputFile.h>
 #include <OpenEXR/ImfOutputFile.h>
@@ -11,61 +13,331 @@
 #include <OpenEXR/ImfFrameBuffer.h>
 #include <OpenEXR/ImfRgbaFile.h>
 #include <OpenEXR/ImfArray.h>
+#include <OpenEXR/ImfCompression.h>
+#include "frame_pool.h"
 
 namespace ImageProcessing {
 
-struct ImageData {
+// Interleaved stores RGBARGBA...; planar stores each channel as its own
+// contiguous width x height plane.
+enum class PixelLayout {
+    INTERLEAVED,
+    PLANAR
+};
+
+// Reconstruction filters for Resampler and EXRProcessor::resizeImage, from
+// softest-but-cheapest to sharpest. Mitchell is Mitchell-Netravali with
+// B = C = 1/3; Lanczos3 rings slightly on hard edges.
+enum class ResampleFilter {
+    BOX,
+    BILINEAR,
+    MITCHELL,
+    LANCZOS3
+};
+
+// Zero-copy strided view of a single channel of an ImageData
+template <typename T>
+struct BasicChannelView {
+    T* base;
+    int width;
+    int height;
+    size_t x_stride;  // in samples
+    size_t y_stride;  // in samples
+    
+    T& operator()(int x, int y) const {
+        return base[y * y_stride + x * x_stride];
+    }
+    
+    T* row(int y) const { return base + y * y_stride; }
+    bool contiguous() const { return x_stride == 1; }
+    
+    operator BasicChannelView<const T>() const {
+        return {base, width, height, x_stride, y_stride};
+    }
+};
+
+typedef BasicChannelView<float> ChannelView;
+typedef BasicChannelView<const float> ConstChannelView;
+
+// Pixel storage. ImageData (float) is the working type used by every filter;
+// HalfImageData keeps samples as 16-bit half floats to halve memory and I/O
+// for beauty/AOV passes and is widened to float only inside the kernels.
+// Samples are 64-byte aligned and drawn from FramePool::global().
+//
+// The samples cover the EXR data window: pixel (0, 0) sits at
+// (x_offset, y_offset) of the frame described by display_window. Images
+// created in memory sit at the origin with display window == data window.
+template <typename T>
+struct BasicImageData {
+    typedef T value_type;
+    typedef std::vector<T, PoolAllocator<T>> Storage;
+    
     int width;
     int height;
     int channels;
-    std::vector<float> data;
+    PixelLayout layout;
+    Storage data;
+    int x_offset;
+    int y_offset;
+    Imath::Box2i display_window;
+    
+    BasicImageData(int w = 0, int h = 0, int c = 0, PixelLayout l = PixelLayout::INTERLEAVED) 
+        : width(w), height(h), channels(c), layout(l),
+          data(static_cast<size_t>(w) * h * c, T(0.0f)),
+          x_offset(0), y_offset(0),
+          display_window(Imath::V2i(0, 0), Imath::V2i(w - 1, h - 1)) {}
+    
+    Imath::Box2i dataWindow() const {
+        return Imath::Box2i(Imath::V2i(x_offset, y_offset),
+                            Imath::V2i(x_offset + width - 1, y_offset + height - 1));
+    }
+    
+    // Takes over the data window origin and display window of another image
+    template <typename U>
+    void setWindowsFrom(const BasicImageData<U>& other) {
+        x_offset = other.x_offset;
+        y_offset = other.y_offset;
+        display_window = other.display_window;
+    }
+    
+    bool hasShape(int w, int h, int c, PixelLayout l) const {
+        return width == w && height == h && channels == c && layout == l;
+    }
+    
+    // Changes the shape, keeping the allocation when it is large enough. Samples
+    // are not cleared, so the caller must overwrite all of them.
+    void reshape(int w, int h, int c, PixelLayout l) {
+        width = w;
+        height = h;
+        channels = c;
+        layout = l;
+        data.resize(static_cast<size_t>(w) * h * c);
+    }
     
-    ImageData(int w = 0, int h = 0, int c = 0) 
-        : width(w), height(h), channels(c), data(w * h * c) {}
+    // Distance between horizontally adjacent samples of one channel
+    size_t pixelStride() const {
+        return layout == PixelLayout::PLANAR ? 1 : channels;
+    }
+    
+    // Distance between two channels of the same pixel
+    size_t channelStride() const {
+        return layout == PixelLayout::PLANAR ? static_cast<size_t>(width) * height : 1;
+    }
+    
+    size_t index(int x, int y, int c) const {
+        return (static_cast<size_t>(y) * width + x) * pixelStride() + c * channelStride();
+    }
     
-    float& operator()(int x, int y, int c) {
-        return data[(y * width + x) * channels + c];
+    T& operator()(int x, int y, int c) {
+        return data[index(x, y, c)];
     }
     
-    const float& operator()(int x, int y, int c) const {
-        return data[(y * width + x) * channels + c];
+    const T& operator()(int x, int y, int c) const {
+        return data[index(x, y, c)];
+    }
+    
+    BasicChannelView<T> channel(int c) {
+        return {data.data() + c * channelStride(), width, height,
+                pixelStride(), width * pixelStride()};
+    }
+    
+    BasicChannelView<const T> channel(int c) const {
+        return {data.data() + c * channelStride(), width, height,
+                pixelStride(), width * pixelStride()};
+    }
+    
+    // Returns a copy of the image stored with the given layout
+    BasicImageData withLayout(PixelLayout target) const {
+        if (target == layout) return *this;
+        
+        BasicImageData result(width, height, channels, target);
+        result.setWindowsFrom(*this);
+        for (int c = 0; c < channels; ++c) {
+            BasicChannelView<const T> src = channel(c);
+            BasicChannelView<T> dst = result.channel(c);
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    dst(x, y) = src(x, y);
+                }
+            }
+        }
+        return result;
+    }
+    
+    // Reorders the samples (through one temporary) to the given layout
+    void setLayout(PixelLayout target) {
+        if (target != layout) {
+            *this = withLayout(target);
+        }
     }
 };
 
+typedef BasicImageData<float> ImageData;
+typedef BasicImageData<half> HalfImageData;
+
 struct RenderPass {
     std::string name;
     ImageData image;
     std::string layer_name;
     bool is_alpha;
     
-    RenderPass(const std::string& n, int w, int h, int c, bool alpha = false)
-        : name(n), image(w, h, c), layer_name(n), is_alpha(alpha) {}
+    RenderPass(const std::string& n, int w, int h, int c, bool alpha = false,
+               PixelLayout layout = PixelLayout::INTERLEAVED)
+        : name(n), image(w, h, c, layout), layer_name(n), is_alpha(alpha) {}
 };
 
+// Encoding choices for saveEXR and saveMultiPlaneEXR. A pass whose
+// compression differs from the others gets its own part, which makes the
+// output a multi-part file; in a multi-part file every pass keeps its own
+// data window. Channel types are converted by OpenEXR while encoding.
+struct EXRWriteOptions {
+    Imf::Compression compression = Imf::ZIP_COMPRESSION;
+    Imf::PixelType pixel_type = Imf::FLOAT;
+    // By pass name
+    std::map<std::string, Imf::Compression> pass_compression;
+    // By full channel name ("depth.R") or pass name ("depth")
+    std::map<std::string, Imf::PixelType> channel_types;
+    bool multipart = false;         // One part per pass even when the codecs match
+    bool tiled = false;
+    int tile_width = 64;
+    int tile_height = 64;
+    
+    Imf::Compression compressionFor(const std::string& pass) const;
+    Imf::PixelType pixelTypeFor(const std::string& pass, const std::string& channel) const;
+};
+
+template <typename T> struct EXRPixelType;
+template <> struct EXRPixelType<float> { static const Imf::PixelType value = Imf::FLOAT; };
+template <> struct EXRPixelType<half> { static const Imf::PixelType value = Imf::HALF; };
+
+// Builds an EXR slice for one channel of `image`, offset so that pixel (0, 0)
+// of the image lands on the data window origin. The slice strides follow the
+// image layout (xStride == sizeof(sample) for planar images).
+template <typename T>
+Imf::Slice channelSlice(const BasicImageData<T>& image, int c, const Imath::Box2i& data_window,
+                        double fill_value = 0.0) {
+    size_t x_stride = sizeof(T) * image.pixelStride();
+    size_t y_stride = x_stride * image.width;
+    char* base = reinterpret_cast<char*>(const_cast<T*>(image.data.data() + c * image.channelStride())) -
+                 data_window.min.x * x_stride - data_window.min.y * y_stride;
+    return Imf::Slice(EXRPixelType<T>::value, base, x_stride, y_stride, 1, 1, fill_value);
+}
+
+// Widen/narrow contiguous runs of samples (F16C / NEON when available)
+void halfToFloat(const half* src, float* dst, size_t count);
+void floatToHalf(const float* src, half* dst, size_t count);
+
+// Widen/narrow between storage types; the output keeps the input layout
+void convertToHalf(const ImageData& input, HalfImageData& output);
+void convertToFloat(const HalfImageData& input, ImageData& output);
+
+// Runs a float kernel over a half image a few rows at a time. Each block is
+// widened into a small float buffer, processed and narrowed back, so only
+// point-wise kernels (no neighbourhood reads across blocks) may be used.
+void processHalfRows(HalfImageData& image, const std::function<void(ImageData&)>& kernel,
+                     int block_rows = 16);
+
+class ResultCache;
+class IncrementalCompositor;
+struct PassLayer;
+
+// Runs a neighbourhood kernel on the part of `image` inside `roi` (EXR frame
+// coordinates, clipped to the data window). Only the roi plus `halo` pixels of
+// context is copied out and processed, and only the roi is written back, so
+// the cost follows the region rather than the frame.
+void processRegion(ImageData& image, const Imath::Box2i& roi, int halo,
+                   const std::function<void(ImageData&)>& kernel);
+
+// Copies the part of `image` inside `window` (EXR frame coordinates) into a
+// new image with that data window; returns false when they do not overlap
+bool cropImage(const ImageData& image, const Imath::Box2i& window, ImageData& output);
+
+// Orders channel names R, G, B, A first, then the remaining channels by name.
+void sortChannelNames(std::vector<std::string>& channel_names);
+
 class EXRProcessor {
 public:
     EXRProcessor();
     ~EXRProcessor();
     
+    // Layout used for images created by the loaders and addRenderPass
+    void setPixelLayout(PixelLayout layout) { pixel_layout_ = layout; }
+    PixelLayout pixelLayout() const { return pixel_layout_; }
+    
+    // Channel type written by saveEXR(ImageData) and saveMultiPlaneEXR
+    // (Imf::FLOAT or Imf::HALF)
+    void setOutputPixelType(Imf::PixelType type) { output_pixel_type_ = type; }
+    Imf::PixelType outputPixelType() const { return output_pixel_type_; }
+    // Codec used by the saves that take no EXRWriteOptions
+    void setOutputCompression(Imf::Compression compression) { output_compression_ = compression; }
+    Imf::Compression outputCompression() const { return output_compression_; }
+    
+    // Threads OpenEXR uses to compress and decompress line blocks. Files are
+    // read and written with the whole frame in one call, so every block of a
+    // frame is coded in parallel. Defaults to ThreadPool::defaultThreadCount()
+    // unless the application set Imf::setGlobalThreadCount itself.
+    static void setCodecThreadCount(int thread_count);
+    
+    // Optional content-addressed cache consulted by applyGaussianBlur,
+    // compositePasses and blendPasses; may be shared between processors
+    void setResultCache(std::shared_ptr<ResultCache> cache) { result_cache_ = std::move(cache); }
+    ResultCache* resultCache() const { return result_cache_.get(); }
+    
+    // Keeps the last stack composited by compositeLayers (or by an uncached
+    // compositePasses over same-shaped passes), so compositing it again after
+    // a pass changed only redoes the tiles that pass touched; costs a frame
+    // per layer (see IncrementalCompositor). Stacks it rejects are composited
+    // from scratch.
+    void setIncrementalCompositing(bool enabled);
+    bool incrementalCompositing() const { return incremental_ != nullptr; }
+    
     // EXR file operations
     bool loadEXR(const std::string& filepath, ImageData& image);
     bool saveEXR(const std::string& filepath, const ImageData& image);
-    bool loadMultiPlaneEXR(const std::string& filepath, std::vector<RenderPass>& passes);
+    bool loadEXR(const std::string& filepath, HalfImageData& image);
+    bool saveEXR(const std::string& filepath, const HalfImageData& image);
+    
+    // Zero-copy RGBA decode into caller-owned or pooled memory of at least
+    // width * height * 4 floats (see getEXRSize). loadEXR also decodes in place
+    // and reuses the image's existing allocation when it is large enough.
+    bool getEXRSize(const std::string& filepath, int& width, int& height);
+    bool loadEXRInto(const std::string& filepath, float* buffer, size_t buffer_floats,
+                     PixelLayout layout = PixelLayout::INTERLEAVED);
+    // Decodes all requested layers in a single pass over the file. `filter` may
+    // list layer names ("diffuse") or full channel names ("diffuse.R"); an
+    // empty filter loads every layer.
+    bool loadMultiPlaneEXR(const std::string& filepath, std::vector<RenderPass>& passes,
+                           const std::vector<std::string>& filter = {});
     bool saveMultiPlaneEXR(const std::string& filepath, const std::vector<RenderPass>& passes);
+    bool saveMultiPlaneEXR(const std::string& filepath, const std::vector<RenderPass>& passes,
+                           const EXRWriteOptions& options);
+    // Any channel count; channels are named R, G, B, A, then by index
+    bool saveEXR(const std::string& filepath, const ImageData& image, const EXRWriteOptions& options);
     
     // Multi-pass rendering
     void addRenderPass(const std::string& name, int width, int height, int channels, bool is_alpha = false);
     RenderPass* getRenderPass(const std::string& name);
     void clearPasses();
+    // Writes each pass to path_prefix + name + ".exr" as its own task, so the
+    // passes encode side by side; max_concurrency > 0 caps the files in flight.
+    // Channels are named as by saveEXR with EXRWriteOptions, so any count works.
+    bool saveRenderPasses(const std::string& path_prefix, int max_concurrency = 0);
     
     // Image filtering
     void applyGaussianBlur(ImageData& image, float sigma, int kernel_size = 0);
     void applySharpen(ImageData& image, float strength);
     void applyEdgeDetection(ImageData& image);
     void applyToneMapping(ImageData& image, float exposure = 1.0f, float gamma = 2.2f);
+    void applyToneMapping(HalfImageData& image, float exposure = 1.0f, float gamma = 2.2f);
+    // The viewer's display curve (Reinhard), for exports that match the screen
+    void applyDisplayToneMapping(ImageData& image, float exposure = 1.0f, float gamma = 2.2f);
+    void applyDisplayToneMapping(HalfImageData& image, float exposure = 1.0f, float gamma = 2.2f);
     
     // Compositing operations
     void compositePasses(const std::vector<std::string>& pass_names, ImageData& output);
+    // Single-sweep layer stack over named passes (see Compositor::compositeLayers);
+    // returns false when a pass or mask is missing or the sizes differ
+    bool compositeLayers(const std::vector<PassLayer>& layers, ImageData& output, bool clamp = true);
     void blendPasses(const RenderPass& pass1, const RenderPass& pass2, 
                     ImageData& output, float blend_factor = 0.5f);
     void addPass(const RenderPass& pass, ImageData& output, float opacity = 1.0f);
@@ -74,30 +346,68 @@ public:
     void overlayPass(const RenderPass& pass, ImageData& output);
     
     // Utility functions
-    void resizeImage(const ImageData& input, ImageData& output, int new_width, int new_height);
+    // Separable resize through Resampler; downscales are prefiltered. Bilinear
+    // unless asked otherwise: Lanczos3 is sharper but its negative lobes ring
+    // and can undershoot zero on HDR edges. Keep a Resampler instead when many
+    // frames share the same sizes.
+    void resizeImage(const ImageData& input, ImageData& output, int new_width, int new_height,
+                     ResampleFilter filter = ResampleFilter::BILINEAR);
     void convertToLinear(ImageData& image);
     void convertToSRGB(ImageData& image);
+    void convertToLinear(HalfImageData& image);
+    void convertToSRGB(HalfImageData& image);
     void normalizeImage(ImageData& image);
     
 private:
     std::map<std::string, std::unique_ptr<RenderPass>> render_passes_;
+    PixelLayout pixel_layout_;
+    Imf::PixelType output_pixel_type_;
+    Imf::Compression output_compression_;
+    std::shared_ptr<ResultCache> result_cache_;
+    std::unique_ptr<IncrementalCompositor> incremental_;
     
     // Helper functions
+    void gaussianBlurUncached(ImageData& image, float sigma, int kernel_size);
+    void blendPassesUncached(const RenderPass& pass1, const RenderPass& pass2,
+                             ImageData& output, float blend_factor);
     void createGaussianKernel(std::vector<float>& kernel, float sigma, int size);
     float gaussian(float x, float sigma);
-    void applyKernel(const ImageData& input, ImageData& output, 
-                    const std::vector<float>& kernel, int kernel_size);
     void clampPixel(float& value, float min_val = 0.0f, float max_val = 1.0f);
 };
 
 // Filtering algorithms
 class ImageFilters {
 public:
+    // Direct separable kernel (radius ceil(2 sigma)) below sigma 8, stackedBoxBlur above
     static void gaussianBlur(ImageData& image, float sigma);
+    // Rows then columns with a normalised 1D kernel centred on its middle tap
+    static void separableConvolve(ImageData& image, const std::vector<float>& kernel);
+    // Gaussian approximation from `passes` running-sum box blurs with matched variance;
+    // cost per sample does not depend on sigma
+    static void stackedBoxBlur(ImageData& image, float sigma, int passes = 3);
+    // 1D kernels gaussianBlur applies along rows and columns in turn, for other backends
+    static std::vector<std::vector<float>> gaussianBlurKernels(float sigma);
+    // Rows either side of a pixel that gaussianBlur reads for the given sigma
+    static int gaussianBlurRadius(float sigma);
     static void sharpen(ImageData& image, float strength);
+    // Rec. 601 luma through a 3x3 Sobel (magnitude, clamped to 1) or Laplacian
+    // (absolute response) with zero padding, broadcast to every channel.
+    // Images with fewer than 3 channels (mattes) are filtered on channel 0.
     static void sobelEdgeDetection(ImageData& image);
     static void laplacianEdgeDetection(ImageData& image);
+    // Same values as a single-channel mask, leaving the image untouched
+    static void sobelEdgeMask(const ImageData& image, ImageData& mask);
+    static void laplacianEdgeMask(const ImageData& image, ImageData& mask);
     static void unsharpMask(ImageData& image, float radius, float amount, float threshold);
+    
+    // Region-of-interest versions (EXR frame coordinates): only the roi and the
+    // kernel halo around it are computed, pixels outside the roi are untouched
+    static void gaussianBlur(ImageData& image, float sigma, const Imath::Box2i& roi);
+    static void sharpen(ImageData& image, float strength, const Imath::Box2i& roi);
+    static void sobelEdgeDetection(ImageData& image, const Imath::Box2i& roi);
+    static void laplacianEdgeDetection(ImageData& image, const Imath::Box2i& roi);
+    static void unsharpMask(ImageData& image, float radius, float amount, float threshold,
+                            const Imath::Box2i& roi);
 };
 
 // Compositing operations
@@ -116,10 +426,108 @@ public:
         LINEAR_BURN
     };
     
+    // The result keeps the base's data and display windows. The overlay is
+    // placed by its data window; outside of it (and outside `roi`, when given)
+    // the result is the base, so a small FX element only costs its own pixels.
     static void blend(const ImageData& base, const ImageData& overlay, 
                      ImageData& result, BlendMode mode, float opacity = 1.0f);
+    static void blend(const ImageData& base, const ImageData& overlay, 
+                     ImageData& result, BlendMode mode, float opacity, const Imath::Box2i& roi);
+    static void blend(const HalfImageData& base, const HalfImageData& overlay, 
+                     HalfImageData& result, BlendMode mode, float opacity = 1.0f);
+    
+    // One entry of a layer stack. The optional mask scales the opacity per
+    // pixel with its alpha channel (channel 0 when it has fewer than four).
+    struct Layer {
+        const ImageData* image;
+        BlendMode mode;
+        float opacity;
+        const ImageData* mask;
+    };
+    
+    // Composites layers bottom-up, all of them per tile in one sweep, so each
+    // output sample is written to memory once. The bottom layer (scaled by its
+    // opacity and mask; its mode is ignored) starts the accumulator. With
+    // `clamp` every layer is clamped to [0, 1] like blend(); without it HDR
+    // values stay linear. All layers and masks must have the same size.
+    static bool compositeLayers(const std::vector<Layer>& layers, ImageData& result, bool clamp = true);
     static void premultiplyAlpha(ImageData& image);
     static void unpremultiplyAlpha(ImageData& image);
 };
 
+// Keeps a layer stack's composite between calls so that compositing the stack
+// again only redoes the tiles whose inputs changed. Each call hashes every
+// layer and mask in blocks of 16K pixels and compares them with
+// the previous call; a block whose hash moved is recomposited from the lowest
+// changed layer up. With `keep_partials` the accumulator after every layer
+// below the top is stored as well, so a change to layer k replays only layers
+// k and above; without it a dirty block replays the whole stack and only the
+// result is kept. A change of a layer's mode, opacity or mask dirties that
+// layer everywhere; another frame size, layer count or clamp starts over.
+//
+// Layers are replayed in order with the same kernels as
+// Compositor::compositeLayers, so result() is bit-identical to compositing
+// the stack from scratch.
+class IncrementalCompositor {
+public:
+    struct Stats {
+        size_t blocks = 0;          // Blocks the frame is tracked in
+        size_t dirty_blocks = 0;    // Blocks recomposited by the last call
+        size_t layer_blends = 0;    // Layers blended over those blocks, summed
+        bool full = false;          // Last call started over
+    };
+    
+    explicit IncrementalCompositor(bool keep_partials = true);
+    
+    // Same contract as Compositor::compositeLayers, into result(); false
+    // (and the state cleared) when the layers do not match, or when one of
+    // them is result() itself
+    bool composite(const std::vector<Compositor::Layer>& layers, bool clamp = true);
+    // composite() that diffs only the layers listed in `changed` (indices
+    // into `layers`); the others must hold the pixels of the last call. Saves
+    // reading the untouched layers when the caller knows what it edited.
+    bool update(const std::vector<Compositor::Layer>& layers, const std::vector<size_t>& changed,
+                bool clamp = true);
+    
+    const ImageData& result() const { return result_; }
+    const Stats& lastStats() const { return stats_; }
+    // Composite, partials and block hashes
+    size_t bytesUsed() const;
+    // Frees the state; the next call composites everything
+    void clear();
+    
+private:
+    // What a layer contributed with at the last call, besides its pixels
+    struct LayerState {
+        Compositor::BlendMode mode = Compositor::NORMAL;
+        float opacity = 0.0f;
+        int channels = 0;
+        PixelLayout layout = PixelLayout::INTERLEAVED;
+        int mask_channels = 0;      // 0 without a mask
+        PixelLayout mask_layout = PixelLayout::INTERLEAVED;
+        std::vector<uint64_t> hashes;   // Image and mask, per block
+    };
+    
+    bool run(const std::vector<Compositor::Layer>& layers, const std::vector<char>& suspect, bool clamp);
+    
+    bool keep_partials_;
+    bool clamp_;
+    std::vector<LayerState> layers_;
+    std::vector<ImageData> partials_;   // Accumulator after layers 0 .. n - 2
+    ImageData result_;
+    Stats stats_;
+};
+
+// Layer of EXRProcessor::compositeLayers, naming its render pass and optional mask pass
+struct PassLayer {
+    std::string pass;
+    Compositor::BlendMode mode;
+    float opacity;
+    std::string mask;
+    
+    PassLayer(const std::string& p, Compositor::BlendMode m = Compositor::LINEAR_DODGE,
+              float o = 1.0f, const std::string& mask_pass = "")
+        : pass(p), mode(m), opacity(o), mask(mask_pass) {}
+};
+
 } // namespace ImageProcessing
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// A filter stage for EXRStreamProcessor. `halo` is the number of rows of
+// context the stage reads above and below each output row.
+struct StreamFilter {
+    std::string name;
+    int halo;
+    std::function<void(ImageData&)> apply;
+};
+
+// Processes a scanline EXR in horizontal strips so that peak memory is bounded
+// by the strip height instead of the frame size. Each strip is read together
+// with enough halo rows for the whole filter chain, filtered, and its core
+// rows are written straight to the output file.
+class EXRStreamProcessor {
+public:
+    explicit EXRStreamProcessor(int strip_height = 64);
+
+    // Filter chain
+    void addFilter(const StreamFilter& filter);
+    void addGaussianBlur(float sigma);
+    void addSharpen(float strength);
+    void addEdgeDetection();
+    void addUnsharpMask(float radius, float amount, float threshold);
+    void addToneMapping(float exposure = 1.0f, float gamma = 2.2f);
+    void clearFilters();
+
+    // Streams every channel of input_path through the filter chain into output_path
+    bool process(const std::string& input_path, const std::string& output_path);
+
+    void setStripHeight(int strip_height);
+    int stripHeight() const { return strip_height_; }
+    int halo() const;
+    size_t peakBufferBytes() const { return peak_buffer_bytes_; }
+
+private:
+    int strip_height_;
+    std::vector<StreamFilter> filters_;
+    size_t peak_buffer_bytes_;
+};
+
+} // namespace ImageProcessing
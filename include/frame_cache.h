@@ -0,0 +1,62 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// Thread-safe LRU cache of decoded frames with a memory budget. Frames are
+// shared read-only, so an evicted frame stays valid for whoever still holds it.
+class FrameCache {
+public:
+    typedef std::shared_ptr<const ImageData> FramePtr;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        double hitRate() const { return (hits + misses) ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+    };
+
+    explicit FrameCache(size_t budget_bytes = size_t(2) << 30);
+
+    // Counted lookup that also marks the frame as most recently used
+    FramePtr find(const std::string& key);
+    // Uncounted lookup that leaves the LRU order alone
+    FramePtr peek(const std::string& key) const;
+    bool contains(const std::string& key) const;
+
+    // Evicts least recently used frames until the new one fits; frames larger
+    // than the whole budget are not cached
+    void insert(const std::string& key, FramePtr frame);
+    void erase(const std::string& key);
+    void clear();
+
+    void setBudget(size_t budget_bytes);
+    size_t budget() const;
+    size_t bytesUsed() const;
+    size_t size() const;
+
+    Stats stats() const;
+    void resetStats();
+
+    static size_t frameBytes(const ImageData& frame) { return frame.data.size() * sizeof(float); }
+
+private:
+    typedef std::list<std::pair<std::string, FramePtr>> EntryList;
+
+    void evictToFit(size_t incoming);
+
+    EntryList entries_;     // Most recently used first
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    size_t budget_bytes_;
+    size_t used_bytes_;
+    Stats stats_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace ImageProcessing
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ImageProcessing {
+
+// Recycles the large sample buffers behind ImageData. Every block is 64-byte
+// aligned. Blocks above kMinPooledBytes are rounded up to a size class (four
+// per power of two), so frames of one resolution share a class and a freed
+// frame goes straight to the next one instead of back to the OS. Reused memory
+// is already faulted in, which removes the page-fault cost of fresh
+// multi-hundred-MB buffers in long batches.
+class FramePool {
+public:
+    static const size_t kAlignment = 64;
+    static const size_t kMinPooledBytes = 256 * 1024;
+
+    struct Stats {
+        size_t allocations = 0;         // Pooled-size requests
+        size_t reuses = 0;              // ... served from the free lists
+        size_t bytes_cached = 0;        // Free blocks held for reuse
+        size_t bytes_outstanding = 0;   // Pooled blocks currently in use
+        size_t bytes_live = 0;          // All blocks in use, pooled or not
+        size_t bytes_peak = 0;          // High-water mark of bytes_live
+    };
+
+    explicit FramePool(size_t retain_bytes = size_t(2) << 30);
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    static FramePool& global();
+
+    void* allocate(size_t bytes);
+    void deallocate(void* block, size_t bytes);
+
+    // Upper bound on free memory kept for reuse; blocks past it are released
+    void setRetainLimit(size_t bytes);
+    size_t retainLimit() const;
+    // Releases every cached block
+    void trim();
+
+    Stats stats() const;
+    // Restarts the high-water mark at the current live size
+    void resetPeak();
+
+    // Bytes actually reserved for a request of `bytes`
+    static size_t sizeClass(size_t bytes);
+
+private:
+    void releaseToFit(size_t incoming);
+    void trackLive(size_t bytes);
+
+    std::map<size_t, std::vector<void*>> free_blocks_;   // By size class
+    size_t retain_bytes_;
+    Stats stats_;
+    std::atomic<size_t> live_bytes_;
+    std::atomic<size_t> peak_bytes_;
+    mutable std::mutex mutex_;
+};
+
+// Allocator for ImageData storage backed by FramePool::global(). Value
+// construction without arguments default-initialises, so resize() leaves
+// new samples uninitialised for buffers that are about to be overwritten;
+// the ImageData constructor still zero-fills.
+template <typename T>
+struct PoolAllocator {
+    typedef T value_type;
+
+    PoolAllocator() noexcept {}
+    template <typename U> PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(FramePool::global().allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        FramePool::global().deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value) {
+        ::new (static_cast<void*>(p)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return true; }
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return false; }
+
+} // namespace ImageProcessing
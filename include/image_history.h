@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// Frame split into square tiles held by shared pointer. Copies share every
+// tile, and assign() reuses the tiles of a reference frame whose samples did
+// not change, so a run of similar frames only stores the tiles that differ.
+// Each tile keeps its samples in the frame's layout: whole interleaved pixels
+// row by row, or one block per channel for planar frames.
+class TiledImage {
+public:
+    typedef std::vector<float> Tile;
+    typedef std::shared_ptr<const Tile> TilePtr;
+
+    static const int kDefaultTileSize = 128;
+
+    TiledImage();
+
+    // Nothing is shared when the reference is null or has another shape
+    void assign(const ImageData& image, const TiledImage* reference = nullptr,
+                int tile_size = kDefaultTileSize);
+    void toImage(ImageData& image) const;
+    void clear();
+
+    bool empty() const { return tiles_.empty(); }
+    int width() const { return header_.width; }
+    int height() const { return header_.height; }
+    int tileSize() const { return tile_size_; }
+    const std::vector<TilePtr>& tiles() const { return tiles_; }
+    // Tiles taken over from the reference by the last assign()
+    size_t sharedTiles() const { return shared_tiles_; }
+    // Sum over all tiles, whether or not another frame shares them
+    size_t bytes() const;
+
+private:
+    ImageData header_;          // Shape and windows only; data stays empty
+    int tile_size_;
+    int tiles_x_;
+    int tiles_y_;
+    std::vector<TilePtr> tiles_;
+    size_t shared_tiles_;
+};
+
+// Checkpoints of an edit chain for undo and redo. State n is the frame after
+// the first n edits of the chain. A stored state shares unchanged tiles with
+// the nearest state below it. When the tiles held by all states go over the
+// budget, the states with the fewest edits are dropped first; the state
+// stored last is always kept, even when deeper states (left for redo after
+// an undo) exist. Safe to call from several threads.
+//
+// Every call that invalidates states returns a new epoch, and store() ignores
+// frames tagged with an older one, so a job that outlives an undo or a source
+// change cannot put a frame of a dead chain back.
+class ImageHistory {
+public:
+    explicit ImageHistory(size_t budget_bytes = size_t(1) << 30);
+
+    uint64_t clear();
+    // Drops the states after `steps` edits, for when the chain changes from there
+    uint64_t truncate(size_t steps);
+    uint64_t epoch() const;
+
+    void store(uint64_t epoch, size_t steps, const ImageData& image);
+    // Deepest state with at most max_steps edits; false when there is none
+    bool restore(size_t max_steps, size_t& steps, ImageData& image) const;
+
+    void setBudget(size_t bytes);
+    size_t budget() const;
+    // Each tile is counted once however many states share it
+    size_t bytesUsed() const;
+    size_t stateCount() const;
+
+private:
+    size_t uniqueBytes() const;
+    void enforceBudget();
+
+    std::map<size_t, TiledImage> states_;
+    uint64_t epoch_;
+    size_t budget_bytes_;
+    size_t bytes_used_;
+    size_t newest_steps_;       // Key of the state stored last
+    mutable std::mutex mutex_;
+};
+
+} // namespace ImageProcessing
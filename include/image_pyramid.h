@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// Mip chain of 2x box-filtered reductions used for proxy-resolution previews.
+// level(n) is the base image reduced by 2^n (n >= 1); the base itself is not
+// copied, so level 0 is whatever the caller built the pyramid from.
+class ImagePyramid {
+public:
+    // Reduces until a side would drop below min_dimension or max_levels is reached (< 0: no limit)
+    void build(const ImageData& base, int max_levels = -1, int min_dimension = 1);
+    void clear() { levels_.clear(); }
+
+    int levelCount() const { return static_cast<int>(levels_.size()); }
+    const ImageData& level(int n) const { return levels_[n - 1]; }
+
+    // Deepest reduction of a width x height image that still covers the target size
+    static int levelForSize(int width, int height, int target_width, int target_height);
+
+    // Averages 2x2 blocks; an odd last row or column is averaged with itself
+    static void downsample2x(const ImageData& input, ImageData& output);
+
+    // Gives output the offset and display window of input reduced by 2^levels,
+    // so a proxy lines up with the frame it came from
+    static void reduceWindows(const ImageData& input, ImageData& output, int levels = 1);
+
+private:
+    std::vector<ImageData> levels_;
+};
+
+} // namespace ImageProcessing
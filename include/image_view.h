@@ -0,0 +1,91 @@
+#pragma once
+
+#include <utility>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// Non-owning view of an image whose channel count and layout are template
+// parameters, so sample offsets are compile-time multiples of the row
+// pointer and per-pixel channel loops unroll. Channels == 0 keeps the count
+// dynamic for the uncommon shapes. Views come from ViewShape<C, L>::view();
+// ImageData stays the owning type and is never resized through a view.
+template <typename T, int Channels, PixelLayout Layout>
+struct ImageView {
+    T* base;
+    int width;
+    int height;
+    int dynamic_channels;   // Read only when Channels == 0
+    size_t plane;           // Samples per channel plane
+
+    int channels() const { return Channels > 0 ? Channels : dynamic_channels; }
+
+    // Distance between horizontally adjacent samples of one channel
+    size_t pixelStride() const {
+        return Layout == PixelLayout::PLANAR ? 1 : static_cast<size_t>(channels());
+    }
+    size_t channelStride() const { return Layout == PixelLayout::PLANAR ? plane : 1; }
+
+    // Separate runs one row is stored in: a plane per channel, or one interleaved run
+    int planes() const { return Layout == PixelLayout::PLANAR ? channels() : 1; }
+    // Samples in each of those runs
+    size_t rowSamples() const { return static_cast<size_t>(width) * pixelStride(); }
+
+    // First sample of row y in channel (or plane) c
+    T* row(int y, int c = 0) const {
+        return base + static_cast<size_t>(y) * width * pixelStride() + c * channelStride();
+    }
+
+    T& operator()(int x, int y, int c) const {
+        return base[(static_cast<size_t>(y) * width + x) * pixelStride() + c * channelStride()];
+    }
+};
+
+// Compile-time image shape handed to the kernels by dispatchShape()
+template <int Channels, PixelLayout Layout>
+struct ViewShape {
+    static const int channels = Channels;
+    static const PixelLayout layout = Layout;
+
+    template <typename T>
+    static ImageView<T, Channels, Layout> view(BasicImageData<T>& image) {
+        return {image.data.data(), image.width, image.height, image.channels,
+                static_cast<size_t>(image.width) * image.height};
+    }
+
+    template <typename T>
+    static ImageView<const T, Channels, Layout> view(const BasicImageData<T>& image) {
+        return {image.data.data(), image.width, image.height, image.channels,
+                static_cast<size_t>(image.width) * image.height};
+    }
+};
+
+// Calls fn(ViewShape<C, L>()) for an image with `channels` channels in
+// `layout`: C is 1, 3 or 4 when the image has that many, 0 otherwise. A
+// single channel has one layout in memory, so it always gets the interleaved
+// shape. fn is usually a generic lambda that builds its views from the shape.
+template <typename Fn>
+void dispatchShape(int channels, PixelLayout layout, Fn&& fn) {
+    if (channels == 1) {
+        fn(ViewShape<1, PixelLayout::INTERLEAVED>());
+    } else if (layout == PixelLayout::PLANAR) {
+        switch (channels) {
+            case 3: fn(ViewShape<3, PixelLayout::PLANAR>()); break;
+            case 4: fn(ViewShape<4, PixelLayout::PLANAR>()); break;
+            default: fn(ViewShape<0, PixelLayout::PLANAR>()); break;
+        }
+    } else {
+        switch (channels) {
+            case 3: fn(ViewShape<3, PixelLayout::INTERLEAVED>()); break;
+            case 4: fn(ViewShape<4, PixelLayout::INTERLEAVED>()); break;
+            default: fn(ViewShape<0, PixelLayout::INTERLEAVED>()); break;
+        }
+    }
+}
+
+template <typename T, typename Fn>
+void dispatchShape(const BasicImageData<T>& image, Fn&& fn) {
+    dispatchShape(image.channels, image.layout, std::forward<Fn>(fn));
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+class ColorLUT;
+
+// Point-wise kernel over `count` interleaved pixels of `channels` samples each
+typedef std::function<void(float* pixels, size_t count, int channels)> PointKernel;
+
+// Lazily recorded chain of image operations. Nothing runs until run() is
+// called; consecutive point-wise operations are then fused into one pass that
+// walks the frame in L1-sized tiles and applies every operation to a tile
+// before moving on, so a chain of N point ops reads and writes the frame once
+// instead of N times. Neighbourhood operations such as blurs read other
+// pixels, so they are fusion barriers and run as whole-frame passes.
+class PixelPipeline {
+public:
+    // Point-wise operations, with the same results as the EXRProcessor/Compositor versions
+    PixelPipeline& toneMap(float exposure = 1.0f, float gamma = 2.2f);
+    PixelPipeline& toLinear();
+    PixelPipeline& toSRGB();
+    PixelPipeline& lut(const ColorLUT& table, float exposure = 1.0f);  // RGB only, as ColorLUT::apply
+    PixelPipeline& premultiplyAlpha();
+    PixelPipeline& unpremultiplyAlpha();
+    PixelPipeline& gain(float factor);          // Alpha untouched
+    PixelPipeline& clamp(float min_val = 0.0f, float max_val = 1.0f);
+    PixelPipeline& pointOp(const std::string& name, const PointKernel& kernel);
+
+    // Fusion barriers
+    PixelPipeline& gaussianBlur(float sigma);
+    PixelPipeline& sharpen(float strength);
+    PixelPipeline& edgeDetection();
+    PixelPipeline& imageOp(const std::string& name, const std::function<void(ImageData&)>& op);
+
+    // Evaluates the recorded chain in place
+    void run(ImageData& image) const;
+    void run(HalfImageData& image) const;
+
+    void clear() { stages_.clear(); }
+    bool empty() const { return stages_.empty(); }
+    size_t size() const { return stages_.size(); }
+    // Full-frame passes run() makes after fusion
+    int passCount() const;
+
+private:
+    struct Stage {
+        std::string name;
+        PointKernel point;                        // Set for point-wise stages
+        std::function<void(ImageData&)> image;    // Set for barriers
+    };
+
+    void runPointStages(ImageData& image, size_t first, size_t last) const;
+
+    std::vector<Stage> stages_;
+};
+
+} // namespace ImageProcessing
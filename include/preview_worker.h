@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// Background evaluation of interactive previews. The render thread describes
+// the preview it wants with submit() and never waits: one worker reduces an
+// immutable source frame to the requested pyramid level, runs the edit steps
+// on its own copy and publishes the result, which the render thread picks up
+// with takeResult() on a later redraw. Steps parallelise through the shared
+// ThreadPool as usual.
+//
+// Only the newest request is kept, so requests made while the worker is busy
+// coalesce. A request with the same generation and more steps continues from
+// the frame the worker already holds and runs only the new steps. A request
+// with a new generation (another source, level or edit list) cancels the job
+// in flight at the next step boundary; with a resume callback it restarts
+// from a checkpoint instead of the source.
+class PreviewWorker {
+public:
+    typedef std::shared_ptr<const ImageData> FramePtr;
+    typedef std::function<void(ImageData& image)> Step;
+
+    struct Request {
+        uint64_t generation = 0;
+        FramePtr source;            // Full-resolution frame; never modified
+        int level = 0;              // Pyramid level the steps run on
+        // Reduction to that level: BOX repeats the 2x pyramid step, the
+        // other filters resample once to the same size
+        ResampleFilter reduce_filter = ResampleFilter::BOX;
+        std::vector<Step> steps;    // Every step of this generation, oldest first
+        // Optional checkpoint for a generation that starts over: fills the
+        // image with the frame after the returned number of steps, at the
+        // request level, or returns 0 to start from the source
+        std::function<size_t(ImageData& image)> resume;
+    };
+
+    struct Result {
+        uint64_t generation = 0;
+        size_t steps = 0;           // Leading steps of the request applied to image
+        FramePtr image;             // The source itself when there is nothing to do
+        double milliseconds = 0.0;
+    };
+
+    PreviewWorker();
+    ~PreviewWorker();
+
+    PreviewWorker(const PreviewWorker&) = delete;
+    PreviewWorker& operator=(const PreviewWorker&) = delete;
+
+    // Replaces any request the worker has not started yet
+    void submit(Request request);
+    // Drops the pending request and abandons the running one
+    void cancel();
+
+    // Newest finished result, if one arrived since the last call
+    bool takeResult(Result& result);
+    bool busy() const;
+
+private:
+    void run();
+    bool cancelled(uint64_t generation) const;
+
+    // Worker-side state, reused when a request only appends steps
+    uint64_t generation_;
+    size_t applied_;
+    FramePtr frame_;
+
+    Request pending_;
+    bool has_pending_;
+    bool running_;
+    Result result_;
+    bool has_result_;
+    bool stopping_;
+    std::atomic<uint64_t> latest_generation_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+} // namespace ImageProcessing
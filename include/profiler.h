@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// Hot-path instrumentation. Scopes record wall time, bytes read and written
+// and pixels processed; results export as Chrome trace JSON (chrome://tracing,
+// Perfetto) and as a JSON summary with per-scope and per-frame totals plus
+// the peak ImageData memory. Recording is off until setEnabled(true) or
+// SCBW_PROFILE=1; a disabled scope costs one relaxed load and no clock read.
+// Building with SCBW_DISABLE_PROFILING compiles the scopes out entirely.
+//
+// With SCBW_PROFILE set, SCBW_PROFILE_TRACE and SCBW_PROFILE_SUMMARY name
+// files that are written when the process exits.
+class Profiler {
+public:
+    struct ScopeStats {
+        size_t calls = 0;
+        double total_ms = 0.0;
+        double max_ms = 0.0;
+        uint64_t bytes_read = 0;
+        uint64_t bytes_written = 0;
+        uint64_t pixels = 0;
+        double megapixelsPerSecond() const { return total_ms > 0.0 ? pixels / (total_ms * 1000.0) : 0.0; }
+    };
+
+    struct Event {
+        const char* name;       // Static string
+        int thread;
+        int frame;              // -1 outside a FrameScope
+        int64_t start_us;
+        int64_t duration_us;
+        uint64_t bytes_read;
+        uint64_t bytes_written;
+        uint64_t pixels;
+    };
+
+    static Profiler& global();
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // Drops recorded events and restarts the peak memory measurement
+    void reset();
+
+    void record(const Event& event);
+    // Events past the limit are counted but not kept (default one million)
+    void setEventLimit(size_t limit);
+    size_t droppedEvents() const;
+
+    std::map<std::string, ScopeStats> summary() const;
+    std::vector<Event> events() const;
+
+    bool writeChromeTrace(const std::string& path) const;
+    bool writeSummary(const std::string& path) const;
+
+    static int64_t nowMicroseconds();
+    static int threadIndex();
+
+    // Frame that scopes on the calling thread are attributed to
+    static int currentFrame();
+    static void setCurrentFrame(int frame);
+
+private:
+    Profiler();
+
+    static std::atomic<bool> enabled_;
+
+    std::vector<Event> events_;
+    size_t event_limit_;
+    size_t dropped_;
+    mutable std::mutex mutex_;
+};
+
+#if !defined(SCBW_DISABLE_PROFILING)
+
+// Times the enclosing block when profiling is enabled
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name_(name), active_(Profiler::enabled()) {
+        if (active_) start();
+    }
+
+    // Counts the image as read and written in place
+    template <typename T>
+    ProfileScope(const char* name, const BasicImageData<T>& image) : ProfileScope(name) {
+        if (active_) {
+            addPixels(static_cast<uint64_t>(image.width) * image.height);
+            addRead(image.data.size() * sizeof(T));
+            addWritten(image.data.size() * sizeof(T));
+        }
+    }
+
+    ~ProfileScope() {
+        if (active_) finish();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    bool active() const { return active_; }
+    void addRead(uint64_t bytes) { if (active_) event_.bytes_read += bytes; }
+    void addWritten(uint64_t bytes) { if (active_) event_.bytes_written += bytes; }
+    void addPixels(uint64_t pixels) { if (active_) event_.pixels += pixels; }
+
+    template <typename T>
+    void addImageRead(const BasicImageData<T>& image) {
+        if (active_) addRead(image.data.size() * sizeof(T));
+    }
+
+    template <typename T>
+    void addImageWritten(const BasicImageData<T>& image) {
+        if (active_) {
+            addWritten(image.data.size() * sizeof(T));
+            addPixels(static_cast<uint64_t>(image.width) * image.height);
+        }
+    }
+
+private:
+    void start() {
+        event_ = Profiler::Event();
+        event_.name = name_;
+        event_.start_us = Profiler::nowMicroseconds();
+    }
+
+    void finish() {
+        event_.duration_us = Profiler::nowMicroseconds() - event_.start_us;
+        event_.thread = Profiler::threadIndex();
+        event_.frame = Profiler::currentFrame();
+        Profiler::global().record(event_);
+    }
+
+    const char* name_;
+    bool active_;
+    Profiler::Event event_;
+};
+
+#else
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char*) {}
+    template <typename T> ProfileScope(const char*, const BasicImageData<T>&) {}
+    bool active() const { return false; }
+    void addRead(uint64_t) {}
+    void addWritten(uint64_t) {}
+    void addPixels(uint64_t) {}
+    template <typename T> void addImageRead(const BasicImageData<T>&) {}
+    template <typename T> void addImageWritten(const BasicImageData<T>&) {}
+};
+
+#endif
+
+// Attributes scopes on this thread to a frame until it goes out of scope
+class FrameScope {
+public:
+    explicit FrameScope(int frame) : previous_(Profiler::currentFrame()) { Profiler::setCurrentFrame(frame); }
+    ~FrameScope() { Profiler::setCurrentFrame(previous_); }
+
+    FrameScope(const FrameScope&) = delete;
+    FrameScope& operator=(const FrameScope&) = delete;
+
+private:
+    int previous_;
+};
+
+} // namespace ImageProcessing
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// Uncompressed frame format for hand-offs between pipeline stages on local or
+// scratch storage ("*.scbwraw"). A 64-byte file header and one 128-byte
+// record per pass are followed by the pass samples, each pass starting on a
+// 4 KB boundary so a mapping only faults in the pages of the passes a reader
+// touches. All fields are little-endian:
+//
+//   file header   char magic[8] = "SCBWRAW1", u32 version, u32 pass_count,
+//                 u64 data_offset, 40 reserved bytes
+//   pass record   char name[64] (NUL padded), i32 width, height, channels,
+//                 u32 layout (0 interleaved, 1 planar), u32 sample type
+//                 (1 half, 2 float), i32 x_offset, y_offset,
+//                 i32 display_window[4] (min x, min y, max x, max y),
+//                 u32 reserved, u64 offset, u64 bytes
+//
+// Samples are stored exactly as in ImageData, so a pass can be used in place
+// through views or copied with one memcpy per frame.
+enum class RawSampleType : uint32_t {
+    HALF = 1,
+    FLOAT = 2
+};
+
+template <typename T> struct RawSampleTypeOf;
+template <> struct RawSampleTypeOf<half> { static const RawSampleType value = RawSampleType::HALF; };
+template <> struct RawSampleTypeOf<float> { static const RawSampleType value = RawSampleType::FLOAT; };
+
+struct RawPassInfo {
+    std::string name;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    PixelLayout layout = PixelLayout::INTERLEAVED;
+    RawSampleType sample_type = RawSampleType::FLOAT;
+    int x_offset = 0;
+    int y_offset = 0;
+    Imath::Box2i display_window;
+    uint64_t offset = 0;            // From the start of the file, page aligned
+    uint64_t bytes = 0;
+
+    size_t sampleBytes() const { return sample_type == RawSampleType::HALF ? sizeof(half) : sizeof(float); }
+    size_t pixelStride() const { return layout == PixelLayout::PLANAR ? 1 : channels; }
+    size_t channelStride() const {
+        return layout == PixelLayout::PLANAR ? static_cast<size_t>(width) * height : 1;
+    }
+};
+
+// Passes are written in order with the given sample type; names must be
+// unique and at most 63 bytes. The file is written next to `filepath` and
+// renamed into place, so readers never map a partly written frame.
+bool saveRawFrame(const std::string& filepath, const std::vector<RenderPass>& passes,
+                  RawSampleType sample_type = RawSampleType::FLOAT);
+bool saveRawFrame(const std::string& filepath, const std::string& pass_name, const ImageData& image,
+                  RawSampleType sample_type = RawSampleType::FLOAT);
+bool saveRawFrame(const std::string& filepath, const std::string& pass_name, const HalfImageData& image);
+
+// True when the file starts with the raw frame magic
+bool isRawFrame(const std::string& filepath);
+
+// Read-only mapping of a raw frame. Nothing but the header is read by
+// open(); pass samples are paged in on first access, so a reader that uses
+// two passes of a twenty-pass frame only reads those two from disk.
+class RawFrame {
+public:
+    RawFrame();
+    ~RawFrame();
+
+    RawFrame(const RawFrame&) = delete;
+    RawFrame& operator=(const RawFrame&) = delete;
+
+    bool open(const std::string& filepath);
+    void close();
+    bool isOpen() const { return mapping_ != nullptr; }
+    const std::string& path() const { return path_; }
+
+    const std::vector<RawPassInfo>& passes() const { return passes_; }
+    const RawPassInfo* findPass(const std::string& name) const;
+
+    // Samples of a pass inside the mapping, valid until close()
+    const void* passData(const RawPassInfo& pass) const;
+
+    // Zero-copy channel view; false when the pass is missing, the channel is
+    // out of range or the pass is stored with another sample type
+    template <typename T>
+    bool channel(const std::string& pass_name, int c, BasicChannelView<const T>& view) const {
+        const RawPassInfo* pass = findPass(pass_name);
+        if (!pass || c < 0 || c >= pass->channels || pass->sample_type != RawSampleTypeOf<T>::value) {
+            return false;
+        }
+        const T* base = static_cast<const T*>(passData(*pass));
+        view = {base + c * pass->channelStride(), pass->width, pass->height,
+                pass->pixelStride(), pass->width * pass->pixelStride()};
+        return true;
+    }
+
+    // Asks the kernel to start reading a pass ahead of use
+    void prefetch(const RawPassInfo& pass) const;
+
+    // Copies a pass into pooled memory with the requested layout, widening or
+    // narrowing the samples if needed; windows are taken from the record
+    bool readPass(const std::string& pass_name, ImageData& image, PixelLayout layout) const;
+    bool readPass(const std::string& pass_name, HalfImageData& image, PixelLayout layout) const;
+    // First pass as four channels, like EXRProcessor::loadEXR: missing colour
+    // channels read as 0, a missing alpha as 1, extra channels are dropped
+    bool readRGBA(ImageData& image, PixelLayout layout) const;
+    bool readRGBA(HalfImageData& image, PixelLayout layout) const;
+
+private:
+    std::string path_;
+    void* mapping_;
+    size_t mapping_bytes_;
+    std::vector<RawPassInfo> passes_;
+};
+
+} // namespace ImageProcessing
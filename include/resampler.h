@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include "exr_processor.h"
+
+namespace ImageProcessing {
+
+// Separable resize with the filter taps computed once per output column and
+// once per output row. Downscales stretch the filter by the reduction factor,
+// so every source pixel contributes and fine detail does not alias; upscales
+// use the filter at its natural width. Pixels past the edges repeat the edge
+// pixel. Rows are filtered into a temporary and then combined down the
+// columns, both passes row-parallel and SIMD.
+//
+// The taps depend only on the sizes and the filter, so one Resampler serves
+// every frame of a sequence; keep one per delivery resolution.
+class Resampler {
+public:
+    Resampler();
+    Resampler(int src_width, int src_height, int dst_width, int dst_height,
+              ResampleFilter filter = ResampleFilter::LANCZOS3);
+
+    // input must be sourceWidth() x sourceHeight(). output takes the target
+    // size with the input's channels and layout, at the origin; output may
+    // be the input. False when the input has another size.
+    bool resample(const ImageData& input, ImageData& output) const;
+
+    // One-off resize that builds the taps for this call
+    static void resize(const ImageData& input, ImageData& output, int width, int height,
+                       ResampleFilter filter = ResampleFilter::LANCZOS3);
+
+    // Radius of the filter at scale 1, in source pixels
+    static float support(ResampleFilter filter);
+
+    int sourceWidth() const { return horizontal_.source; }
+    int sourceHeight() const { return vertical_.source; }
+    int targetWidth() const { return horizontal_.target; }
+    int targetHeight() const { return vertical_.target; }
+    ResampleFilter filter() const { return filter_; }
+    // Taps per output sample along x and y
+    int horizontalTaps() const { return horizontal_.taps; }
+    int verticalTaps() const { return vertical_.taps; }
+
+private:
+    // Output i of an axis reads `taps` consecutive source samples starting
+    // at first[i], with weights[i * taps ...] that sum to one
+    struct Axis {
+        int source = 0;
+        int target = 0;
+        int taps = 0;
+        std::vector<int> first;
+        std::vector<float> weights;
+    };
+    static Axis buildAxis(int source, int target, ResampleFilter filter);
+
+    ResampleFilter filter_;
+    Axis horizontal_;
+    Axis vertical_;
+};
+
+} // namespace ImageProcessing
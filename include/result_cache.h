@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "frame_cache.h"
+
+namespace ImageProcessing {
+
+// Content-addressed cache of filter and composite results. A key hashes the
+// operation name, its parameters and the content of its inputs, so a result is
+// reused whenever the same work is asked for again, whichever image object or
+// script asks. Results live in an LRU memory tier and, optionally, in an LRU
+// directory of raw blobs that survives between runs.
+class ResultCache {
+public:
+    typedef uint64_t Key;
+    typedef FrameCache::FramePtr ResultPtr;
+
+    // Builds a key from an operation name followed by its parameters and inputs
+    class KeyBuilder {
+    public:
+        explicit KeyBuilder(const std::string& operation);
+
+        KeyBuilder& add(Key value);
+        KeyBuilder& add(int value);
+        KeyBuilder& add(float value);
+        KeyBuilder& add(const std::string& value);
+        KeyBuilder& add(const ImageData& image) { return add(hashImage(image)); }
+
+        Key key() const;
+
+    private:
+        uint64_t state_;
+    };
+
+    struct Stats {
+        size_t memory_hits = 0;
+        size_t disk_hits = 0;
+        size_t misses = 0;
+        size_t disk_evictions = 0;
+        double hitRate() const {
+            size_t lookups = memory_hits + disk_hits + misses;
+            return lookups ? static_cast<double>(memory_hits + disk_hits) / lookups : 0.0;
+        }
+    };
+
+    explicit ResultCache(size_t memory_budget = size_t(1) << 30);
+
+    // Hash of the dimensions, layout and samples; reads the image once on the thread pool
+    static Key hashImage(const ImageData& image);
+    // Hash of `count` raw samples, chained through `seed`; runs on the calling thread
+    static Key hashSamples(const float* samples, size_t count, Key seed = 0);
+    // Hash of a file's path, size and modification time (the pixels are not read)
+    static Key hashFile(const std::string& path);
+
+    // Memory tier first, then the disk tier; a disk hit is promoted to memory
+    ResultPtr find(Key key);
+    void insert(Key key, ResultPtr result);
+    void insert(Key key, const ImageData& result);
+
+    // Copies a cached result into `output`, or runs compute(output) and caches it
+    void getOrCompute(Key key, ImageData& output, const std::function<void(ImageData&)>& compute);
+
+    // Enables the disk tier in an existing directory, adopting the blobs already there
+    bool setDiskCache(const std::string& directory, size_t budget_bytes);
+    void disableDiskCache();
+    bool diskCacheEnabled() const;
+
+    void setMemoryBudget(size_t budget_bytes) { memory_.setBudget(budget_bytes); }
+    size_t memoryBytesUsed() const { return memory_.bytesUsed(); }
+    size_t diskBytesUsed() const;
+
+    // Drops the memory tier; blobs on disk are kept
+    void clear() { memory_.clear(); }
+
+    Stats stats() const;
+    void resetStats();
+
+    static std::string keyString(Key key);
+
+private:
+    typedef std::list<std::pair<Key, size_t>> DiskList;
+
+    // Caller holds mutex_
+    std::string blobPath(Key key) const;
+    void evictDiskToFit(size_t incoming);
+    // Lock mutex_ themselves, only around the index
+    ResultPtr readBlob(Key key);
+    void writeBlob(Key key, const ImageData& result);
+
+    FrameCache memory_;
+
+    // Disk tier, most recently used first
+    std::string disk_directory_;
+    size_t disk_budget_bytes_;
+    size_t disk_used_bytes_;
+    DiskList disk_entries_;
+    std::unordered_map<Key, DiskList::iterator> disk_index_;
+    std::unordered_set<Key> disk_writing_;  // Blobs being written; their bytes count as used
+    uint64_t disk_generation_;              // Bumped when the directory is replaced
+
+    Stats stats_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace ImageProcessing
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_cache.h"
+
+namespace ImageProcessing {
+
+// Flipbook playback of a frame sequence. Worker threads decode the frames
+// ahead of the playhead into a FrameCache; update() picks the frame due at the
+// target fps and never waits for a decode. If the due frame is not ready the
+// previous one stays on screen, and frames that were due but never shown are
+// counted as dropped.
+class SequencePlayer {
+public:
+    struct Stats {
+        int shown = 0;
+        int dropped = 0;
+        FrameCache::Stats cache;
+    };
+
+    explicit SequencePlayer(size_t cache_budget_bytes = size_t(2) << 30, int decode_threads = 2);
+    ~SequencePlayer();
+
+    SequencePlayer(const SequencePlayer&) = delete;
+    SequencePlayer& operator=(const SequencePlayer&) = delete;
+
+    // printf-style pattern such as "beauty.%04d.exr"; starts paused on the first frame
+    bool open(const std::string& pattern, int first_frame, int last_frame, int step = 1);
+    void close();
+
+    void play();
+    void pause();
+    bool playing() const { return playing_; }
+    void seek(int index);
+    void stepFrames(int delta);
+
+    // Call once per redraw; returns the frame to display when it changed, null otherwise
+    FrameCache::FramePtr update();
+
+    void setFps(double fps);
+    double fps() const { return fps_; }
+    void setLoop(bool loop) { loop_ = loop; }
+    // Frames decoded ahead of the playhead (capped by what fits in the cache)
+    void setPrefetch(int frames);
+
+    int frameCount() const { return static_cast<int>(paths_.size()); }
+    int currentIndex() const { return position_; }
+    int currentFrame() const { return first_frame_ + position_ * step_; }
+
+    Stats stats() const;
+    void resetStats();
+    FrameCache& cache() { return cache_; }
+
+private:
+    void schedulePrefetch();
+    void decodeLoop();
+    size_t prefetchDepth() const;
+    void startWorkers(int count);
+    void stopWorkers();
+
+    FrameCache cache_;
+    std::vector<std::string> paths_;
+    int first_frame_;
+    int step_;
+    double fps_;
+    bool loop_;
+    int prefetch_;
+
+    bool playing_;
+    int position_;                  // Index of the frame on screen (or requested while paused)
+    int shown_index_;               // Index last returned by update(), -1 when none
+    long long shown_tick_;
+    long long lookup_tick_;
+    int play_start_index_;
+    std::chrono::steady_clock::time_point play_start_;
+    int shown_count_;
+    int dropped_count_;
+
+    // Decode queue shared with the workers
+    std::deque<int> requests_;
+    std::set<int> in_flight_;
+    std::set<int> failed_;
+    size_t frame_bytes_;            // Size of a decoded frame, 0 until one is seen
+    bool stopping_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::thread> workers_;
+    int decode_threads_;
+};
+
+} // namespace ImageProcessing
@@ -0,0 +1,252 @@
+#pragma once
+
+// Minimal float vector wrapper used by the hot kernels. The widest instruction
+// set enabled at compile time is picked: AVX (8 lanes, whenever __AVX__ is
+// defined: configure with -DSCBW_AVX2=ON or -DSCBW_NATIVE_ARCH=ON), SSE2
+// (4 lanes, the x86-64 baseline), NEON on AArch64 (4 lanes), or a scalar
+// fallback. Kernels are written once as templates over the value type, so
+// the same code also runs on plain floats for loop tails.
+//
+// exponent/mantissa/exp2i expose the IEEE-754 fields for polynomial
+// log2/exp2 (see color_lut.h); inputs are assumed finite and normal.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SCBW_SIMD_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCBW_SIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SCBW_SIMD_NEON 1
+#endif
+
+namespace ImageProcessing {
+namespace simd {
+
+#if defined(SCBW_SIMD_AVX)
+
+struct VecF {
+    static const int width = 8;
+    __m256 v;
+
+    VecF() : v(_mm256_setzero_ps()) {}
+    VecF(__m256 value) : v(value) {}
+    VecF(float value) : v(_mm256_set1_ps(value)) {}
+
+    static VecF load(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+struct MaskF {
+    __m256 m;
+    MaskF(__m256 value) : m(value) {}
+};
+
+inline VecF operator+(VecF a, VecF b) { return _mm256_add_ps(a.v, b.v); }
+inline VecF operator-(VecF a, VecF b) { return _mm256_sub_ps(a.v, b.v); }
+inline VecF operator*(VecF a, VecF b) { return _mm256_mul_ps(a.v, b.v); }
+inline VecF operator/(VecF a, VecF b) { return _mm256_div_ps(a.v, b.v); }
+inline VecF min(VecF a, VecF b) { return _mm256_min_ps(a.v, b.v); }
+inline VecF max(VecF a, VecF b) { return _mm256_max_ps(a.v, b.v); }
+inline VecF sqrt(VecF a) { return _mm256_sqrt_ps(a.v); }
+inline VecF abs(VecF a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline MaskF lt(VecF a, VecF b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline MaskF gt(VecF a, VecF b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline MaskF le(VecF a, VecF b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline VecF select(MaskF m, VecF a, VecF b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+inline VecF round(VecF a) { return _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline VecF exponent(VecF a) {
+    __m256 bits = _mm256_and_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800000)));
+    __m256 biased = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(bits)), _mm256_set1_ps(1.0f / 8388608.0f));
+    return _mm256_sub_ps(biased, _mm256_set1_ps(127.0f));
+}
+inline VecF mantissa(VecF a) {
+    __m256 bits = _mm256_and_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(0x007fffff)));
+    return _mm256_or_ps(bits, _mm256_set1_ps(1.0f));
+}
+// 2^n for integral n in [-126, 127]; (n + 127) * 2^23 is exact, so the
+// conversion yields the exponent field directly
+inline VecF exp2i(VecF n) {
+    __m256 field = _mm256_mul_ps(_mm256_add_ps(n.v, _mm256_set1_ps(127.0f)), _mm256_set1_ps(8388608.0f));
+    return _mm256_castsi256_ps(_mm256_cvtps_epi32(field));
+}
+
+#elif defined(SCBW_SIMD_SSE2)
+
+struct VecF {
+    static const int width = 4;
+    __m128 v;
+
+    VecF() : v(_mm_setzero_ps()) {}
+    VecF(__m128 value) : v(value) {}
+    VecF(float value) : v(_mm_set1_ps(value)) {}
+
+    static VecF load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+struct MaskF {
+    __m128 m;
+    MaskF(__m128 value) : m(value) {}
+};
+
+inline VecF operator+(VecF a, VecF b) { return _mm_add_ps(a.v, b.v); }
+inline VecF operator-(VecF a, VecF b) { return _mm_sub_ps(a.v, b.v); }
+inline VecF operator*(VecF a, VecF b) { return _mm_mul_ps(a.v, b.v); }
+inline VecF operator/(VecF a, VecF b) { return _mm_div_ps(a.v, b.v); }
+inline VecF min(VecF a, VecF b) { return _mm_min_ps(a.v, b.v); }
+inline VecF max(VecF a, VecF b) { return _mm_max_ps(a.v, b.v); }
+inline VecF sqrt(VecF a) { return _mm_sqrt_ps(a.v); }
+inline VecF abs(VecF a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline MaskF lt(VecF a, VecF b) { return _mm_cmplt_ps(a.v, b.v); }
+inline MaskF gt(VecF a, VecF b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline MaskF le(VecF a, VecF b) { return _mm_cmple_ps(a.v, b.v); }
+inline VecF select(MaskF m, VecF a, VecF b) {
+    return _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v));
+}
+
+// Round to nearest under the default MXCSR mode; |a| must be below 2^31
+inline VecF round(VecF a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)); }
+inline VecF exponent(VecF a) {
+    __m128 bits = _mm_and_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(0x7f800000)));
+    __m128 biased = _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(bits)), _mm_set1_ps(1.0f / 8388608.0f));
+    return _mm_sub_ps(biased, _mm_set1_ps(127.0f));
+}
+inline VecF mantissa(VecF a) {
+    __m128 bits = _mm_and_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(0x007fffff)));
+    return _mm_or_ps(bits, _mm_set1_ps(1.0f));
+}
+inline VecF exp2i(VecF n) {
+    __m128 field = _mm_mul_ps(_mm_add_ps(n.v, _mm_set1_ps(127.0f)), _mm_set1_ps(8388608.0f));
+    return _mm_castsi128_ps(_mm_cvtps_epi32(field));
+}
+
+#elif defined(SCBW_SIMD_NEON)
+
+struct VecF {
+    static const int width = 4;
+    float32x4_t v;
+
+    VecF() : v(vdupq_n_f32(0.0f)) {}
+    VecF(float32x4_t value) : v(value) {}
+    VecF(float value) : v(vdupq_n_f32(value)) {}
+
+    static VecF load(const float* p) { return vld1q_f32(p); }
+    void store(float* p) const { vst1q_f32(p, v); }
+};
+
+struct MaskF {
+    uint32x4_t m;
+    MaskF(uint32x4_t value) : m(value) {}
+};
+
+inline VecF operator+(VecF a, VecF b) { return vaddq_f32(a.v, b.v); }
+inline VecF operator-(VecF a, VecF b) { return vsubq_f32(a.v, b.v); }
+inline VecF operator*(VecF a, VecF b) { return vmulq_f32(a.v, b.v); }
+inline VecF operator/(VecF a, VecF b) { return vdivq_f32(a.v, b.v); }
+inline VecF min(VecF a, VecF b) { return vminq_f32(a.v, b.v); }
+inline VecF max(VecF a, VecF b) { return vmaxq_f32(a.v, b.v); }
+inline VecF sqrt(VecF a) { return vsqrtq_f32(a.v); }
+inline VecF abs(VecF a) { return vabsq_f32(a.v); }
+inline MaskF lt(VecF a, VecF b) { return vcltq_f32(a.v, b.v); }
+inline MaskF gt(VecF a, VecF b) { return vcgtq_f32(a.v, b.v); }
+inline MaskF le(VecF a, VecF b) { return vcleq_f32(a.v, b.v); }
+inline VecF select(MaskF m, VecF a, VecF b) { return vbslq_f32(m.m, a.v, b.v); }
+inline VecF round(VecF a) { return vrndnq_f32(a.v); }
+inline VecF exponent(VecF a) {
+    uint32x4_t bits = vandq_u32(vreinterpretq_u32_f32(a.v), vdupq_n_u32(0x7f800000u));
+    return vsubq_f32(vcvtq_f32_u32(vshrq_n_u32(bits, 23)), vdupq_n_f32(127.0f));
+}
+inline VecF mantissa(VecF a) {
+    uint32x4_t bits = vandq_u32(vreinterpretq_u32_f32(a.v), vdupq_n_u32(0x007fffffu));
+    return vreinterpretq_f32_u32(vorrq_u32(bits, vdupq_n_u32(0x3f800000u)));
+}
+inline VecF exp2i(VecF n) {
+    uint32x4_t field = vcvtq_u32_f32(vaddq_f32(n.v, vdupq_n_f32(127.0f)));
+    return vreinterpretq_f32_u32(vshlq_n_u32(field, 23));
+}
+
+#else
+
+struct VecF {
+    static const int width = 1;
+    float v;
+
+    VecF() : v(0.0f) {}
+    VecF(float value) : v(value) {}
+
+    static VecF load(const float* p) { return *p; }
+    void store(float* p) const { *p = v; }
+};
+
+struct MaskF {
+    bool m;
+    MaskF(bool value) : m(value) {}
+};
+
+inline VecF operator+(VecF a, VecF b) { return a.v + b.v; }
+inline VecF operator-(VecF a, VecF b) { return a.v - b.v; }
+inline VecF operator*(VecF a, VecF b) { return a.v * b.v; }
+inline VecF operator/(VecF a, VecF b) { return a.v / b.v; }
+inline VecF min(VecF a, VecF b) { return a.v < b.v ? a.v : b.v; }
+inline VecF max(VecF a, VecF b) { return a.v > b.v ? a.v : b.v; }
+inline VecF sqrt(VecF a) { return std::sqrt(a.v); }
+inline VecF abs(VecF a) { return std::fabs(a.v); }
+inline MaskF lt(VecF a, VecF b) { return a.v < b.v; }
+inline MaskF gt(VecF a, VecF b) { return a.v > b.v; }
+inline MaskF le(VecF a, VecF b) { return a.v <= b.v; }
+inline VecF select(MaskF m, VecF a, VecF b) { return m.m ? a : b; }
+
+#endif
+
+// Scalar overloads with the same semantics as the vector versions
+// (min/max return the second operand when either is NaN, like minps/maxps).
+inline float min(float a, float b) { return a < b ? a : b; }
+inline float max(float a, float b) { return a > b ? a : b; }
+inline float sqrt(float a) { return std::sqrt(a); }
+inline float abs(float a) { return std::fabs(a); }
+inline bool lt(float a, float b) { return a < b; }
+inline bool gt(float a, float b) { return a > b; }
+inline bool le(float a, float b) { return a <= b; }
+inline float select(bool m, float a, float b) { return m ? a : b; }
+inline float round(float a) { return std::nearbyint(a); }
+inline float exponent(float a) {
+    uint32_t bits;
+    std::memcpy(&bits, &a, sizeof(bits));
+    return static_cast<float>(static_cast<int>((bits >> 23) & 0xffu) - 127);
+}
+inline float mantissa(float a) {
+    uint32_t bits;
+    std::memcpy(&bits, &a, sizeof(bits));
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+    return m;
+}
+inline float exp2i(float n) {
+    uint32_t bits = static_cast<uint32_t>(static_cast<int>(n) + 127) << 23;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+#if !defined(SCBW_SIMD_AVX) && !defined(SCBW_SIMD_SSE2) && !defined(SCBW_SIMD_NEON)
+inline VecF round(VecF a) { return round(a.v); }
+inline VecF exponent(VecF a) { return exponent(a.v); }
+inline VecF mantissa(VecF a) { return mantissa(a.v); }
+inline VecF exp2i(VecF n) { return exp2i(n.v); }
+#endif
+
+template <class V>
+inline V clamp01(V value) {
+    return max(min(value, V(1.0f)), V(0.0f));
+}
+
+} // namespace simd
+} // namespace ImageProcessing
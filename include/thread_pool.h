@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace ImageProcessing {
+
+// Shared work-stealing pool used by the row/tile-parallel kernels and by task
+// groups. Each worker keeps its own deque: it pushes and pops tasks at the
+// back, and idle threads steal from the front of the others, so the large
+// tasks queued first are the ones that move. Threads outside the pool queue
+// their tasks on a shared injection queue.
+//
+// Parallelism nests: a parallelFor or TaskGroup started inside a task queues
+// its work like any other, and a thread waiting for it runs queued tasks
+// instead of blocking. Frames, passes and rows can therefore all be tasks of
+// one pool, and small jobs fill the cores a large one leaves idle. The pool
+// never starts threads beyond its own, so the thread count is the core
+// budget of the process; the calling thread takes part in waits, so a pool
+// of N - 1 workers keeps N cores busy.
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+    // worker_count <= 0 uses defaultThreadCount()
+    explicit ThreadPool(int worker_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& global();
+    // SCBW_NUM_THREADS when set, otherwise the cores this process may use:
+    // the CPU affinity mask and, on Linux, the cgroup CPU quota, so jobs
+    // pinned or limited by the farm scheduler size themselves to their share
+    static int defaultThreadCount();
+
+    // Total threads taking part in a parallelFor, including the caller. Must
+    // not be called while tasks are queued or running.
+    void setThreadCount(int thread_count);
+    int threadCount() const { return thread_count_.load(std::memory_order_relaxed); }
+
+    // Calls fn(chunk_begin, chunk_end) over [begin, end) in chunks of at least `grain`
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& fn);
+
+    // Queues a task; prefer TaskGroup, which can be waited on and keeps the
+    // submitting thread's profiler frame
+    void submit(Task task);
+    // Runs queued tasks on the calling thread until done() holds. signal()
+    // must be called whenever done() may have become true.
+    void waitUntil(const std::function<bool()>& done);
+    void signal();
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void startWorkers(int worker_count);
+    void stopWorkers();
+    void workerLoop(int index);
+    bool runOne(int self);
+    bool pop(int self, Task& task);
+
+    // Slots 0..N-1 belong to the workers, slot N is the injection queue
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<int> thread_count_;
+    std::atomic<int> queued_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+};
+
+// Tasks that are waited on together. Tasks may start further tasks, groups
+// and parallelFor loops; wait() runs queued work while it waits, so nesting
+// never deadlocks. With max_concurrency > 0 at most that many threads work
+// for the group at once, which caps the cores one job takes when several
+// share a process. The cap covers nested work as well: parallelFor helpers
+// and the tasks of groups started inside the group's tasks each take one of
+// its slots, or run on a thread that already holds one.
+class TaskGroup {
+public:
+    explicit TaskGroup(int max_concurrency = 0, ThreadPool& pool = ThreadPool::global());
+    // Waits for the tasks still running
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(ThreadPool::Task task);
+    void wait();
+
+    int maxConcurrency() const { return max_concurrency_; }
+
+private:
+    friend class ThreadPool;
+    struct State;
+    typedef std::shared_ptr<State> StatePtr;
+
+    // Innermost capped group the calling thread works for, or null
+    static StatePtr& current();
+    // Queues work started on the calling thread. Inside a capped group it
+    // runs only on a free slot of that group (and of the groups around it);
+    // `required` work that finds none waits for a thread inside the group,
+    // other work (loop helpers, whose chunks the caller takes) is dropped.
+    static void submit(ThreadPool& pool, ThreadPool::Task task, bool required);
+    // Runs one such waiting task of the calling thread's groups
+    static bool runWaiting(ThreadPool& pool);
+    static bool hasWaiting(ThreadPool& pool);
+
+    ThreadPool& pool_;
+    int max_concurrency_;
+    std::shared_ptr<State> state_;
+};
+
+// Row-parallel loop on the global pool
+void parallelFor(int begin, int end, const std::function<void(int, int)>& fn, int grain = 1);
+
+} // namespace ImageProcessing
@@ -2,7 +2,15 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include "exr_processor.h"
+#include "viewer_texture.h"
+#include "gpu_processor.h"
+#include "sequence_player.h"
+#include "image_pyramid.h"
+#include "color_lut.h"
+#include "preview_worker.h"
+#include "image_history.h"
 
 class Viewer {
 public:
@@ -13,9 +21,42 @@ private:
     bool initialized_;
     unsigned int shader_program_;
     unsigned int vao_, vbo_, ebo_;
-    unsigned int texture_id_;
-    ImageProcessing::ImageData current_image_;
+    StreamingTexture texture_;
+    StreamingTexture overlay_texture_;
+    GPUProcessor gpu_;
+    bool gpu_enabled_;
+    bool gpu_active_;       // The GPU frame, not texture_, is on screen
+    std::unique_ptr<ImageProcessing::SequencePlayer> player_;
+    ImageProcessing::FrameCache::FramePtr playback_frame_;  // Shown instead of current_image_ when set
+    ImageProcessing::FrameCache::FramePtr current_image_;   // Shared read-only with preview jobs
+    
+    // Edits are kept with full-resolution parameters so export can replay them
+    struct ViewerEdit {
+        std::string filter;     // "blur", "sharpen", "edges", "tonemap" or "blend"
+        float exposure = 1.0f;
+        float gamma = 2.2f;
+        std::shared_ptr<const ImageProcessing::ImageData> overlay;
+        // Reductions of overlay for proxy previews, built once so replays don't re-downsample
+        std::shared_ptr<const ImageProcessing::ImagePyramid> overlay_pyramid;
+        ImageProcessing::Compositor::BlendMode mode = ImageProcessing::Compositor::NORMAL;
+        float opacity = 1.0f;
+    };
+    std::vector<ViewerEdit> edits_;
+    std::vector<ViewerEdit> redo_;          // Undone edits, most recent last
+    // Preview frame after each edit, for undo and redo without replaying the chain
+    std::shared_ptr<ImageProcessing::ImageHistory> history_;
+    // CPU edits run on the worker; render() uploads whatever it has finished
+    ImageProcessing::PreviewWorker preview_worker_;
+    uint64_t preview_generation_;           // Bumped when the source, level or edit list is replaced
+    ImageProcessing::PreviewWorker::FramePtr preview_;  // Frame in texture_; null until the worker delivers
+    size_t preview_steps_;                  // Edits already applied to preview_
+    int preview_level_;                     // Pyramid level of the preview, 0 = full resolution
+    ImageProcessing::ResampleFilter proxy_filter_;  // How the source is reduced to preview_level_
+    int window_width_;
+    int window_height_;
     bool show_tonemapped_;
+    ImageProcessing::ColorLUT display_lut_;    // Replaces tonemap() in the shader when loaded
+    unsigned int lut_texture_;
     
     // Shader source code
     std::string vertex_shader_source_;
@@ -27,6 +68,16 @@ private:
     void setupQuad();
     void loadImageToTexture(const ImageProcessing::ImageData& image);
     void updateUniforms();
+    void uploadDisplayLUT();
+    ImageProcessing::FrameCache::FramePtr sourceFrame() const;
+    void pushEdit(const ViewerEdit& edit);
+    void refreshPreview();
+    void restartPreview();
+    void submitPreview(bool cpu_edits);
+    void collectPreview();
+    static void applyEdit(const ViewerEdit& edit, ImageProcessing::ImageData& image, int level);
+    bool applyEditOnGPU(const ViewerEdit& edit, int level);
+    void renderFullResolution(ImageProcessing::ImageData& output);
 
 public:
     Viewer();
@@ -38,13 +89,42 @@ public:
     
     // EXR processing integration
     bool loadEXRImage(const std::string& filepath);
+    // Flipbook mode over a printf-style pattern such as "beauty.%04d.exr"
+    bool loadSequence(const std::string& pattern, int first_frame, int last_frame, double fps = 24.0);
+    void togglePlayback();
+    void stepFrame(int delta);
+    void printPlaybackStats() const;
+    // Previews run on the pyramid level that matches the framebuffer size
+    void setWindowSize(int width, int height);
     void setExposure(float exposure);
     void setGamma(float gamma);
     void toggleTonemapping();
+    // Display transform from a .cube file (e.g. baked with ociobakelut),
+    // applied after exposure in place of the built-in Reinhard curve.
+    // ColorLUT::apply with the same exposure reproduces the displayed pixels.
+    bool setDisplayLUT(const std::string& cube_path);
+    void clearDisplayLUT();
+    // Filter that reduces the source to the preview level. BOX (the default)
+    // is the 2x pyramid; Mitchell or Lanczos3 show proxies without aliasing.
+    void setProxyFilter(ImageProcessing::ResampleFilter filter);
+    ImageProcessing::ResampleFilter proxyFilter() const { return proxy_filter_; }
+    // Uploads as GL_RGBA16F instead of GL_RGBA32F, halving transfer size
+    void setHalfFloatUpload(bool enabled);
+    bool halfFloatUpload() const;
     void applyFilter(const std::string& filter_type);
+    void applyBlend(const ImageProcessing::ImageData& overlay,
+                    ImageProcessing::Compositor::BlendMode mode, float opacity = 1.0f);
+    // Runs filters and blends as compute passes on the resident texture when GL 4.3 is available
+    void setGPUProcessing(bool enabled);
+    bool gpuProcessing() const { return gpu_enabled_; }
     
     // Image manipulation
     void resetImage();
+    // Step back and forward through the edit list; false when there is nothing to step to
+    bool undo();
+    bool redo();
+    // Memory for undo checkpoints (1 GB by default); states share unchanged tiles
+    void setHistoryBudget(size_t bytes);
     void saveCurrentImage(const std::string& filepath);
 };
 // REF_PLACE_10: Тут можна додати рефи на структури даних
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include "exr_processor.h"
+
+// Pixel format used when copying frames to the GPU
+enum class TextureUploadFormat {
+    FLOAT32,    // GL_RGBA32F storage, full precision
+    HALF16      // GL_RGBA16F storage, half the bus traffic and VRAM
+};
+
+// RGBA texture with immutable storage (glTexStorage2D) that is updated through a
+// ring of persistently mapped pixel unpack buffers. upload() writes the frame into
+// the next free buffer and queues glTexSubImage2D from it, so the copy to VRAM runs
+// asynchronously while the CPU goes on; a fence per buffer stops it from being
+// overwritten before the GPU has consumed it. Storage is only reallocated when the
+// frame size or upload format changes. Without GL 4.4 (glBufferStorage) the
+// buffers are orphaned and mapped per upload instead.
+class StreamingTexture {
+public:
+    StreamingTexture();
+    ~StreamingTexture();
+
+    StreamingTexture(const StreamingTexture&) = delete;
+    StreamingTexture& operator=(const StreamingTexture&) = delete;
+
+    // Needs a current GL context; ring_size buffers of one frame each are kept
+    void initialize(int ring_size = 3);
+    void cleanup();
+
+    bool upload(const ImageProcessing::ImageData& image);
+
+    void setUploadFormat(TextureUploadFormat format) { format_ = format; }
+    TextureUploadFormat uploadFormat() const { return format_; }
+
+    unsigned int textureId() const { return texture_id_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool persistentMapping() const { return persistent_; }
+
+private:
+    struct UploadBuffer {
+        unsigned int buffer = 0;
+        void* mapped = nullptr;     // Persistent mapping, null in the fallback path
+        size_t capacity = 0;
+        void* fence = nullptr;      // GLsync of the last transfer out of this buffer
+    };
+
+    void ensureStorage(int width, int height, TextureUploadFormat format);
+    void* acquireBuffer(UploadBuffer& slot, size_t bytes);
+    void waitForFence(UploadBuffer& slot);
+    void releaseBuffer(UploadBuffer& slot);
+
+    std::vector<UploadBuffer> ring_;
+    size_t next_;
+    unsigned int texture_id_;
+    int width_;
+    int height_;
+    TextureUploadFormat format_;
+    TextureUploadFormat storage_format_;
+    bool persistent_;
+    bool immutable_storage_;
+};
@@ -0,0 +1,252 @@
+#include "batch_processor.h"
+#include "profiler.h"
+#include "resampler.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace ImageProcessing {
+
+namespace {
+
+// A frame moving through the pipeline; `ok` is cleared when a stage fails
+struct BatchFrame {
+    size_t index = 0;
+    bool ok = true;
+    ImageData image;
+};
+
+// Blocking FIFO with a size limit; push waits while full, pop waits while empty
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)), closed_(false) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]() { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    // Returns false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    // Never blocks; used for the recycle path so the saver cannot stall on it
+    void offer(T item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.size() < capacity_) {
+            items_.push_back(std::move(item));
+            not_empty_.notify_one();
+        }
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+BatchProcessor::BatchProcessor(int queue_depth)
+    : queue_depth_(std::max(1, queue_depth)),
+      pixel_layout_(PixelLayout::INTERLEAVED), output_pixel_type_(Imf::FLOAT) {
+}
+
+void BatchProcessor::addOperation(const BatchOperation& operation) {
+    operations_.push_back(operation);
+}
+
+void BatchProcessor::addGaussianBlur(float sigma) {
+    addOperation({"gaussian_blur", [sigma](ImageData& image) {
+        ImageFilters::gaussianBlur(image, sigma);
+    }});
+}
+
+void BatchProcessor::addSharpen(float strength) {
+    addOperation({"sharpen", [strength](ImageData& image) {
+        ImageFilters::sharpen(image, strength);
+    }});
+}
+
+void BatchProcessor::addEdgeDetection() {
+    addOperation({"edge_detection", [](ImageData& image) {
+        ImageFilters::sobelEdgeDetection(image);
+    }});
+}
+
+void BatchProcessor::addResize(int width, int height, ResampleFilter filter) {
+    // The taps are built for the first frame and kept while the frame size does not change
+    std::shared_ptr<Resampler> resampler;
+    addOperation({"resize", [width, height, filter, resampler](ImageData& image) mutable {
+        if (!resampler || resampler->sourceWidth() != image.width || resampler->sourceHeight() != image.height) {
+            resampler = std::make_shared<Resampler>(image.width, image.height, width, height, filter);
+        }
+        resampler->resample(image, image);
+    }});
+}
+
+void BatchProcessor::addToneMapping(float exposure, float gamma) {
+    addOperation({"tone_mapping", [exposure, gamma](ImageData& image) {
+        EXRProcessor processor;
+        processor.applyToneMapping(image, exposure, gamma);
+    }});
+}
+
+void BatchProcessor::clearOperations() {
+    operations_.clear();
+}
+
+void BatchProcessor::setQueueDepth(int queue_depth) {
+    queue_depth_ = std::max(1, queue_depth);
+}
+
+std::vector<std::string> BatchProcessor::expandFramePattern(const std::string& pattern,
+                                                            int first_frame, int last_frame, int step) {
+    std::vector<std::string> paths;
+    if (step <= 0) return paths;
+
+    std::vector<char> buffer(pattern.size() + 32);
+    for (int frame = first_frame; frame <= last_frame; frame += step) {
+        int length = std::snprintf(buffer.data(), buffer.size(), pattern.c_str(), frame);
+        if (length < 0) break;
+        if (static_cast<size_t>(length) >= buffer.size()) {
+            buffer.resize(length + 1);
+            std::snprintf(buffer.data(), buffer.size(), pattern.c_str(), frame);
+        }
+        paths.emplace_back(buffer.data());
+    }
+    return paths;
+}
+
+bool BatchProcessor::processSequence(const std::string& input_pattern, const std::string& output_pattern,
+                                     int first_frame, int last_frame, int step) {
+    return process(expandFramePattern(input_pattern, first_frame, last_frame, step),
+                   expandFramePattern(output_pattern, first_frame, last_frame, step));
+}
+
+bool BatchProcessor::process(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) {
+    stats_ = BatchStats();
+    if (inputs.size() != outputs.size()) {
+        std::cerr << "Batch input and output lists differ in length: "
+                  << inputs.size() << " vs " << outputs.size() << std::endl;
+        return false;
+    }
+    if (inputs.empty()) return true;
+
+    auto wall_start = std::chrono::steady_clock::now();
+
+    BoundedQueue<BatchFrame> decoded(queue_depth_);
+    BoundedQueue<BatchFrame> processed(queue_depth_);
+    BoundedQueue<ImageData> recycled(queue_depth_ * 2 + 2);
+
+    double load_seconds = 0.0;
+    double save_seconds = 0.0;
+    int failed = 0;
+
+    // Each stage owns its EXRProcessor, so the loader and saver never share state
+    std::thread loader([&]() {
+        EXRProcessor processor;
+        processor.setPixelLayout(pixel_layout_);
+
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            BatchFrame frame;
+            frame.index = i;
+            recycled.tryPop(frame.image);
+
+            FrameScope frame_scope(static_cast<int>(i));
+            ProfileScope scope("batch.load");
+            auto start = std::chrono::steady_clock::now();
+            frame.ok = processor.loadEXR(inputs[i], frame.image);
+            load_seconds += secondsSince(start);
+
+            decoded.push(std::move(frame));
+        }
+        decoded.close();
+    });
+
+    std::thread saver([&]() {
+        EXRProcessor processor;
+        processor.setOutputPixelType(output_pixel_type_);
+
+        BatchFrame frame;
+        while (processed.pop(frame)) {
+            if (frame.ok) {
+                FrameScope frame_scope(static_cast<int>(frame.index));
+                ProfileScope scope("batch.save");
+                auto start = std::chrono::steady_clock::now();
+                frame.ok = processor.saveEXR(outputs[frame.index], frame.image);
+                save_seconds += secondsSince(start);
+            }
+            if (!frame.ok) ++failed;
+            recycled.offer(std::move(frame.image));
+        }
+    });
+
+    // Processing stays on the calling thread so the kernels can use the whole pool
+    double process_seconds = 0.0;
+    BatchFrame frame;
+    while (decoded.pop(frame)) {
+        if (frame.ok) {
+            FrameScope frame_scope(static_cast<int>(frame.index));
+            ProfileScope scope("batch.process");
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& operation : operations_) {
+                operation.apply(frame.image);
+            }
+            process_seconds += secondsSince(start);
+        }
+        processed.push(std::move(frame));
+    }
+    processed.close();
+
+    loader.join();
+    saver.join();
+
+    stats_.frames = static_cast<int>(inputs.size());
+    stats_.failed = failed;
+    stats_.load_seconds = load_seconds;
+    stats_.process_seconds = process_seconds;
+    stats_.save_seconds = save_seconds;
+    stats_.wall_seconds = secondsSince(wall_start);
+    return failed == 0;
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,257 @@
+#include "color_lut.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace ImageProcessing {
+
+namespace {
+
+const int kMaxCubeSize = 256;
+
+// Lattice coordinate of v on a table of `size` entries spanning [lo, hi]
+inline float latticeCoord(float v, float lo, float hi, int size) {
+    float t = (hi > lo) ? (v - lo) / (hi - lo) : 0.0f;
+    t = std::max(0.0f, std::min(1.0f, t));
+    return t * (size - 1);
+}
+
+inline void splitCoord(float coord, int size, int& i0, int& i1, float& frac) {
+    i0 = std::min(static_cast<int>(coord), size - 1);
+    i1 = std::min(i0 + 1, size - 1);
+    frac = coord - i0;
+}
+
+// Strips a trailing comment so "0.1 0.2 0.3 # note" still parses
+std::string stripComment(const std::string& line) {
+    size_t hash = line.find('#');
+    return hash == std::string::npos ? line : line.substr(0, hash);
+}
+
+} // namespace
+
+ColorLUT::ColorLUT() : type_(LUT_1D), size_(0) {
+    for (int c = 0; c < 3; ++c) {
+        domain_min_[c] = 0.0f;
+        domain_max_[c] = 1.0f;
+    }
+}
+
+bool ColorLUT::loadCube(const std::string& filepath) {
+    std::ifstream file(filepath.c_str());
+    if (!file) {
+        std::cerr << "Failed to open LUT: " << filepath << std::endl;
+        return false;
+    }
+
+    ColorLUT lut;
+    size_t expected = 0;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        std::istringstream fields(stripComment(line));
+        std::string keyword;
+        if (!(fields >> keyword)) continue;
+
+        if (keyword == "TITLE") {
+            size_t open = line.find('"');
+            size_t close = line.rfind('"');
+            if (open != std::string::npos && close > open) {
+                lut.title_ = line.substr(open + 1, close - open - 1);
+            }
+        } else if (keyword == "LUT_1D_SIZE" || keyword == "LUT_3D_SIZE") {
+            lut.type_ = (keyword == "LUT_1D_SIZE") ? LUT_1D : LUT_3D;
+            int limit = (lut.type_ == LUT_1D) ? 65536 : kMaxCubeSize;
+            if (!(fields >> lut.size_) || lut.size_ < 2 || lut.size_ > limit) {
+                std::cerr << "Invalid " << keyword << " in LUT: " << filepath << std::endl;
+                return false;
+            }
+            expected = (lut.type_ == LUT_1D) ? lut.size_
+                     : static_cast<size_t>(lut.size_) * lut.size_ * lut.size_;
+            lut.table_.reserve(expected * 3);
+        } else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX") {
+            float* domain = (keyword == "DOMAIN_MIN") ? lut.domain_min_ : lut.domain_max_;
+            if (!(fields >> domain[0] >> domain[1] >> domain[2])) {
+                std::cerr << "Invalid " << keyword << " in LUT: " << filepath << std::endl;
+                return false;
+            }
+        } else if (keyword == "LUT_1D_INPUT_RANGE" || keyword == "LUT_3D_INPUT_RANGE") {
+            // Older Resolve form: one range shared by all three channels
+            float lo, hi;
+            if (!(fields >> lo >> hi)) {
+                std::cerr << "Invalid " << keyword << " in LUT: " << filepath << std::endl;
+                return false;
+            }
+            for (int c = 0; c < 3; ++c) {
+                lut.domain_min_[c] = lo;
+                lut.domain_max_[c] = hi;
+            }
+        } else {
+            std::istringstream values(stripComment(line));
+            float r, g, b;
+            if (!(values >> r >> g >> b)) {
+                std::cerr << "Unrecognised line " << line_number << " in LUT: " << filepath << std::endl;
+                return false;
+            }
+            if (expected == 0 || lut.table_.size() >= expected * 3) {
+                std::cerr << "Unexpected table entry at line " << line_number << " in LUT: " << filepath << std::endl;
+                return false;
+            }
+            lut.table_.push_back(r);
+            lut.table_.push_back(g);
+            lut.table_.push_back(b);
+        }
+    }
+
+    if (expected == 0 || lut.table_.size() != expected * 3) {
+        std::cerr << "Incomplete LUT table: " << filepath << std::endl;
+        return false;
+    }
+
+    *this = std::move(lut);
+    return true;
+}
+
+bool ColorLUT::saveCube(const std::string& filepath) const {
+    if (empty()) return false;
+
+    std::FILE* file = std::fopen(filepath.c_str(), "w");
+    if (!file) {
+        std::cerr << "Failed to write LUT: " << filepath << std::endl;
+        return false;
+    }
+
+    if (!title_.empty()) std::fprintf(file, "TITLE \"%s\"\n", title_.c_str());
+    std::fprintf(file, "%s %d\n", type_ == LUT_1D ? "LUT_1D_SIZE" : "LUT_3D_SIZE", size_);
+    std::fprintf(file, "DOMAIN_MIN %.9g %.9g %.9g\n", domain_min_[0], domain_min_[1], domain_min_[2]);
+    std::fprintf(file, "DOMAIN_MAX %.9g %.9g %.9g\n", domain_max_[0], domain_max_[1], domain_max_[2]);
+    for (size_t i = 0; i < table_.size(); i += 3) {
+        std::fprintf(file, "%.9g %.9g %.9g\n", table_[i], table_[i + 1], table_[i + 2]);
+    }
+
+    bool ok = std::fclose(file) == 0;
+    if (!ok) {
+        std::cerr << "Failed to write LUT: " << filepath << std::endl;
+    }
+    return ok;
+}
+
+ColorLUT ColorLUT::bake1D(const std::function<float(float)>& curve, int size, float domain_min, float domain_max) {
+    ColorLUT lut;
+    lut.type_ = LUT_1D;
+    lut.size_ = std::max(2, size);
+    for (int c = 0; c < 3; ++c) {
+        lut.domain_min_[c] = domain_min;
+        lut.domain_max_[c] = domain_max;
+    }
+
+    lut.table_.resize(static_cast<size_t>(lut.size_) * 3);
+    for (int i = 0; i < lut.size_; ++i) {
+        float v = curve(domain_min + (domain_max - domain_min) * i / (lut.size_ - 1));
+        lut.table_[i * 3 + 0] = v;
+        lut.table_[i * 3 + 1] = v;
+        lut.table_[i * 3 + 2] = v;
+    }
+    return lut;
+}
+
+ColorLUT ColorLUT::bake3D(const std::function<void(const float*, float*)>& transform, int size,
+                          float domain_min, float domain_max) {
+    ColorLUT lut;
+    lut.type_ = LUT_3D;
+    lut.size_ = std::max(2, std::min(size, kMaxCubeSize));
+    for (int c = 0; c < 3; ++c) {
+        lut.domain_min_[c] = domain_min;
+        lut.domain_max_[c] = domain_max;
+    }
+
+    int n = lut.size_;
+    float step = (domain_max - domain_min) / (n - 1);
+    lut.table_.resize(static_cast<size_t>(n) * n * n * 3);
+    parallelFor(0, n, [&](int b_begin, int b_end) {
+        for (int b = b_begin; b < b_end; ++b) {
+            for (int g = 0; g < n; ++g) {
+                for (int r = 0; r < n; ++r) {
+                    float rgb[3] = {domain_min + r * step, domain_min + g * step, domain_min + b * step};
+                    transform(rgb, &lut.table_[((static_cast<size_t>(b) * n + g) * n + r) * 3]);
+                }
+            }
+        }
+    }, 1);
+    return lut;
+}
+
+void ColorLUT::lookup(const float* rgb_in, float* rgb_out) const {
+    int n = size_;
+    if (type_ == LUT_1D) {
+        for (int c = 0; c < 3; ++c) {
+            int i0, i1;
+            float f;
+            splitCoord(latticeCoord(rgb_in[c], domain_min_[c], domain_max_[c], n), n, i0, i1, f);
+            rgb_out[c] = table_[i0 * 3 + c] + f * (table_[i1 * 3 + c] - table_[i0 * 3 + c]);
+        }
+        return;
+    }
+
+    int r0, r1, g0, g1, b0, b1;
+    float fr, fg, fb;
+    splitCoord(latticeCoord(rgb_in[0], domain_min_[0], domain_max_[0], n), n, r0, r1, fr);
+    splitCoord(latticeCoord(rgb_in[1], domain_min_[1], domain_max_[1], n), n, g0, g1, fg);
+    splitCoord(latticeCoord(rgb_in[2], domain_min_[2], domain_max_[2], n), n, b0, b1, fb);
+
+    auto at = [&](int r, int g, int b) {
+        return &table_[((static_cast<size_t>(b) * n + g) * n + r) * 3];
+    };
+    const float* c000 = at(r0, g0, b0);
+    const float* c100 = at(r1, g0, b0);
+    const float* c010 = at(r0, g1, b0);
+    const float* c110 = at(r1, g1, b0);
+    const float* c001 = at(r0, g0, b1);
+    const float* c101 = at(r1, g0, b1);
+    const float* c011 = at(r0, g1, b1);
+    const float* c111 = at(r1, g1, b1);
+    for (int c = 0; c < 3; ++c) {
+        float c00 = c000[c] + fr * (c100[c] - c000[c]);
+        float c10 = c010[c] + fr * (c110[c] - c010[c]);
+        float c01 = c001[c] + fr * (c101[c] - c001[c]);
+        float c11 = c011[c] + fr * (c111[c] - c011[c]);
+        float c0 = c00 + fg * (c10 - c00);
+        float c1 = c01 + fg * (c11 - c01);
+        rgb_out[c] = c0 + fb * (c1 - c0);
+    }
+}
+
+bool ColorLUT::apply(ImageData& image, float exposure) const {
+    if (empty()) {
+        std::cerr << "Cannot apply an empty LUT" << std::endl;
+        return false;
+    }
+    if (image.channels < 3) {
+        std::cerr << "LUT needs at least 3 channels, image has " << image.channels << std::endl;
+        return false;
+    }
+
+    ProfileScope scope("color.lut", image);
+    size_t cs = image.channelStride();
+    size_t ps = image.pixelStride();
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            float* p = image.data.data() + image.index(0, y, 0);
+            for (int x = 0; x < image.width; ++x, p += ps) {
+                float rgb[3] = {p[0] * exposure, p[cs] * exposure, p[2 * cs] * exposure};
+                float out[3];
+                lookup(rgb, out);
+                p[0] = out[0];
+                p[cs] = out[1];
+                p[2 * cs] = out[2];
+            }
+        }
+    });
+    return true;
+}
+
+} // namespace ImageProcessing
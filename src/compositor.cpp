@@ -1,123 +1,800 @@
 #include "exr_processor.h"
+#include "thread_pool.h"
+#include "image_view.h"
+#include "simd.h"
+#include "profiler.h"
+#include "result_cache.h"
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <iostream>
 
 namespace ImageProcessing {
 
+namespace {
+
+using simd::VecF;
+
+// One specialisation per blend mode. `apply` is written against the simd
+// helpers so the same code runs on full vectors and on the scalar tail.
+template <Compositor::BlendMode Mode>
+struct BlendOp;
+
+template <>
+struct BlendOp<Compositor::NORMAL> {
+    template <class V> static V apply(V, V o) { return o; }
+};
+
+template <>
+struct BlendOp<Compositor::MULTIPLY> {
+    template <class V> static V apply(V b, V o) { return b * o; }
+};
+
+template <>
+struct BlendOp<Compositor::SCREEN> {
+    template <class V> static V apply(V b, V o) {
+        return V(1.0f) - (V(1.0f) - b) * (V(1.0f) - o);
+    }
+};
+
+template <>
+struct BlendOp<Compositor::OVERLAY> {
+    template <class V> static V apply(V b, V o) {
+        V low = V(2.0f) * b * o;
+        V high = V(1.0f) - V(2.0f) * (V(1.0f) - b) * (V(1.0f) - o);
+        return simd::select(simd::lt(b, V(0.5f)), low, high);
+    }
+};
+
+template <>
+struct BlendOp<Compositor::SOFT_LIGHT> {
+    template <class V> static V apply(V b, V o) {
+        V low = V(2.0f) * b * o + b * b * (V(1.0f) - V(2.0f) * o);
+        V high = V(2.0f) * b * (V(1.0f) - o) + simd::sqrt(b) * (V(2.0f) * o - V(1.0f));
+        return simd::select(simd::lt(o, V(0.5f)), low, high);
+    }
+};
+
+template <>
+struct BlendOp<Compositor::HARD_LIGHT> {
+    template <class V> static V apply(V b, V o) {
+        V low = V(2.0f) * b * o;
+        V high = V(1.0f) - V(2.0f) * (V(1.0f) - b) * (V(1.0f) - o);
+        return simd::select(simd::lt(o, V(0.5f)), low, high);
+    }
+};
+
+template <>
+struct BlendOp<Compositor::COLOR_DODGE> {
+    template <class V> static V apply(V b, V o) {
+        // Both sides are evaluated; the division by zero is masked out
+        return simd::select(simd::lt(o, V(1.0f)), b / (V(1.0f) - o), V(1.0f));
+    }
+};
+
+template <>
+struct BlendOp<Compositor::COLOR_BURN> {
+    template <class V> static V apply(V b, V o) {
+        return simd::select(simd::gt(o, V(0.0f)), V(1.0f) - (V(1.0f) - b) / o, V(0.0f));
+    }
+};
+
+template <>
+struct BlendOp<Compositor::LINEAR_DODGE> {
+    template <class V> static V apply(V b, V o) { return b + o; }
+};
+
+template <>
+struct BlendOp<Compositor::LINEAR_BURN> {
+    template <class V> static V apply(V b, V o) { return b + o - V(1.0f); }
+};
+
+// Blends `count` contiguous samples with opacity and clamping fused into the
+// same pass. `out` may alias `base`.
+template <Compositor::BlendMode Mode>
+void blendRun(const float* base, const float* overlay, float* out, size_t count, float opacity) {
+    const VecF op(opacity);
+    const VecF inv_op(1.0f - opacity);
+    size_t i = 0;
+    
+    for (; i + VecF::width <= count; i += VecF::width) {
+        VecF b = VecF::load(base + i);
+        VecF o = VecF::load(overlay + i);
+        VecF blended = BlendOp<Mode>::apply(b, o);
+        simd::clamp01(b * inv_op + blended * op).store(out + i);
+    }
+    
+    for (; i < count; ++i) {
+        float b = base[i];
+        float blended = BlendOp<Mode>::apply(b, overlay[i]);
+        out[i] = simd::clamp01(b * (1.0f - opacity) + blended * opacity);
+    }
+}
+
+typedef void (*BlendRunFn)(const float*, const float*, float*, size_t, float);
+
+BlendRunFn selectBlendRun(Compositor::BlendMode mode) {
+    switch (mode) {
+        case Compositor::NORMAL: return &blendRun<Compositor::NORMAL>;
+        case Compositor::MULTIPLY: return &blendRun<Compositor::MULTIPLY>;
+        case Compositor::SCREEN: return &blendRun<Compositor::SCREEN>;
+        case Compositor::OVERLAY: return &blendRun<Compositor::OVERLAY>;
+        case Compositor::SOFT_LIGHT: return &blendRun<Compositor::SOFT_LIGHT>;
+        case Compositor::HARD_LIGHT: return &blendRun<Compositor::HARD_LIGHT>;
+        case Compositor::COLOR_DODGE: return &blendRun<Compositor::COLOR_DODGE>;
+        case Compositor::COLOR_BURN: return &blendRun<Compositor::COLOR_BURN>;
+        case Compositor::LINEAR_DODGE: return &blendRun<Compositor::LINEAR_DODGE>;
+        case Compositor::LINEAR_BURN: return &blendRun<Compositor::LINEAR_BURN>;
+    }
+    return &blendRun<Compositor::NORMAL>;
+}
+
+// Copies one row into interleaved `channels`-wide pixels, zero-filling missing channels
+template <typename T>
+void padRow(const BasicImageData<T>& image, int y, int channels, std::vector<float>& row) {
+    dispatchShape(image, [&](auto shape) {
+        auto view = decltype(shape)::view(image);
+        const int present = std::min(view.channels(), channels);
+        float* pixel = row.data();
+        for (int x = 0; x < view.width; ++x, pixel += channels) {
+            for (int c = 0; c < present; ++c) {
+                pixel[c] = static_cast<float>(view(x, y, c));
+            }
+            for (int c = present; c < channels; ++c) {
+                pixel[c] = 0.0f;
+            }
+        }
+    });
+}
+
+// Writes pixels [x0, x1) of a padded row back into row y of an image with the row's channel count
+template <typename T>
+void unpadRow(const std::vector<float>& row, int x0, int x1, int y, BasicImageData<T>& image) {
+    dispatchShape(image, [&](auto shape) {
+        auto view = decltype(shape)::view(image);
+        const int channels = view.channels();
+        const float* pixel = row.data() + static_cast<size_t>(x0) * channels;
+        for (int x = x0; x < x1; ++x, pixel += channels) {
+            for (int c = 0; c < channels; ++c) {
+                view(x, y, c) = static_cast<T>(pixel[c]);
+            }
+        }
+    });
+}
+
+// Part of the base that a blend writes, in base sample coordinates
+// [x0, x1) x [y0, y1). Base pixel (x, y) meets overlay pixel (x - dx, y - dy).
+struct BlendRegion {
+    int x0, y0, x1, y1;
+    int dx, dy;
+};
+
+// Blends the region into a result that already has the output shape
+void blendRows(const ImageData& base, const ImageData& overlay, ImageData& result,
+               Compositor::BlendMode mode, float opacity, const BlendRegion& region) {
+    BlendRunFn run = selectBlendRun(mode);
+    size_t row_floats = static_cast<size_t>(result.width) * result.channels;
+    int span = region.x1 - region.x0;
+    
+    if (base.channels == overlay.channels && base.layout == overlay.layout) {
+        int planes = (result.layout == PixelLayout::PLANAR) ? result.channels : 1;
+        size_t plane_row = row_floats / planes;
+        size_t lane = result.pixelStride();
+        
+        if (span == result.width && overlay.width == result.width && region.dx == 0 && region.dy == 0) {
+            // Whole rows of matching images: a chunk of rows is one contiguous
+            // run per plane (a single run when interleaved)
+            parallelFor(region.y0, region.y1, [&](int y_begin, int y_end) {
+                for (int p = 0; p < planes; ++p) {
+                    size_t offset = p * result.channelStride() + y_begin * plane_row;
+                    run(base.data.data() + offset, overlay.data.data() + offset, result.data.data() + offset,
+                        (y_end - y_begin) * plane_row, opacity);
+                }
+            });
+            return;
+        }
+        
+        // Part rows: one run per row and plane
+        parallelFor(region.y0, region.y1, [&](int y_begin, int y_end) {
+            for (int y = y_begin; y < y_end; ++y) {
+                for (int p = 0; p < planes; ++p) {
+                    size_t offset = p * result.channelStride() +
+                                    (static_cast<size_t>(y) * result.width + region.x0) * lane;
+                    size_t overlay_offset = p * overlay.channelStride() +
+                        (static_cast<size_t>(y - region.dy) * overlay.width + region.x0 - region.dx) * lane;
+                    run(base.data.data() + offset, overlay.data.data() + overlay_offset,
+                        result.data.data() + offset, span * lane, opacity);
+                }
+            }
+        });
+        return;
+    }
+    
+    // Mismatched channel counts or layouts: widen each row once, then blend it as a run
+    parallelFor(region.y0, region.y1, [&](int y_begin, int y_end) {
+        std::vector<float> base_row(row_floats);
+        std::vector<float> overlay_row(static_cast<size_t>(overlay.width) * result.channels);
+        
+        for (int y = y_begin; y < y_end; ++y) {
+            padRow(base, y, result.channels, base_row);
+            padRow(overlay, y - region.dy, result.channels, overlay_row);
+            float* segment = base_row.data() + static_cast<size_t>(region.x0) * result.channels;
+            run(segment, overlay_row.data() + static_cast<size_t>(region.x0 - region.dx) * result.channels,
+                segment, static_cast<size_t>(span) * result.channels, opacity);
+            
+            unpadRow(base_row, region.x0, region.x1, y, result);
+        }
+    });
+}
+
+// Shared by both float blend entry points; `roi` is in EXR frame coordinates
+void blendRegion(const ImageData& base, const ImageData& overlay, ImageData& result,
+                 Compositor::BlendMode mode, float opacity, const Imath::Box2i& roi) {
+    // The overlay's data window, clipped to the base and the roi
+    int dx = overlay.x_offset - base.x_offset;
+    int dy = overlay.y_offset - base.y_offset;
+    BlendRegion region;
+    region.x0 = std::max(std::max(dx, roi.min.x - base.x_offset), 0);
+    region.y0 = std::max(std::max(dy, roi.min.y - base.y_offset), 0);
+    region.x1 = std::min(std::min(dx + overlay.width, roi.max.x - base.x_offset + 1), base.width);
+    region.y1 = std::min(std::min(dy + overlay.height, roi.max.y - base.y_offset + 1), base.height);
+    region.dx = dx;
+    region.dy = dy;
+    
+    int channels = std::max(base.channels, overlay.channels);
+    bool covers = region.x0 == 0 && region.y0 == 0 && region.x1 == base.width && region.y1 == base.height;
+    
+    // Blends straight into `result` when it already has the output shape, which
+    // covers result == base (multiplyPass and friends) and reused buffers. Each
+    // row is fully read before it is written, so aliasing either input is safe
+    // as long as every pixel is blended; otherwise only base may be aliased.
+    bool aliases_base = &result == &base;
+    bool aliases_overlay = &result == &overlay;
+    bool shaped = result.hasShape(base.width, base.height, channels, base.layout);
+    bool use_result = (!aliases_base && !aliases_overlay) || (shaped && (aliases_base || covers));
+    ImageData separate;
+    ImageData& output = use_result ? result : separate;
+    if (!output.hasShape(base.width, base.height, channels, base.layout)) {
+        output.reshape(base.width, base.height, channels, base.layout);
+    }
+    output.setWindowsFrom(base);
+    
+    // Pixels the overlay does not reach keep the base
+    if (!covers && &output != &base) {
+        parallelFor(0, output.height, [&](int y_begin, int y_end) {
+            if (base.hasShape(output.width, output.height, output.channels, output.layout)) {
+                // Same shape: plane rows copy straight across
+                for (int p = 0; p < ((output.layout == PixelLayout::PLANAR) ? channels : 1); ++p) {
+                    size_t begin = output.index(0, y_begin, p);
+                    size_t end = begin + static_cast<size_t>(y_end - y_begin) * output.width * output.pixelStride();
+                    std::copy(base.data.begin() + begin, base.data.begin() + end, output.data.begin() + begin);
+                }
+                return;
+            }
+            std::vector<float> row(static_cast<size_t>(output.width) * channels);
+            for (int y = y_begin; y < y_end; ++y) {
+                padRow(base, y, channels, row);
+                unpadRow(row, 0, output.width, y, output);
+            }
+        });
+    }
+    
+    if (region.x0 < region.x1 && region.y0 < region.y1) {
+        blendRows(base, overlay, output, mode, opacity, region);
+    }
+    
+    if (&output != &result) {
+        result = std::move(output);
+    }
+}
+
+// Pixels per layer-stack tile; the accumulator tile stays in L1 while every
+// layer is blended into it
+const size_t kLayerTilePixels = 256;
+
+// Pixels per block an IncrementalCompositor hashes and recomposites; a whole
+// number of layer tiles, so blocks replay the same tiles as a full composite
+const size_t kIncrementalBlockPixels = 64 * kLayerTilePixels;
+
+// Blends `count` samples of one layer into the accumulator with per-sample
+// opacity (layer opacity times mask), using the same arithmetic as blendRun
+template <Compositor::BlendMode Mode, bool Clamp>
+void layerRun(float* acc, const float* overlay, const float* alpha, size_t count) {
+    size_t i = 0;
+    
+    for (; i + VecF::width <= count; i += VecF::width) {
+        VecF b = VecF::load(acc + i);
+        VecF a = VecF::load(alpha + i);
+        VecF blended = BlendOp<Mode>::apply(b, VecF::load(overlay + i));
+        VecF value = b * (VecF(1.0f) - a) + blended * a;
+        (Clamp ? simd::clamp01(value) : value).store(acc + i);
+    }
+    
+    for (; i < count; ++i) {
+        float b = acc[i];
+        float value = b * (1.0f - alpha[i]) + BlendOp<Mode>::apply(b, overlay[i]) * alpha[i];
+        acc[i] = Clamp ? simd::clamp01(value) : value;
+    }
+}
+
+typedef void (*LayerRunFn)(float*, const float*, const float*, size_t);
+
+template <bool Clamp>
+LayerRunFn selectLayerRun(Compositor::BlendMode mode) {
+    switch (mode) {
+        case Compositor::NORMAL: return &layerRun<Compositor::NORMAL, Clamp>;
+        case Compositor::MULTIPLY: return &layerRun<Compositor::MULTIPLY, Clamp>;
+        case Compositor::SCREEN: return &layerRun<Compositor::SCREEN, Clamp>;
+        case Compositor::OVERLAY: return &layerRun<Compositor::OVERLAY, Clamp>;
+        case Compositor::SOFT_LIGHT: return &layerRun<Compositor::SOFT_LIGHT, Clamp>;
+        case Compositor::HARD_LIGHT: return &layerRun<Compositor::HARD_LIGHT, Clamp>;
+        case Compositor::COLOR_DODGE: return &layerRun<Compositor::COLOR_DODGE, Clamp>;
+        case Compositor::COLOR_BURN: return &layerRun<Compositor::COLOR_BURN, Clamp>;
+        case Compositor::LINEAR_DODGE: return &layerRun<Compositor::LINEAR_DODGE, Clamp>;
+        case Compositor::LINEAR_BURN: return &layerRun<Compositor::LINEAR_BURN, Clamp>;
+    }
+    return &layerRun<Compositor::NORMAL, Clamp>;
+}
+
+// Copies pixels [p0, p0 + count) of an image into the output arrangement:
+// `channels`-wide interleaved pixels, or the single plane `plane` (>= 0).
+// Missing channels read as zero.
+void gatherTile(const ImageData& image, size_t p0, size_t count, int channels, int plane, float* out) {
+    size_t ps = image.pixelStride();
+    size_t cs = image.channelStride();
+    
+    if (plane >= 0) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = (plane < image.channels) ? image.data[(p0 + i) * ps + plane * cs] : 0.0f;
+        }
+        return;
+    }
+    
+    for (size_t i = 0; i < count; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            out[i * channels + c] = (c < image.channels) ? image.data[(p0 + i) * ps + c * cs] : 0.0f;
+        }
+    }
+}
+
+// Per-sample opacity of one layer over a tile, `lane_channels` samples per pixel
+void layerAlpha(const Compositor::Layer& layer, size_t p0, size_t count, int lane_channels, float* alpha) {
+    size_t n = count * lane_channels;
+    if (!layer.mask) {
+        std::fill(alpha, alpha + n, layer.opacity);
+        return;
+    }
+    
+    const ImageData& mask = *layer.mask;
+    int mask_channel = (mask.channels >= 4) ? 3 : 0;
+    size_t ps = mask.pixelStride();
+    const float* values = mask.data.data() + mask_channel * mask.channelStride();
+    for (size_t i = 0; i < count; ++i) {
+        float a = layer.opacity * values[(p0 + i) * ps];
+        for (int c = 0; c < lane_channels; ++c) {
+            alpha[i * lane_channels + c] = a;
+        }
+    }
+}
+
+// Channels of a layer stack's composite, or 0 when a layer or mask is missing
+// or has another size than the bottom layer
+int stackChannels(const std::vector<Compositor::Layer>& layers) {
+    const ImageData& bottom = *layers[0].image;
+    int channels = 0;
+    for (const Compositor::Layer& layer : layers) {
+        bool mask_matches = !layer.mask ||
+            (layer.mask->width == bottom.width && layer.mask->height == bottom.height && layer.mask->channels > 0);
+        if (!layer.image || layer.image->width != bottom.width || layer.image->height != bottom.height ||
+            !mask_matches) {
+            std::cerr << "Layer dimensions don't match for compositing" << std::endl;
+            return 0;
+        }
+        channels = std::max(channels, layer.image->channels);
+    }
+    return channels;
+}
+
+// Hash of pixels [p0, p0 + count) of an image, every channel, chained through `seed`
+uint64_t hashPixels(const ImageData& image, size_t p0, size_t count, uint64_t seed) {
+    bool planar = image.layout == PixelLayout::PLANAR;
+    int planes = planar ? image.channels : 1;
+    size_t lane_channels = planar ? 1 : image.channels;
+    for (int p = 0; p < planes; ++p) {
+        const float* samples = image.data.data() + p * image.channelStride() + p0 * lane_channels;
+        seed = ResultCache::hashSamples(samples, count * lane_channels, seed);
+    }
+    return seed;
+}
+
+// Blends layers [first, layers.size()) into the `count` pixels of `output`
+// from p0 on, which must be within one tile. The bottom layer starts the
+// accumulator; a later `first` resumes from partials[first - 1], the stack
+// composited up to that layer. Non-empty `partials` (one per layer below the
+// top, shaped like the output) receive the accumulator after each layer.
+void compositeTile(const std::vector<Compositor::Layer>& layers, const std::vector<LayerRunFn>& runs,
+                   size_t first, size_t p0, size_t count, ImageData& output,
+                   std::vector<ImageData>& partials, float* gathered, float* alpha) {
+    int channels = output.channels;
+    bool planar = output.layout == PixelLayout::PLANAR;
+    int planes = planar ? channels : 1;
+    int lane_channels = planar ? 1 : channels;
+    size_t n = count * lane_channels;
+    
+    auto copyTile = [&](const ImageData& from, ImageData& to) {
+        for (int p = 0; p < planes; ++p) {
+            size_t offset = p * output.channelStride() + p0 * lane_channels;
+            std::copy(from.data.begin() + offset, from.data.begin() + offset + n, to.data.begin() + offset);
+        }
+    };
+    if (first > 0) {
+        copyTile(partials[first - 1], output);
+    }
+    
+    for (size_t l = first; l < layers.size(); ++l) {
+        const ImageData& image = *layers[l].image;
+        bool direct = image.channels == channels && image.layout == output.layout;
+        layerAlpha(layers[l], p0, count, lane_channels, alpha);
+        
+        for (int p = 0; p < planes; ++p) {
+            size_t offset = p * output.channelStride() + p0 * lane_channels;
+            float* acc = output.data.data() + offset;
+            const float* src = image.data.data() + offset;
+            if (!direct) {
+                gatherTile(image, p0, count, channels, planar ? p : -1, gathered);
+                src = gathered;
+            }
+            
+            if (l == 0) {
+                for (size_t i = 0; i < n; ++i) {
+                    acc[i] = src[i] * alpha[i];
+                }
+            } else {
+                runs[l](acc, src, alpha, n);
+            }
+        }
+        
+        if (!partials.empty() && l + 1 < layers.size()) {
+            copyTile(output, partials[l]);
+        }
+    }
+}
+
+} // namespace
+
 void Compositor::blend(const ImageData& base, const ImageData& overlay, 
                       ImageData& result, BlendMode mode, float opacity) {
+    ProfileScope scope("compositor.blend");
+    scope.addImageRead(base);
+    scope.addImageRead(overlay);
+    Imath::Box2i everything(Imath::V2i(INT_MIN / 2, INT_MIN / 2), Imath::V2i(INT_MAX / 2, INT_MAX / 2));
+    blendRegion(base, overlay, result, mode, opacity, everything);
+    scope.addImageWritten(result);
+}
+
+void Compositor::blend(const ImageData& base, const ImageData& overlay, 
+                      ImageData& result, BlendMode mode, float opacity, const Imath::Box2i& roi) {
+    ProfileScope scope("compositor.blend_region");
+    blendRegion(base, overlay, result, mode, opacity, roi);
+}
+
+void Compositor::blend(const HalfImageData& base, const HalfImageData& overlay, 
+                      HalfImageData& result, BlendMode mode, float opacity) {
     if (base.width != overlay.width || base.height != overlay.height) {
         return; // Dimensions must match
     }
     
-    result = ImageData(base.width, base.height, std::max(base.channels, overlay.channels));
+    ProfileScope scope("compositor.blend_half");
+    scope.addImageRead(base);
+    scope.addImageRead(overlay);
+    int channels = std::max(base.channels, overlay.channels);
+    bool aliased = (&result == &base || &result == &overlay);
+    HalfImageData reshaped;
+    HalfImageData& output = (aliased && !result.hasShape(base.width, base.height, channels, base.layout))
+                            ? reshaped : result;
+    if (!output.hasShape(base.width, base.height, channels, base.layout)) {
+        output.reshape(base.width, base.height, channels, base.layout);
+    }
+    output.setWindowsFrom(base);
     
-    for (int y = 0; y < result.height; ++y) {
-        for (int x = 0; x < result.width; ++x) {
-            for (int c = 0; c < result.channels; ++c) {
-                float base_val = (c < base.channels) ? base(x, y, c) : 0.0f;
-                float overlay_val = (c < overlay.channels) ? overlay(x, y, c) : 0.0f;
-                
-                float blended_val = base_val;
+    BlendRunFn run = selectBlendRun(mode);
+    size_t row_floats = static_cast<size_t>(output.width) * output.channels;
+    
+    if (base.channels == overlay.channels && base.layout == overlay.layout) {
+        // Widen a short run at a time so the float copies stay in L1
+        const size_t kRun = 1024;
+        int planes = (output.layout == PixelLayout::PLANAR) ? output.channels : 1;
+        size_t plane_row = row_floats / planes;
+        size_t plane_size = output.channelStride();
+        
+        parallelFor(0, output.height, [&](int y_begin, int y_end) {
+            float base_run[kRun];
+            float overlay_run[kRun];
+            
+            for (int p = 0; p < planes; ++p) {
+                size_t begin = p * plane_size + y_begin * plane_row;
+                size_t end = begin + (y_end - y_begin) * plane_row;
                 
-                switch (mode) {
-                    case NORMAL:
-                        blended_val = overlay_val;
-                        break;
-                        
-                    case MULTIPLY:
-                        blended_val = base_val * overlay_val;
-                        break;
-                        
-                    case SCREEN:
-                        blended_val = 1.0f - (1.0f - base_val) * (1.0f - overlay_val);
-                        break;
-                        
-                    case OVERLAY:
-                        if (base_val < 0.5f) {
-                            blended_val = 2.0f * base_val * overlay_val;
-                        } else {
-                            blended_val = 1.0f - 2.0f * (1.0f - base_val) * (1.0f - overlay_val);
-                        }
-                        break;
-                        
-                    case SOFT_LIGHT:
-                        if (overlay_val < 0.5f) {
-                            blended_val = 2.0f * base_val * overlay_val + base_val * base_val * (1.0f - 2.0f * overlay_val);
-                        } else {
-                            blended_val = 2.0f * base_val * (1.0f - overlay_val) + std::sqrt(base_val) * (2.0f * overlay_val - 1.0f);
-                        }
-                        break;
-                        
-                    case HARD_LIGHT:
-                        if (overlay_val < 0.5f) {
-                            blended_val = 2.0f * base_val * overlay_val;
-                        } else {
-                            blended_val = 1.0f - 2.0f * (1.0f - base_val) * (1.0f - overlay_val);
-                        }
-                        break;
-                        
-                    case COLOR_DODGE:
-                        if (overlay_val < 1.0f) {
-                            blended_val = base_val / (1.0f - overlay_val);
-                        } else {
-                            blended_val = 1.0f;
-                        }
-                        break;
-                        
-                    case COLOR_BURN:
-                        if (overlay_val > 0.0f) {
-                            blended_val = 1.0f - (1.0f - base_val) / overlay_val;
-                        } else {
-                            blended_val = 0.0f;
-                        }
-                        break;
-                        
-                    case LINEAR_DODGE:
-                        blended_val = base_val + overlay_val;
-                        break;
-                        
-                    case LINEAR_BURN:
-                        blended_val = base_val + overlay_val - 1.0f;
-                        break;
+                for (size_t i = begin; i < end; i += kRun) {
+                    size_t count = std::min(kRun, end - i);
+                    halfToFloat(base.data.data() + i, base_run, count);
+                    halfToFloat(overlay.data.data() + i, overlay_run, count);
+                    run(base_run, overlay_run, base_run, count, opacity);
+                    floatToHalf(base_run, output.data.data() + i, count);
                 }
+            }
+        });
+    } else {
+        parallelFor(0, output.height, [&](int y_begin, int y_end) {
+            std::vector<float> base_row(row_floats);
+            std::vector<float> overlay_row(row_floats);
+            
+            for (int y = y_begin; y < y_end; ++y) {
+                padRow(base, y, output.channels, base_row);
+                padRow(overlay, y, output.channels, overlay_row);
+                run(base_row.data(), overlay_row.data(), base_row.data(), row_floats, opacity);
                 
-                // Apply opacity
-                blended_val = base_val * (1.0f - opacity) + blended_val * opacity;
-                
-                // Clamp result
-                result(x, y, c) = std::max(0.0f, std::min(1.0f, blended_val));
+                unpadRow(base_row, 0, output.width, y, output);
             }
+        });
+    }
+    
+    if (&output != &result) {
+        result = std::move(output);
+    }
+    scope.addImageWritten(result);
+}
+
+bool Compositor::compositeLayers(const std::vector<Layer>& layers, ImageData& result, bool clamp) {
+    if (layers.empty() || !layers[0].image) return false;
+    
+    const ImageData& bottom = *layers[0].image;
+    int channels = stackChannels(layers);
+    if (channels == 0) return false;
+    bool aliased = false;
+    for (const Layer& layer : layers) {
+        aliased = aliased || layer.image == &result || layer.mask == &result;
+    }
+    
+    ProfileScope scope("compositor.composite_layers");
+    for (const Layer& layer : layers) {
+        scope.addImageRead(*layer.image);
+        if (layer.mask) scope.addImageRead(*layer.mask);
+    }
+    
+    // The output tile doubles as the accumulator, so it may not overlap an input
+    ImageData separate;
+    ImageData& output = aliased ? separate : result;
+    output.reshape(bottom.width, bottom.height, channels, bottom.layout);
+    output.setWindowsFrom(bottom);
+    
+    std::vector<LayerRunFn> runs;
+    for (const Layer& layer : layers) {
+        runs.push_back(clamp ? selectLayerRun<true>(layer.mode) : selectLayerRun<false>(layer.mode));
+    }
+    
+    int lane_channels = (output.layout == PixelLayout::PLANAR) ? 1 : channels;
+    size_t pixels = static_cast<size_t>(output.width) * output.height;
+    int tiles = static_cast<int>((pixels + kLayerTilePixels - 1) / kLayerTilePixels);
+    
+    std::vector<ImageData> no_partials;
+    parallelFor(0, tiles, [&](int t_begin, int t_end) {
+        std::vector<float> gathered(kLayerTilePixels * lane_channels);
+        std::vector<float> alpha(kLayerTilePixels * lane_channels);
+        
+        for (int t = t_begin; t < t_end; ++t) {
+            size_t p0 = static_cast<size_t>(t) * kLayerTilePixels;
+            size_t count = std::min(kLayerTilePixels, pixels - p0);
+            compositeTile(layers, runs, 0, p0, count, output, no_partials, gathered.data(), alpha.data());
         }
+    });
+    
+    if (aliased) {
+        result = std::move(output);
     }
+    scope.addImageWritten(result);
+    return true;
 }
 
 void Compositor::premultiplyAlpha(ImageData& image) {
     if (image.channels < 4) return; // Need alpha channel
     
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            float alpha = image(x, y, 3);
+    // Per-channel rows: contiguous for planar images, one strided walk otherwise
+    ConstChannelView alpha = image.channel(3);
+    
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            const float* a = alpha.row(y);
             for (int c = 0; c < 3; ++c) { // RGB channels only
-                image(x, y, c) *= alpha;
+                ChannelView color = image.channel(c);
+                float* dst = color.row(y);
+                size_t stride = color.x_stride;
+                for (int x = 0; x < image.width; ++x) {
+                    dst[x * stride] *= a[x * stride];
+                }
             }
         }
-    }
+    });
 }
 
 void Compositor::unpremultiplyAlpha(ImageData& image) {
     if (image.channels < 4) return; // Need alpha channel
     
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            float alpha = image(x, y, 3);
-            if (alpha > 0.0f) {
-                for (int c = 0; c < 3; ++c) { // RGB channels only
-                    image(x, y, c) /= alpha;
+    ConstChannelView alpha = image.channel(3);
+    
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            const float* a = alpha.row(y);
+            for (int c = 0; c < 3; ++c) { // RGB channels only
+                ChannelView color = image.channel(c);
+                float* dst = color.row(y);
+                size_t stride = color.x_stride;
+                for (int x = 0; x < image.width; ++x) {
+                    float alpha_val = a[x * stride];
+                    if (alpha_val > 0.0f) {
+                        dst[x * stride] /= alpha_val;
+                    }
+                }
+            }
+        }
+    });
+}
+
+IncrementalCompositor::IncrementalCompositor(bool keep_partials)
+    : keep_partials_(keep_partials), clamp_(true) {}
+
+bool IncrementalCompositor::composite(const std::vector<Compositor::Layer>& layers, bool clamp) {
+    return run(layers, std::vector<char>(layers.size(), true), clamp);
+}
+
+bool IncrementalCompositor::update(const std::vector<Compositor::Layer>& layers,
+                                   const std::vector<size_t>& changed, bool clamp) {
+    std::vector<char> suspect(layers.size(), false);
+    for (size_t l : changed) {
+        if (l < layers.size()) suspect[l] = true;
+    }
+    return run(layers, suspect, clamp);
+}
+
+bool IncrementalCompositor::run(const std::vector<Compositor::Layer>& layers,
+                                const std::vector<char>& suspect, bool clamp) {
+    if (layers.empty() || !layers[0].image) {
+        clear();
+        return false;
+    }
+    for (const Compositor::Layer& layer : layers) {
+        if (layer.image == &result_ || layer.mask == &result_) {
+            std::cerr << "Incremental composite can't take its own result as a layer" << std::endl;
+            clear();
+            return false;
+        }
+    }
+    int channels = stackChannels(layers);
+    if (channels == 0) {
+        clear();
+        return false;
+    }
+    
+    ProfileScope scope("compositor.incremental");
+    const ImageData& bottom = *layers[0].image;
+    size_t pixels = static_cast<size_t>(bottom.width) * bottom.height;
+    int blocks = static_cast<int>((pixels + kIncrementalBlockPixels - 1) / kIncrementalBlockPixels);
+    
+    stats_ = Stats();
+    stats_.blocks = blocks;
+    stats_.full = !result_.hasShape(bottom.width, bottom.height, channels, bottom.layout) ||
+                  layers.size() != layers_.size() || clamp != clamp_;
+    if (stats_.full) {
+        result_.reshape(bottom.width, bottom.height, channels, bottom.layout);
+        partials_.clear();
+        if (keep_partials_) {
+            partials_.resize(layers.size() - 1);
+            for (ImageData& partial : partials_) {
+                partial.reshape(bottom.width, bottom.height, channels, bottom.layout);
+            }
+        }
+        layers_.assign(layers.size(), LayerState());
+        clamp_ = clamp;
+    }
+    result_.setWindowsFrom(bottom);
+    
+    // Layers whose settings changed are dirty in every block
+    std::vector<char> restyled(layers.size(), stats_.full);
+    std::vector<LayerRunFn> runs;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const Compositor::Layer& layer = layers[l];
+        LayerState& state = layers_[l];
+        int mask_channels = layer.mask ? layer.mask->channels : 0;
+        PixelLayout mask_layout = layer.mask ? layer.mask->layout : PixelLayout::INTERLEAVED;
+        if (state.mode != layer.mode || state.opacity != layer.opacity ||
+            state.channels != layer.image->channels || state.layout != layer.image->layout ||
+            state.mask_channels != mask_channels || state.mask_layout != mask_layout) {
+            restyled[l] = true;
+        }
+        state.mode = layer.mode;
+        state.opacity = layer.opacity;
+        state.channels = layer.image->channels;
+        state.layout = layer.image->layout;
+        state.mask_channels = mask_channels;
+        state.mask_layout = mask_layout;
+        state.hashes.resize(blocks);
+        
+        runs.push_back(clamp ? selectLayerRun<true>(layer.mode) : selectLayerRun<false>(layer.mode));
+        scope.addImageRead(*layer.image);
+        if (layer.mask) scope.addImageRead(*layer.mask);
+    }
+    
+    // Lowest layer of each block whose pixels or settings changed. Layers
+    // that are not suspect keep their hashes; a fresh start hashes them all.
+    std::vector<size_t> dirty_from(blocks, layers.size());
+    parallelFor(0, blocks, [&](int b_begin, int b_end) {
+        for (int b = b_begin; b < b_end; ++b) {
+            size_t p0 = static_cast<size_t>(b) * kIncrementalBlockPixels;
+            size_t count = std::min(kIncrementalBlockPixels, pixels - p0);
+            for (size_t l = 0; l < layers.size(); ++l) {
+                if (!stats_.full && !suspect[l]) {
+                    if (restyled[l]) dirty_from[b] = std::min(dirty_from[b], l);
+                    continue;
+                }
+                uint64_t hash = hashPixels(*layers[l].image, p0, count, 0);
+                if (layers[l].mask) hash = hashPixels(*layers[l].mask, p0, count, hash);
+                
+                if (restyled[l] || hash != layers_[l].hashes[b]) {
+                    dirty_from[b] = std::min(dirty_from[b], l);
                 }
+                layers_[l].hashes[b] = hash;
             }
         }
+    });
+    
+    std::vector<int> dirty;
+    size_t dirty_pixels = 0;
+    for (int b = 0; b < blocks; ++b) {
+        if (dirty_from[b] == layers.size()) continue;
+        if (!keep_partials_) dirty_from[b] = 0;
+        dirty.push_back(b);
+        stats_.layer_blends += layers.size() - dirty_from[b];
+        dirty_pixels += std::min(kIncrementalBlockPixels, pixels - b * kIncrementalBlockPixels);
     }
+    stats_.dirty_blocks = dirty.size();
+    
+    int lane_channels = (result_.layout == PixelLayout::PLANAR) ? 1 : channels;
+    parallelFor(0, static_cast<int>(dirty.size()), [&](int d_begin, int d_end) {
+        std::vector<float> gathered(kLayerTilePixels * lane_channels);
+        std::vector<float> alpha(kLayerTilePixels * lane_channels);
+        
+        for (int d = d_begin; d < d_end; ++d) {
+            size_t block_begin = static_cast<size_t>(dirty[d]) * kIncrementalBlockPixels;
+            size_t block_end = std::min(pixels, block_begin + kIncrementalBlockPixels);
+            for (size_t p0 = block_begin; p0 < block_end; p0 += kLayerTilePixels) {
+                size_t count = std::min(kLayerTilePixels, block_end - p0);
+                compositeTile(layers, runs, dirty_from[dirty[d]], p0, count, result_, partials_,
+                              gathered.data(), alpha.data());
+            }
+        }
+    });
+    
+    scope.addPixels(dirty_pixels);
+    scope.addWritten(dirty_pixels * channels * sizeof(float));
+    return true;
+}
+
+size_t IncrementalCompositor::bytesUsed() const {
+    size_t bytes = result_.data.size() * sizeof(float);
+    for (const ImageData& partial : partials_) {
+        bytes += partial.data.size() * sizeof(float);
+    }
+    for (const LayerState& state : layers_) {
+        bytes += state.hashes.size() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+void IncrementalCompositor::clear() {
+    layers_.clear();
+    partials_.clear();
+    result_ = ImageData();
+    stats_ = Stats();
 }
 
-} // namespace ImageProcessing
\ No newline at end of file
+} // namespace ImageProcessing
@@ -1,45 +1,139 @@
 #include "exr_processor.h"
+#include "thread_pool.h"
+#include "result_cache.h"
+#include "profiler.h"
+#include "color_lut.h"
+#include "raw_frame.h"
+#include "image_view.h"
+#include "resampler.h"
+#include "simd.h"
+#include <OpenEXR/ImfInputPart.h>
+#include <OpenEXR/ImfMultiPartInputFile.h>
+#include <OpenEXR/ImfMultiPartOutputFile.h>
+#include <OpenEXR/ImfOutputPart.h>
+#include <OpenEXR/ImfPartType.h>
+#include <OpenEXR/ImfThreading.h>
+#include <OpenEXR/ImfTileDescription.h>
+#include <OpenEXR/ImfTiledOutputFile.h>
+#include <OpenEXR/ImfTiledOutputPart.h>
 #include <iostream>
 #include <fstream>
 #include <cmath>
 #include <algorithm>
 #include <cstring>
+#include <mutex>
+#include <set>
 
 namespace ImageProcessing {
 
-EXRProcessor::EXRProcessor() {
+namespace {
+
+std::once_flag g_codec_threads_once;
+
+// OpenEXR codes line blocks on its own thread pool, which is empty until
+// someone sizes it; an application that already did is left alone
+void initCodecThreads() {
+    std::call_once(g_codec_threads_once, []() {
+        int threads = ThreadPool::defaultThreadCount();
+        if (Imf::globalThreadCount() == 0 && threads > 1) {
+            Imf::setGlobalThreadCount(threads);
+        }
+    });
 }
 
-EXRProcessor::~EXRProcessor() {
-    clearPasses();
+// Sort key that puts R, G, B, A first so channels come back in the order
+// saveMultiPlaneEXR writes them (the EXR channel list is alphabetical).
+std::string channelOrder(const std::string& channel_name) {
+    size_t dot = channel_name.find_last_of('.');
+    std::string suffix = (dot == std::string::npos) ? channel_name : channel_name.substr(dot + 1);
+    
+    if (suffix == "R") return "0";
+    if (suffix == "G") return "1";
+    if (suffix == "B") return "2";
+    if (suffix == "A") return "3";
+    return "4" + suffix;
 }
 
-bool EXRProcessor::loadEXR(const std::string& filepath, ImageData& image) {
-    try {
-        Imf::RgbaInputFile file(filepath.c_str());
-        Imath::Box2i dw = file.dataWindow();
-        
-        int width = dw.max.x - dw.min.x + 1;
-        int height = dw.max.y - dw.min.y + 1;
-        
-        image = ImageData(width, height, 4); // RGBA
+// Decodes R, G, B, A straight into `data` through slices that follow the
+// target layout, so there is no staging buffer and no second copy. Missing
+// channels are filled (alpha with 1). Only luminance/chroma files, which need
+// RgbaInputFile's colour conversion, go through an intermediate Rgba array.
+template <typename T>
+void decodeRGBA(Imf::InputFile& file, const std::string& filepath, T* data,
+                int width, int height, PixelLayout layout) {
+    const Imf::Header& header = file.header();
+    Imath::Box2i dw = header.dataWindow();
+    
+    size_t pixel_stride = (layout == PixelLayout::PLANAR) ? 1 : 4;
+    size_t channel_stride = (layout == PixelLayout::PLANAR) ? static_cast<size_t>(width) * height : 1;
+    
+    if (!header.channels().findChannel("R") && header.channels().findChannel("Y")) {
+        Imf::RgbaInputFile rgba_file(filepath.c_str());
         
         Imf::Array2D<Imf::Rgba> pixels;
         pixels.resizeErase(height, width);
         
-        file.setFrameBuffer(&pixels[0][0] - dw.min.x - dw.min.y * width, 1, width);
-        file.readPixels(dw.min.y, dw.max.y);
+        rgba_file.setFrameBuffer(&pixels[0][0] - dw.min.x - dw.min.y * width, 1, width);
+        rgba_file.readPixels(dw.min.y, dw.max.y);
         
-        // Convert to our format
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                image(x, y, 0) = pixels[y][x].r;
-                image(x, y, 1) = pixels[y][x].g;
-                image(x, y, 2) = pixels[y][x].b;
-                image(x, y, 3) = pixels[y][x].a;
+        parallelFor(0, height, [&](int y_begin, int y_end) {
+            for (int y = y_begin; y < y_end; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    T* pixel = data + (static_cast<size_t>(y) * width + x) * pixel_stride;
+                    pixel[0] = pixels[y][x].r;
+                    pixel[channel_stride] = pixels[y][x].g;
+                    pixel[2 * channel_stride] = pixels[y][x].b;
+                    pixel[3 * channel_stride] = pixels[y][x].a;
+                }
             }
-        }
+        });
+        return;
+    }
+    
+    size_t x_stride = sizeof(T) * pixel_stride;
+    size_t y_stride = x_stride * width;
+    const char* names[4] = {"R", "G", "B", "A"};
+    
+    Imf::FrameBuffer frameBuffer;
+    for (int c = 0; c < 4; ++c) {
+        char* base = reinterpret_cast<char*>(data + c * channel_stride) -
+                     dw.min.x * x_stride - dw.min.y * y_stride;
+        frameBuffer.insert(names[c], Imf::Slice(EXRPixelType<T>::value, base, x_stride, y_stride,
+                                                1, 1, c == 3 ? 1.0 : 0.0));
+    }
+    
+    file.setFrameBuffer(frameBuffer);
+    file.readPixels(dw.min.y, dw.max.y);
+}
+
+// Loads into `image`, reusing its storage when the capacity is already there
+template <typename T>
+bool readRGBA(const std::string& filepath, BasicImageData<T>& image, PixelLayout layout) {
+    // Raw intermediates are copied straight out of the mapping
+    if (isRawFrame(filepath)) {
+        RawFrame frame;
+        return frame.open(filepath) && frame.readRGBA(image, layout);
+    }
+    
+    initCodecThreads();
+    try {
+        Imf::InputFile file(filepath.c_str());
+        Imath::Box2i dw = file.header().dataWindow();
+        
+        int width = dw.max.x - dw.min.x + 1;
+        int height = dw.max.y - dw.min.y + 1;
+        
+        // Every sample is overwritten by the decode, so no clearing is needed
+        image.width = width;
+        image.height = height;
+        image.channels = 4; // RGBA
+        image.layout = layout;
+        image.data.resize(static_cast<size_t>(width) * height * 4);
+        image.x_offset = dw.min.x;
+        image.y_offset = dw.min.y;
+        image.display_window = file.header().displayWindow();
         
+        decodeRGBA(file, filepath, image.data.data(), width, height, layout);
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Error loading EXR file: " << e.what() << std::endl;
@@ -47,30 +141,32 @@ bool EXRProcessor::loadEXR(const std::string& filepath, ImageData& image) {
     }
 }
 
-bool EXRProcessor::saveEXR(const std::string& filepath, const ImageData& image) {
+template <typename T>
+bool writeRGBA(const std::string& filepath, const BasicImageData<T>& image, Imf::PixelType channel_type,
+               Imf::Compression compression) {
+    initCodecThreads();
     try {
         if (image.channels != 4) {
             std::cerr << "EXR save requires RGBA image (4 channels)" << std::endl;
             return false;
         }
         
-        Imf::Header header(image.width, image.height);
-        header.channels().insert("R", Imf::Channel(Imf::FLOAT));
-        header.channels().insert("G", Imf::Channel(Imf::FLOAT));
-        header.channels().insert("B", Imf::Channel(Imf::FLOAT));
-        header.channels().insert("A", Imf::Channel(Imf::FLOAT));
+        // The data window may be a cut-out of a larger display window
+        Imf::Header header(image.display_window, image.dataWindow());
+        header.compression() = compression;
+        header.channels().insert("R", Imf::Channel(channel_type));
+        header.channels().insert("G", Imf::Channel(channel_type));
+        header.channels().insert("B", Imf::Channel(channel_type));
+        header.channels().insert("A", Imf::Channel(channel_type));
         
         Imf::OutputFile file(filepath.c_str(), header);
         Imf::FrameBuffer frameBuffer;
         
-        frameBuffer.insert("R", Imf::Slice(Imf::FLOAT, 
-            (char*)&image.data[0], sizeof(float) * 4, sizeof(float) * image.width * 4));
-        frameBuffer.insert("G", Imf::Slice(Imf::FLOAT, 
-            (char*)&image.data[1], sizeof(float) * 4, sizeof(float) * image.width * 4));
-        frameBuffer.insert("B", Imf::Slice(Imf::FLOAT, 
-            (char*)&image.data[2], sizeof(float) * 4, sizeof(float) * image.width * 4));
-        frameBuffer.insert("A", Imf::Slice(Imf::FLOAT, 
-            (char*)&image.data[3], sizeof(float) * 4, sizeof(float) * image.width * 4));
+        const Imath::Box2i& dw = header.dataWindow();
+        frameBuffer.insert("R", channelSlice(image, 0, dw));
+        frameBuffer.insert("G", channelSlice(image, 1, dw));
+        frameBuffer.insert("B", channelSlice(image, 2, dw));
+        frameBuffer.insert("A", channelSlice(image, 3, dw));
         
         file.setFrameBuffer(frameBuffer);
         file.writePixels(image.height);
@@ -82,109 +178,414 @@ bool EXRProcessor::saveEXR(const std::string& filepath, const ImageData& image)
     }
 }
 
-bool EXRProcessor::loadMultiPlaneEXR(const std::string& filepath, std::vector<RenderPass>& passes) {
+// An image to write and the channel names it is stored under
+struct WritePass {
+    std::string name;
+    const ImageData* image;
+    std::vector<std::string> channels;
+};
+
+WritePass makeWritePass(const std::string& name, const std::string& layer, const ImageData& image) {
+    WritePass pass = {name, &image, {}};
+    for (int c = 0; c < image.channels; ++c) {
+        std::string suffix = c == 0 ? "R" : c == 1 ? "G" : c == 2 ? "B" : c == 3 ? "A" : std::to_string(c);
+        pass.channels.push_back(layer.empty() ? suffix : layer + "." + suffix);
+    }
+    return pass;
+}
+
+Imf::Header partHeader(const std::vector<const WritePass*>& passes, const Imath::Box2i& display_window,
+                       Imf::Compression compression, const EXRWriteOptions& options) {
+    Imf::Header header(display_window, passes[0]->image->dataWindow());
+    header.compression() = compression;
+    if (options.tiled) {
+        header.setTileDescription(Imf::TileDescription(std::max(1, options.tile_width),
+                                                       std::max(1, options.tile_height), Imf::ONE_LEVEL));
+    }
+    for (const WritePass* pass : passes) {
+        for (const std::string& channel : pass->channels) {
+            header.channels().insert(channel, Imf::Channel(options.pixelTypeFor(pass->name, channel)));
+        }
+    }
+    return header;
+}
+
+Imf::FrameBuffer partFrameBuffer(const std::vector<const WritePass*>& passes, const Imath::Box2i& data_window) {
+    Imf::FrameBuffer frameBuffer;
+    for (const WritePass* pass : passes) {
+        for (size_t c = 0; c < pass->channels.size(); ++c) {
+            frameBuffer.insert(pass->channels[c], channelSlice(*pass->image, static_cast<int>(c), data_window));
+        }
+    }
+    return frameBuffer;
+}
+
+// The whole image goes to OpenEXR in one call so its threads can code
+// every line block or tile of the part at once
+template <typename Output>
+void writeScanlines(Output& output, const Imf::FrameBuffer& frameBuffer, int height) {
+    output.setFrameBuffer(frameBuffer);
+    output.writePixels(height);
+}
+
+template <typename Output>
+void writeTiles(Output& output, const Imf::FrameBuffer& frameBuffer) {
+    output.setFrameBuffer(frameBuffer);
+    output.writeTiles(0, output.numXTiles(0) - 1, 0, output.numYTiles(0) - 1);
+}
+
+// Passes sharing a codec go into one part; otherwise (or with
+// options.multipart) every pass is its own named part
+bool writePasses(const std::string& filepath, const std::vector<WritePass>& passes,
+                 const EXRWriteOptions& options) {
+    initCodecThreads();
     try {
-        Imf::InputFile file(filepath.c_str());
-        const Imf::Header& header = file.header();
-        const Imf::ChannelList& channels = header.channels();
-        
-        Imath::Box2i dw = header.dataWindow();
-        int width = dw.max.x - dw.min.x + 1;
-        int height = dw.max.y - dw.min.y + 1;
+        if (passes.empty()) {
+            std::cerr << "No passes to save" << std::endl;
+            return false;
+        }
         
-        // Group channels by layer
-        std::map<std::string, std::vector<std::string>> layer_channels;
+        // Passes share the first pass's display window
+        const ImageData& first = *passes[0].image;
+        std::set<Imf::Compression> codecs;
+        for (const WritePass& pass : passes) {
+            codecs.insert(options.compressionFor(pass.name));
+        }
+        bool multipart = options.multipart || codecs.size() > 1;
         
-        for (Imf::ChannelList::ConstIterator it = channels.begin(); it != channels.end(); ++it) {
-            std::string channel_name = it.name();
-            std::string layer_name = channel_name.substr(0, channel_name.find_last_of('.'));
-            
-            if (layer_name.empty()) {
-                layer_name = "default";
+        if (!multipart) {
+            std::vector<const WritePass*> part;
+            for (const WritePass& pass : passes) {
+                const ImageData& image = *pass.image;
+                if (image.width != first.width || image.height != first.height ||
+                    image.x_offset != first.x_offset || image.y_offset != first.y_offset) {
+                    std::cerr << "Pass data windows differ; write them as separate parts: " << pass.name
+                              << std::endl;
+                    return false;
+                }
+                part.push_back(&pass);
             }
             
-            layer_channels[layer_name].push_back(channel_name);
+            Imf::Header header = partHeader(part, first.display_window, *codecs.begin(), options);
+            Imf::FrameBuffer frameBuffer = partFrameBuffer(part, header.dataWindow());
+            if (options.tiled) {
+                Imf::TiledOutputFile file(filepath.c_str(), header);
+                writeTiles(file, frameBuffer);
+            } else {
+                Imf::OutputFile file(filepath.c_str(), header);
+                writeScanlines(file, frameBuffer, first.height);
+            }
+            return true;
         }
         
-        // Create passes for each layer
-        for (const auto& layer : layer_channels) {
-            const std::string& layer_name = layer.first;
-            const std::vector<std::string>& channel_names = layer.second;
-            
-            int channel_count = channel_names.size();
-            RenderPass pass(layer_name, width, height, channel_count);
-            
-            // Read channels
-            Imf::FrameBuffer frameBuffer;
-            for (int i = 0; i < channel_count; ++i) {
-                frameBuffer.insert(channel_names[i], Imf::Slice(Imf::FLOAT,
-                    (char*)&pass.image.data[i], sizeof(float) * channel_count,
-                    sizeof(float) * width * channel_count));
-            }
-            
-            file.setFrameBuffer(frameBuffer);
-            file.readPixels(dw.min.y, dw.max.y);
-            
-            passes.push_back(std::move(pass));
+        std::vector<Imf::Header> headers;
+        for (const WritePass& pass : passes) {
+            std::vector<const WritePass*> part(1, &pass);
+            headers.push_back(partHeader(part, first.display_window, options.compressionFor(pass.name), options));
+            headers.back().setName(pass.name);
+            headers.back().setType(options.tiled ? Imf::TILEDIMAGE : Imf::SCANLINEIMAGE);
         }
         
+        Imf::MultiPartOutputFile file(filepath.c_str(), headers.data(), static_cast<int>(headers.size()));
+        for (size_t i = 0; i < passes.size(); ++i) {
+            std::vector<const WritePass*> part(1, &passes[i]);
+            Imf::FrameBuffer frameBuffer = partFrameBuffer(part, headers[i].dataWindow());
+            if (options.tiled) {
+                Imf::TiledOutputPart output(file, static_cast<int>(i));
+                writeTiles(output, frameBuffer);
+            } else {
+                Imf::OutputPart output(file, static_cast<int>(i));
+                writeScanlines(output, frameBuffer, passes[i].image->height);
+            }
+        }
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error loading multi-plane EXR: " << e.what() << std::endl;
+        std::cerr << "Error saving EXR file: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool EXRProcessor::saveMultiPlaneEXR(const std::string& filepath, const std::vector<RenderPass>& passes) {
-    try {
-        if (passes.empty()) {
-            std::cerr << "No passes to save" << std::endl;
-            return false;
+// Decodes the requested layers of one part with a single readPixels call
+void readPartLayers(Imf::InputPart& part, const std::vector<std::string>& filter, PixelLayout layout,
+                    std::vector<RenderPass>& loaded) {
+    const Imf::Header& header = part.header();
+    const Imf::ChannelList& channels = header.channels();
+    
+    Imath::Box2i dw = header.dataWindow();
+    int width = dw.max.x - dw.min.x + 1;
+    int height = dw.max.y - dw.min.y + 1;
+    
+    // Group channels by layer, keeping only the requested layers/channels
+    std::map<std::string, std::vector<std::string>> layer_channels;
+    
+    for (Imf::ChannelList::ConstIterator it = channels.begin(); it != channels.end(); ++it) {
+        std::string channel_name = it.name();
+        size_t dot = channel_name.find_last_of('.');
+        std::string layer_name = (dot == std::string::npos) ? "default" : channel_name.substr(0, dot);
+        
+        if (layer_name.empty()) {
+            layer_name = "default";
         }
         
-        int width = passes[0].image.width;
-        int height = passes[0].image.height;
+        if (!filter.empty() &&
+            std::find(filter.begin(), filter.end(), layer_name) == filter.end() &&
+            std::find(filter.begin(), filter.end(), channel_name) == filter.end()) {
+            continue;
+        }
+        
+        layer_channels[layer_name].push_back(channel_name);
+    }
+    
+    if (layer_channels.empty()) return;
+    
+    // Allocate every pass up front so the slice pointers stay valid
+    size_t first_pass = loaded.size();
+    for (auto& layer : layer_channels) {
+        std::vector<std::string>& channel_names = layer.second;
+        sortChannelNames(channel_names);
+        loaded.emplace_back(layer.first, width, height, static_cast<int>(channel_names.size()),
+                            false, layout);
+        loaded.back().image.x_offset = dw.min.x;
+        loaded.back().image.y_offset = dw.min.y;
+        loaded.back().image.display_window = header.displayWindow();
+    }
+    
+    // Bind all layers to a single frame buffer and decode the part once
+    Imf::FrameBuffer frameBuffer;
+    size_t pass_index = first_pass;
+    for (const auto& layer : layer_channels) {
+        const std::vector<std::string>& channel_names = layer.second;
+        RenderPass& pass = loaded[pass_index++];
         
-        Imf::Header header(width, height);
+        for (size_t i = 0; i < channel_names.size(); ++i) {
+            frameBuffer.insert(channel_names[i], channelSlice(pass.image, static_cast<int>(i), dw));
+        }
+    }
+    
+    part.setFrameBuffer(frameBuffer);
+    part.readPixels(dw.min.y, dw.max.y);
+}
+
+// Raw frames have whole passes only; "diffuse.R" in the filter selects the
+// whole "diffuse" pass
+bool loadRawPasses(const std::string& filepath, const std::vector<std::string>& filter, PixelLayout layout,
+                   std::vector<RenderPass>& passes) {
+    RawFrame frame;
+    if (!frame.open(filepath)) return false;
+    
+    std::vector<RenderPass> loaded;
+    for (const RawPassInfo& info : frame.passes()) {
+        bool wanted = filter.empty();
+        for (size_t i = 0; i < filter.size() && !wanted; ++i) {
+            wanted = filter[i] == info.name || filter[i].compare(0, info.name.size() + 1, info.name + ".") == 0;
+        }
+        if (!wanted) continue;
         
-        // Add channels for each pass
-        for (const auto& pass : passes) {
-            for (int c = 0; c < pass.image.channels; ++c) {
-                std::string channel_name = pass.layer_name + "." + 
-                    (c == 0 ? "R" : c == 1 ? "G" : c == 2 ? "B" : c == 3 ? "A" : 
-                     std::to_string(c));
-                header.channels().insert(channel_name, Imf::Channel(Imf::FLOAT));
+        loaded.emplace_back(info.name, 0, 0, 0, false, layout);
+        if (!frame.readPass(info.name, loaded.back().image, layout)) return false;
+    }
+    
+    if (loaded.empty()) {
+        std::cerr << "No matching passes in raw frame: " << filepath << std::endl;
+        return false;
+    }
+    for (auto& pass : loaded) {
+        passes.push_back(std::move(pass));
+    }
+    return true;
+}
+
+// a * (1 - factor) + b * factor for images of the output's shape, one
+// contiguous run per plane row
+template <class Shape>
+void mixRows(const ImageData& a, const ImageData& b, ImageData& output, float factor) {
+    auto first = Shape::view(a);
+    auto second = Shape::view(b);
+    auto mixed = Shape::view(output);
+    const size_t count = mixed.rowSamples();
+    
+    parallelFor(0, output.height, [&](int y_begin, int y_end) {
+        const simd::VecF keep(1.0f - factor), take(factor);
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int p = 0; p < mixed.planes(); ++p) {
+                const float* row1 = first.row(y, p);
+                const float* row2 = second.row(y, p);
+                float* dst = mixed.row(y, p);
+                size_t i = 0;
+                for (; i + simd::VecF::width <= count; i += simd::VecF::width) {
+                    (simd::VecF::load(row1 + i) * keep + simd::VecF::load(row2 + i) * take).store(dst + i);
+                }
+                for (; i < count; ++i) {
+                    dst[i] = row1[i] * (1.0f - factor) + row2[i] * factor;
+                }
             }
         }
+    });
+}
+
+} // namespace
+
+Imf::Compression EXRWriteOptions::compressionFor(const std::string& pass) const {
+    auto it = pass_compression.find(pass);
+    return (it != pass_compression.end()) ? it->second : compression;
+}
+
+Imf::PixelType EXRWriteOptions::pixelTypeFor(const std::string& pass, const std::string& channel) const {
+    auto it = channel_types.find(channel);
+    if (it == channel_types.end()) {
+        it = channel_types.find(pass);
+    }
+    return (it != channel_types.end()) ? it->second : pixel_type;
+}
+
+void sortChannelNames(std::vector<std::string>& channel_names) {
+    std::stable_sort(channel_names.begin(), channel_names.end(),
+                     [](const std::string& a, const std::string& b) {
+                         return channelOrder(a) < channelOrder(b);
+                     });
+}
+
+EXRProcessor::EXRProcessor()
+    : pixel_layout_(PixelLayout::INTERLEAVED), output_pixel_type_(Imf::FLOAT),
+      output_compression_(Imf::ZIP_COMPRESSION) {
+}
+
+EXRProcessor::~EXRProcessor() {
+    clearPasses();
+}
+
+bool EXRProcessor::loadEXR(const std::string& filepath, ImageData& image) {
+    ProfileScope scope("exr.load");
+    bool ok = readRGBA(filepath, image, pixel_layout_);
+    scope.addImageWritten(image);
+    return ok;
+}
+
+bool EXRProcessor::saveEXR(const std::string& filepath, const ImageData& image) {
+    ProfileScope scope("exr.save");
+    scope.addImageRead(image);
+    scope.addPixels(static_cast<uint64_t>(image.width) * image.height);
+    return writeRGBA(filepath, image, output_pixel_type_, output_compression_);
+}
+
+bool EXRProcessor::saveEXR(const std::string& filepath, const ImageData& image, const EXRWriteOptions& options) {
+    ProfileScope scope("exr.save");
+    scope.addImageRead(image);
+    scope.addPixels(static_cast<uint64_t>(image.width) * image.height);
+    std::vector<WritePass> passes(1, makeWritePass("rgba", "", image));
+    return writePasses(filepath, passes, options);
+}
+
+bool EXRProcessor::loadEXR(const std::string& filepath, HalfImageData& image) {
+    ProfileScope scope("exr.load_half");
+    bool ok = readRGBA(filepath, image, pixel_layout_);
+    scope.addImageWritten(image);
+    return ok;
+}
+
+bool EXRProcessor::saveEXR(const std::string& filepath, const HalfImageData& image) {
+    ProfileScope scope("exr.save_half");
+    scope.addImageRead(image);
+    scope.addPixels(static_cast<uint64_t>(image.width) * image.height);
+    return writeRGBA(filepath, image, Imf::HALF, output_compression_);
+}
+
+void EXRProcessor::setCodecThreadCount(int thread_count) {
+    initCodecThreads();
+    Imf::setGlobalThreadCount(std::max(0, thread_count));
+}
+
+bool EXRProcessor::getEXRSize(const std::string& filepath, int& width, int& height) {
+    try {
+        Imf::InputFile file(filepath.c_str());
+        Imath::Box2i dw = file.header().dataWindow();
+        
+        width = dw.max.x - dw.min.x + 1;
+        height = dw.max.y - dw.min.y + 1;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error reading EXR header: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool EXRProcessor::loadEXRInto(const std::string& filepath, float* buffer, size_t buffer_floats,
+                               PixelLayout layout) {
+    try {
+        Imf::InputFile file(filepath.c_str());
+        Imath::Box2i dw = file.header().dataWindow();
+        
+        int width = dw.max.x - dw.min.x + 1;
+        int height = dw.max.y - dw.min.y + 1;
+        
+        if (buffer_floats < static_cast<size_t>(width) * height * 4) {
+            std::cerr << "Buffer too small for EXR image " << width << "x" << height
+                      << ": " << filepath << std::endl;
+            return false;
+        }
         
-        Imf::OutputFile file(filepath.c_str(), header);
-        Imf::FrameBuffer frameBuffer;
+        decodeRGBA(file, filepath, buffer, width, height, layout);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading EXR file: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool EXRProcessor::loadMultiPlaneEXR(const std::string& filepath, std::vector<RenderPass>& passes,
+                                     const std::vector<std::string>& filter) {
+    ProfileScope scope("exr.load_multiplane");
+    if (isRawFrame(filepath)) {
+        return loadRawPasses(filepath, filter, pixel_layout_, passes);
+    }
+    
+    initCodecThreads();
+    try {
+        // Single-part files are read as a file with one part
+        Imf::MultiPartInputFile file(filepath.c_str());
+        std::vector<RenderPass> loaded;
+        for (int p = 0; p < file.parts(); ++p) {
+            Imf::InputPart part(file, p);
+            readPartLayers(part, filter, pixel_layout_, loaded);
+        }
         
-        // Set up frame buffer for each pass
-        for (const auto& pass : passes) {
-            for (int c = 0; c < pass.image.channels; ++c) {
-                std::string channel_name = pass.layer_name + "." + 
-                    (c == 0 ? "R" : c == 1 ? "G" : c == 2 ? "B" : c == 3 ? "A" : 
-                     std::to_string(c));
-                
-                frameBuffer.insert(channel_name, Imf::Slice(Imf::FLOAT,
-                    (char*)&pass.image.data[c], sizeof(float) * pass.image.channels,
-                    sizeof(float) * width * pass.image.channels));
-            }
+        if (loaded.empty()) {
+            std::cerr << "No matching layers in multi-plane EXR: " << filepath << std::endl;
+            return false;
         }
         
-        file.setFrameBuffer(frameBuffer);
-        file.writePixels(height);
+        for (auto& pass : loaded) {
+            scope.addImageWritten(pass.image);
+            passes.push_back(std::move(pass));
+        }
         
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error saving multi-plane EXR: " << e.what() << std::endl;
+        std::cerr << "Error loading multi-plane EXR: " << e.what() << std::endl;
         return false;
     }
 }
 
+bool EXRProcessor::saveMultiPlaneEXR(const std::string& filepath, const std::vector<RenderPass>& passes) {
+    EXRWriteOptions options;
+    options.compression = output_compression_;
+    options.pixel_type = output_pixel_type_;
+    return saveMultiPlaneEXR(filepath, passes, options);
+}
+
+bool EXRProcessor::saveMultiPlaneEXR(const std::string& filepath, const std::vector<RenderPass>& passes,
+                                     const EXRWriteOptions& options) {
+    ProfileScope scope("exr.save_multiplane");
+    std::vector<WritePass> parts;
+    for (const RenderPass& pass : passes) {
+        scope.addImageRead(pass.image);
+        parts.push_back(makeWritePass(pass.name, pass.layer_name, pass.image));
+    }
+    return writePasses(filepath, parts, options);
+}
+
 void EXRProcessor::addRenderPass(const std::string& name, int width, int height, int channels, bool is_alpha) {
-    render_passes_[name] = std::make_unique<RenderPass>(name, width, height, channels, is_alpha);
+    render_passes_[name] = std::make_unique<RenderPass>(name, width, height, channels, is_alpha, pixel_layout_);
 }
 
 RenderPass* EXRProcessor::getRenderPass(const std::string& name) {
@@ -194,36 +595,83 @@ RenderPass* EXRProcessor::getRenderPass(const std::string& name) {
 
 void EXRProcessor::clearPasses() {
     render_passes_.clear();
+    if (incremental_) incremental_->clear();
+}
+
+void EXRProcessor::setIncrementalCompositing(bool enabled) {
+    if (!enabled) {
+        incremental_.reset();
+    } else if (!incremental_) {
+        incremental_ = std::make_unique<IncrementalCompositor>();
+    }
+}
+
+bool EXRProcessor::saveRenderPasses(const std::string& path_prefix, int max_concurrency) {
+    ProfileScope scope("exr.save_passes");
+    
+    // Largest first: workers steal the oldest tasks, so small passes fill in around them
+    std::vector<const RenderPass*> passes;
+    for (const auto& entry : render_passes_) {
+        passes.push_back(entry.second.get());
+    }
+    std::stable_sort(passes.begin(), passes.end(), [](const RenderPass* a, const RenderPass* b) {
+        return a->image.data.size() > b->image.data.size();
+    });
+    
+    // Passes keep their channel count (depth is one channel), so they take the
+    // named-channel writer rather than the RGBA one
+    EXRWriteOptions options;
+    options.compression = output_compression_;
+    options.pixel_type = output_pixel_type_;
+    
+    std::atomic<int> failed(0);
+    {
+        TaskGroup group(max_concurrency);
+        for (const RenderPass* pass : passes) {
+            group.run([this, pass, &path_prefix, &options, &failed]() {
+                if (!saveEXR(path_prefix + pass->name + ".exr", pass->image, options)) {
+                    failed.fetch_add(1);
+                }
+            });
+        }
+        group.wait();
+    }
+    return failed.load() == 0;
 }
 
 void EXRProcessor::applyGaussianBlur(ImageData& image, float sigma, int kernel_size) {
+    if (sigma <= 0.0f) return;
+    ProfileScope scope("exr.gaussian_blur", image);
+    
+    if (result_cache_) {
+        kernel_size = std::max(0, kernel_size);
+        ResultCache::Key key = ResultCache::KeyBuilder("gaussian_blur")
+            .add(sigma).add(kernel_size).add(image).key();
+        result_cache_->getOrCompute(key, image, [&](ImageData& result) {
+            gaussianBlurUncached(result, sigma, kernel_size);
+        });
+        return;
+    }
+    
+    gaussianBlurUncached(image, sigma, kernel_size);
+}
+
+void EXRProcessor::gaussianBlurUncached(ImageData& image, float sigma, int kernel_size) {
+    // The default size follows ImageFilters, including the large-sigma box mode
     if (kernel_size <= 0) {
-        kernel_size = static_cast<int>(std::ceil(2.0f * sigma) * 2 + 1);
+        ImageFilters::gaussianBlur(image, sigma);
+        return;
     }
     
     std::vector<float> kernel;
     createGaussianKernel(kernel, sigma, kernel_size);
-    
-    ImageData temp(image.width, image.height, image.channels);
-    applyKernel(image, temp, kernel, kernel_size);
-    image = std::move(temp);
+    ImageFilters::separableConvolve(image, kernel);
 }
 
 void EXRProcessor::applySharpen(ImageData& image, float strength) {
-    // Unsharp mask
-    ImageData blurred = image;
-    applyGaussianBlur(blurred, 1.0f);
-    
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            for (int c = 0; c < image.channels; ++c) {
-                float original = image(x, y, c);
-                float blurred_val = blurred(x, y, c);
-                image(x, y, c) = original + strength * (original - blurred_val);
-                clampPixel(image(x, y, c));
-            }
-        }
-    }
+    ProfileScope scope("exr.sharpen", image);
+    // Unsharp mask at radius 1 that sharpens every sample
+    ImageFilters::unsharpMask(image, 1.0f, strength, 0.0f);
 }
 
 void EXRProcessor::applyEdgeDetection(ImageData& image) {
@@ -231,18 +679,13 @@ void EXRProcessor::applyEdgeDetection(ImageData& image) {
 }
 
 void EXRProcessor::applyToneMapping(ImageData& image, float exposure, float gamma) {
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            for (int c = 0; c < image.channels; ++c) {
-                if (c == 3) continue; // Skip alpha channel
-                
-                float value = image(x, y, c) * exposure;
-                value = 1.0f - std::exp(-value);
-                value = std::pow(value, 1.0f / gamma);
-                image(x, y, c) = value;
-            }
-        }
-    }
+    ProfileScope scope("exr.tone_map", image);
+    color::transformSamples(image, color::FilmicToneMap{exposure, 1.0f / gamma});
+}
+
+void EXRProcessor::applyDisplayToneMapping(ImageData& image, float exposure, float gamma) {
+    ProfileScope scope("exr.display_tone_map", image);
+    color::transformSamples(image, color::ReinhardToneMap{exposure, 1.0f / gamma});
 }
 
 void EXRProcessor::compositePasses(const std::vector<std::string>& pass_names, ImageData& output) {
@@ -252,17 +695,90 @@ void EXRProcessor::compositePasses(const std::vector<std::string>& pass_names, I
     RenderPass* first_pass = getRenderPass(pass_names[0]);
     if (!first_pass) return;
     
-    output = first_pass->image;
+    ProfileScope scope("exr.composite_passes");
+    std::vector<RenderPass*> passes(1, first_pass);
+    for (size_t i = 1; i < pass_names.size(); ++i) {
+        if (RenderPass* pass = getRenderPass(pass_names[i])) {
+            passes.push_back(pass);
+        }
+    }
+    for (RenderPass* pass : passes) {
+        scope.addImageRead(pass->image);
+    }
+    scope.addPixels(static_cast<uint64_t>(first_pass->image.width) * first_pass->image.height);
+    
+    // Every prefix of the chain has a key covering all of its inputs, so a
+    // changed pass only recomputes the composite from that pass onwards
+    std::vector<ResultCache::Key> keys;
+    size_t done = 0;
+    if (result_cache_) {
+        ResultCache::KeyBuilder builder("composite_passes");
+        for (RenderPass* pass : passes) {
+            keys.push_back(builder.add(pass->image).key());
+        }
+        for (size_t n = passes.size(); n > 1 && done == 0; --n) {
+            if (ResultCache::ResultPtr cached = result_cache_->find(keys[n - 1])) {
+                output = *cached;
+                done = n;
+            }
+        }
+    }
+    
+    if (done == 0) {
+        // Uncached chains of matching passes are summed in a single sweep
+        // (the same clamped adds as addPass)
+        bool uniform = !result_cache_;
+        for (RenderPass* pass : passes) {
+            uniform = uniform && pass->image.width == first_pass->image.width &&
+                      pass->image.height == first_pass->image.height &&
+                      pass->image.channels == first_pass->image.channels;
+        }
+        if (uniform && passes.size() > 1) {
+            std::vector<Compositor::Layer> layers;
+            for (RenderPass* pass : passes) {
+                layers.push_back({&pass->image, Compositor::LINEAR_DODGE, 1.0f, nullptr});
+            }
+            // Stacks the incremental state rejects (output is one of the passes) start from scratch
+            if (incremental_ && incremental_->composite(layers)) {
+                output = incremental_->result();
+            } else {
+                Compositor::compositeLayers(layers, output);
+            }
+            return;
+        }
+        
+        output = first_pass->image;
+        done = 1;
+    }
     
     // Composite remaining passes
-    for (size_t i = 1; i < pass_names.size(); ++i) {
-        RenderPass* pass = getRenderPass(pass_names[i]);
-        if (pass) {
-            addPass(*pass, output, 1.0f);
+    for (size_t i = done; i < passes.size(); ++i) {
+        addPass(*passes[i], output, 1.0f);
+        if (result_cache_) {
+            result_cache_->insert(keys[i], output);
         }
     }
 }
 
+bool EXRProcessor::compositeLayers(const std::vector<PassLayer>& layers, ImageData& output, bool clamp) {
+    std::vector<Compositor::Layer> stack;
+    for (const PassLayer& layer : layers) {
+        RenderPass* pass = getRenderPass(layer.pass);
+        RenderPass* mask = layer.mask.empty() ? nullptr : getRenderPass(layer.mask);
+        if (!pass || (!layer.mask.empty() && !mask)) {
+            std::cerr << "Render pass not found: " << (pass ? layer.mask : layer.pass) << std::endl;
+            return false;
+        }
+        stack.push_back({&pass->image, layer.mode, layer.opacity, mask ? &mask->image : nullptr});
+    }
+    
+    if (incremental_ && incremental_->composite(stack, clamp)) {
+        output = incremental_->result();
+        return true;
+    }
+    return Compositor::compositeLayers(stack, output, clamp);
+}
+
 void EXRProcessor::blendPasses(const RenderPass& pass1, const RenderPass& pass2, 
                                ImageData& output, float blend_factor) {
     if (pass1.image.width != pass2.image.width || 
@@ -271,18 +787,51 @@ void EXRProcessor::blendPasses(const RenderPass& pass1, const RenderPass& pass2,
         return;
     }
     
-    output = ImageData(pass1.image.width, pass1.image.height, 
-                      std::max(pass1.image.channels, pass2.image.channels));
+    if (result_cache_) {
+        ResultCache::Key key = ResultCache::KeyBuilder("blend_passes")
+            .add(blend_factor).add(pass1.image).add(pass2.image).key();
+        result_cache_->getOrCompute(key, output, [&](ImageData& result) {
+            blendPassesUncached(pass1, pass2, result, blend_factor);
+        });
+        return;
+    }
+    
+    blendPassesUncached(pass1, pass2, output, blend_factor);
+}
+
+void EXRProcessor::blendPassesUncached(const RenderPass& pass1, const RenderPass& pass2,
+                                       ImageData& output, float blend_factor) {
+    ProfileScope scope("exr.blend_passes");
+    scope.addImageRead(pass1.image);
+    scope.addImageRead(pass2.image);
     
-    for (int y = 0; y < output.height; ++y) {
-        for (int x = 0; x < output.width; ++x) {
-            for (int c = 0; c < output.channels; ++c) {
-                float val1 = (c < pass1.image.channels) ? pass1.image(x, y, c) : 0.0f;
-                float val2 = (c < pass2.image.channels) ? pass2.image(x, y, c) : 0.0f;
-                output(x, y, c) = val1 * (1.0f - blend_factor) + val2 * blend_factor;
+    // Every sample is written, so an output of the right shape is reused as is
+    output.reshape(pass1.image.width, pass1.image.height,
+                   std::max(pass1.image.channels, pass2.image.channels), pass1.image.layout);
+    output.setWindowsFrom(pass1.image);
+    
+    if (pass1.image.hasShape(output.width, output.height, output.channels, output.layout) &&
+        pass2.image.hasShape(output.width, output.height, output.channels, output.layout)) {
+        dispatchShape(output, [&](auto shape) {
+            mixRows<decltype(shape)>(pass1.image, pass2.image, output, blend_factor);
+        });
+        scope.addImageWritten(output);
+        return;
+    }
+    
+    // Passes with different channel counts or layouts zero-fill the missing channels
+    parallelFor(0, output.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int x = 0; x < output.width; ++x) {
+                for (int c = 0; c < output.channels; ++c) {
+                    float val1 = (c < pass1.image.channels) ? pass1.image(x, y, c) : 0.0f;
+                    float val2 = (c < pass2.image.channels) ? pass2.image(x, y, c) : 0.0f;
+                    output(x, y, c) = val1 * (1.0f - blend_factor) + val2 * blend_factor;
+                }
             }
         }
-    }
+    });
+    scope.addImageWritten(output);
 }
 
 void EXRProcessor::addPass(const RenderPass& pass, ImageData& output, float opacity) {
@@ -313,66 +862,47 @@ void EXRProcessor::overlayPass(const RenderPass& pass, ImageData& output) {
     Compositor::blend(output, pass.image, output, Compositor::OVERLAY);
 }
 
-void EXRProcessor::resizeImage(const ImageData& input, ImageData& output, int new_width, int new_height) {
-    output = ImageData(new_width, new_height, input.channels);
-    
-    float x_ratio = static_cast<float>(input.width) / new_width;
-    float y_ratio = static_cast<float>(input.height) / new_height;
+void EXRProcessor::resizeImage(const ImageData& source, ImageData& output, int new_width, int new_height,
+                               ResampleFilter filter) {
+    ProfileScope scope("exr.resize");
+    scope.addImageRead(source);
     
-    for (int y = 0; y < new_height; ++y) {
-        for (int x = 0; x < new_width; ++x) {
-            float src_x = x * x_ratio;
-            float src_y = y * y_ratio;
-            
-            int x1 = static_cast<int>(src_x);
-            int y1 = static_cast<int>(src_y);
-            int x2 = std::min(x1 + 1, input.width - 1);
-            int y2 = std::min(y1 + 1, input.height - 1);
-            
-            float fx = src_x - x1;
-            float fy = src_y - y1;
-            
-            for (int c = 0; c < input.channels; ++c) {
-                float val = (1.0f - fx) * (1.0f - fy) * input(x1, y1, c) +
-                           fx * (1.0f - fy) * input(x2, y1, c) +
-                           (1.0f - fx) * fy * input(x1, y2, c) +
-                           fx * fy * input(x2, y2, c);
-                output(x, y, c) = val;
-            }
-        }
-    }
+    Resampler::resize(source, output, new_width, new_height, filter);
+    scope.addImageWritten(output);
 }
 
 void EXRProcessor::convertToLinear(ImageData& image) {
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            for (int c = 0; c < image.channels; ++c) {
-                if (c == 3) continue; // Skip alpha
-                float val = image(x, y, c);
-                if (val <= 0.04045f) {
-                    image(x, y, c) = val / 12.92f;
-                } else {
-                    image(x, y, c) = std::pow((val + 0.055f) / 1.055f, 2.4f);
-                }
-            }
-        }
-    }
+    ProfileScope scope("exr.to_linear", image);
+    color::transformSamples(image, color::SRGBToLinear());
 }
 
 void EXRProcessor::convertToSRGB(ImageData& image) {
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            for (int c = 0; c < image.channels; ++c) {
-                if (c == 3) continue; // Skip alpha
-                float val = image(x, y, c);
-                if (val <= 0.0031308f) {
-                    image(x, y, c) = 12.92f * val;
-                } else {
-                    image(x, y, c) = 1.055f * std::pow(val, 1.0f / 2.4f) - 0.055f;
-                }
-            }
-        }
-    }
+    ProfileScope scope("exr.to_srgb", image);
+    color::transformSamples(image, color::LinearToSRGB());
+}
+
+void EXRProcessor::applyToneMapping(HalfImageData& image, float exposure, float gamma) {
+    processHalfRows(image, [&](ImageData& block) {
+        applyToneMapping(block, exposure, gamma);
+    });
+}
+
+void EXRProcessor::applyDisplayToneMapping(HalfImageData& image, float exposure, float gamma) {
+    processHalfRows(image, [&](ImageData& block) {
+        applyDisplayToneMapping(block, exposure, gamma);
+    });
+}
+
+void EXRProcessor::convertToLinear(HalfImageData& image) {
+    processHalfRows(image, [&](ImageData& block) {
+        convertToLinear(block);
+    });
+}
+
+void EXRProcessor::convertToSRGB(HalfImageData& image) {
+    processHalfRows(image, [&](ImageData& block) {
+        convertToSRGB(block);
+    });
 }
 
 void EXRProcessor::normalizeImage(ImageData& image) {
@@ -409,32 +939,6 @@ float EXRProcessor::gaussian(float x, float sigma) {
     return std::exp(-(x * x) / (2.0f * sigma * sigma));
 }
 
-void EXRProcessor::applyKernel(const ImageData& input, ImageData& output, 
-                               const std::vector<float>& kernel, int kernel_size) {
-    int half_kernel = kernel_size / 2;
-    
-    for (int y = 0; y < input.height; ++y) {
-        for (int x = 0; x < input.width; ++x) {
-            for (int c = 0; c < input.channels; ++c) {
-                float sum = 0.0f;
-                
-                for (int ky = 0; ky < kernel_size; ++ky) {
-                    for (int kx = 0; kx < kernel_size; ++kx) {
-                        int px = x + kx - half_kernel;
-                        int py = y + ky - half_kernel;
-                        
-                        if (px >= 0 && px < input.width && py >= 0 && py < input.height) {
-                            sum += input(px, py, c) * kernel[ky * kernel_size + kx];
-                        }
-                    }
-                }
-                
-                output(x, y, c) = sum;
-            }
-        }
-    }
-}
-
 void EXRProcessor::clampPixel(float& value, float min_val, float max_val) {
     value = std::max(min_val, std::min(max_val, value));
 }
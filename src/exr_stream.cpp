@@ -0,0 +1,171 @@
+#include "exr_stream.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+namespace ImageProcessing {
+
+EXRStreamProcessor::EXRStreamProcessor(int strip_height)
+    : strip_height_(std::max(1, strip_height)), peak_buffer_bytes_(0) {
+}
+
+void EXRStreamProcessor::addFilter(const StreamFilter& filter) {
+    filters_.push_back(filter);
+}
+
+void EXRStreamProcessor::addGaussianBlur(float sigma) {
+    int halo = ImageFilters::gaussianBlurRadius(sigma);
+    addFilter({"gaussian_blur", halo, [sigma](ImageData& strip) {
+        ImageFilters::gaussianBlur(strip, sigma);
+    }});
+}
+
+void EXRStreamProcessor::addSharpen(float strength) {
+    addFilter({"sharpen", 1, [strength](ImageData& strip) {
+        ImageFilters::sharpen(strip, strength);
+    }});
+}
+
+void EXRStreamProcessor::addEdgeDetection() {
+    addFilter({"edge_detection", 1, [](ImageData& strip) {
+        ImageFilters::sobelEdgeDetection(strip);
+    }});
+}
+
+void EXRStreamProcessor::addUnsharpMask(float radius, float amount, float threshold) {
+    int halo = ImageFilters::gaussianBlurRadius(radius);
+    addFilter({"unsharp_mask", halo, [radius, amount, threshold](ImageData& strip) {
+        ImageFilters::unsharpMask(strip, radius, amount, threshold);
+    }});
+}
+
+void EXRStreamProcessor::addToneMapping(float exposure, float gamma) {
+    addFilter({"tone_mapping", 0, [exposure, gamma](ImageData& strip) {
+        EXRProcessor processor;
+        processor.applyToneMapping(strip, exposure, gamma);
+    }});
+}
+
+void EXRStreamProcessor::clearFilters() {
+    filters_.clear();
+}
+
+void EXRStreamProcessor::setStripHeight(int strip_height) {
+    strip_height_ = std::max(1, strip_height);
+}
+
+int EXRStreamProcessor::halo() const {
+    // Each stage consumes its own halo from the rows produced by the previous one
+    int total = 0;
+    for (const auto& filter : filters_) {
+        total += filter.halo;
+    }
+    return total;
+}
+
+bool EXRStreamProcessor::process(const std::string& input_path, const std::string& output_path) {
+    try {
+        Imf::InputFile input(input_path.c_str());
+        const Imf::Header& in_header = input.header();
+
+        Imath::Box2i dw = in_header.dataWindow();
+        int width = dw.max.x - dw.min.x + 1;
+        int height = dw.max.y - dw.min.y + 1;
+
+        std::vector<std::string> channel_names;
+        for (Imf::ChannelList::ConstIterator it = in_header.channels().begin();
+             it != in_header.channels().end(); ++it) {
+            channel_names.push_back(it.name());
+        }
+        sortChannelNames(channel_names);
+
+        if (channel_names.empty()) {
+            std::cerr << "No channels to stream in: " << input_path << std::endl;
+            return false;
+        }
+
+        int channels = static_cast<int>(channel_names.size());
+        int halo_rows = halo();
+        int max_rows = std::min(height, strip_height_ + 2 * halo_rows);
+
+        Imf::Header out_header(in_header.displayWindow(), dw);
+        out_header.compression() = in_header.compression();
+        for (const auto& name : channel_names) {
+            out_header.channels().insert(name, Imf::Channel(Imf::FLOAT));
+        }
+        Imf::OutputFile output(output_path.c_str(), out_header);
+
+        size_t x_stride = sizeof(float) * channels;
+        size_t y_stride = x_stride * width;
+        size_t row_floats = static_cast<size_t>(width) * channels;
+
+        // Raw decoded rows [window_start, window_end) and the strip the filters work on
+        std::vector<float> window(row_floats * max_rows);
+        ImageData strip(width, max_rows, channels);
+        int window_start = 0;
+        int window_end = 0;
+
+        peak_buffer_bytes_ = (window.size() + strip.data.size()) * sizeof(float);
+
+        for (int core_start = 0; core_start < height; core_start += strip_height_) {
+            int core_end = std::min(height, core_start + strip_height_);
+            int need_start = std::max(0, core_start - halo_rows);
+            int need_end = std::min(height, core_end + halo_rows);
+
+            // Keep the overlap with the previous strip instead of decoding it again
+            if (need_start < window_end) {
+                int keep = window_end - need_start;
+                std::memmove(window.data(), window.data() + (need_start - window_start) * row_floats,
+                             keep * row_floats * sizeof(float));
+                window_start = need_start;
+            } else {
+                window_start = window_end = need_start;
+            }
+
+            if (need_end > window_end) {
+                char* base = reinterpret_cast<char*>(window.data()) -
+                             dw.min.x * x_stride - (dw.min.y + window_start) * y_stride;
+
+                Imf::FrameBuffer frameBuffer;
+                for (int c = 0; c < channels; ++c) {
+                    frameBuffer.insert(channel_names[c], Imf::Slice(Imf::FLOAT,
+                        base + c * sizeof(float), x_stride, y_stride));
+                }
+
+                input.setFrameBuffer(frameBuffer);
+                input.readPixels(dw.min.y + window_end, dw.min.y + need_end - 1);
+                window_end = need_end;
+            }
+
+            // Filters run on a copy so the raw overlap stays valid for the next strip
+            int rows = need_end - need_start;
+            strip.height = rows;
+            strip.data.resize(row_floats * rows);
+            std::copy(window.begin(), window.begin() + row_floats * rows, strip.data.begin());
+
+            for (const auto& filter : filters_) {
+                filter.apply(strip);
+            }
+
+            char* out_base = reinterpret_cast<char*>(strip.data.data()) -
+                             dw.min.x * x_stride - (dw.min.y + need_start) * y_stride;
+
+            Imf::FrameBuffer outBuffer;
+            for (int c = 0; c < channels; ++c) {
+                outBuffer.insert(channel_names[c], Imf::Slice(Imf::FLOAT,
+                    out_base + c * sizeof(float), x_stride, y_stride));
+            }
+
+            output.setFrameBuffer(outBuffer);
+            output.writePixels(core_end - core_start);
+        }
+
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error streaming EXR file: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+} // namespace ImageProcessing
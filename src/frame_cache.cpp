@@ -0,0 +1,109 @@
+#include "frame_cache.h"
+
+namespace ImageProcessing {
+
+FrameCache::FrameCache(size_t budget_bytes)
+    : budget_bytes_(budget_bytes), used_bytes_(0) {
+}
+
+FrameCache::FramePtr FrameCache::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+
+    ++stats_.hits;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+}
+
+FrameCache::FramePtr FrameCache::peek(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    return (it != index_.end()) ? it->second->second : nullptr;
+}
+
+bool FrameCache::contains(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.count(key) != 0;
+}
+
+void FrameCache::insert(const std::string& key, FramePtr frame) {
+    if (!frame) return;
+    size_t bytes = frameBytes(*frame);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        used_bytes_ -= frameBytes(*it->second->second);
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+    if (bytes > budget_bytes_) return;
+
+    evictToFit(bytes);
+    entries_.emplace_front(key, std::move(frame));
+    index_[key] = entries_.begin();
+    used_bytes_ += bytes;
+}
+
+void FrameCache::erase(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return;
+
+    used_bytes_ -= frameBytes(*it->second->second);
+    entries_.erase(it->second);
+    index_.erase(it);
+}
+
+void FrameCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    used_bytes_ = 0;
+}
+
+void FrameCache::setBudget(size_t budget_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_bytes_ = budget_bytes;
+    evictToFit(0);
+}
+
+size_t FrameCache::budget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_bytes_;
+}
+
+size_t FrameCache::bytesUsed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_bytes_;
+}
+
+size_t FrameCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+FrameCache::Stats FrameCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void FrameCache::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ = Stats();
+}
+
+void FrameCache::evictToFit(size_t incoming) {
+    while (!entries_.empty() && used_bytes_ + incoming > budget_bytes_) {
+        used_bytes_ -= frameBytes(*entries_.back().second);
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,169 @@
+#include "frame_pool.h"
+#include <cstdint>
+#include <iterator>
+
+namespace ImageProcessing {
+
+namespace {
+
+// ::operator new only guarantees 16 bytes, so over-allocate and keep the
+// original pointer just below the aligned block
+void* alignedAllocate(size_t bytes) {
+    void* raw = ::operator new(bytes + FramePool::kAlignment + sizeof(void*));
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(void*);
+    uintptr_t aligned = (start + FramePool::kAlignment - 1) & ~(uintptr_t(FramePool::kAlignment) - 1);
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    return reinterpret_cast<void*>(aligned);
+}
+
+void alignedFree(void* block) {
+    if (block) {
+        ::operator delete(static_cast<void**>(block)[-1]);
+    }
+}
+
+} // namespace
+
+FramePool::FramePool(size_t retain_bytes)
+    : retain_bytes_(retain_bytes), live_bytes_(0), peak_bytes_(0) {
+}
+
+FramePool::~FramePool() {
+    trim();
+}
+
+FramePool& FramePool::global() {
+    // Never destroyed, so images in other static objects can still be freed at exit
+    static FramePool* pool = new FramePool();
+    return *pool;
+}
+
+size_t FramePool::sizeClass(size_t bytes) {
+    if (bytes <= kMinPooledBytes) return bytes;
+
+    size_t power = kMinPooledBytes;
+    while (power <= bytes / 2) {
+        power *= 2;
+    }
+    size_t step = power / 4;
+    return (bytes + step - 1) / step * step;
+}
+
+void* FramePool::allocate(size_t bytes) {
+    if (bytes <= kMinPooledBytes) {
+        void* block = alignedAllocate(bytes);
+        trackLive(bytes);
+        return block;
+    }
+
+    size_t size = sizeClass(bytes);
+    trackLive(bytes);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.allocations;
+        stats_.bytes_outstanding += size;
+
+        auto it = free_blocks_.find(size);
+        if (it != free_blocks_.end() && !it->second.empty()) {
+            void* block = it->second.back();
+            it->second.pop_back();
+            stats_.bytes_cached -= size;
+            ++stats_.reuses;
+            return block;
+        }
+    }
+
+    try {
+        return alignedAllocate(size);
+    } catch (...) {
+        // Out of memory: drop the cache and try once more
+        trim();
+        try {
+            return alignedAllocate(size);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.bytes_outstanding -= size;
+            live_bytes_ -= bytes;
+            throw;
+        }
+    }
+}
+
+void FramePool::deallocate(void* block, size_t bytes) {
+    if (!block) return;
+    live_bytes_ -= bytes;
+    if (bytes <= kMinPooledBytes) {
+        alignedFree(block);
+        return;
+    }
+
+    size_t size = sizeClass(bytes);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_outstanding -= size;
+        if (size <= retain_bytes_) {
+            releaseToFit(size);
+            free_blocks_[size].push_back(block);
+            stats_.bytes_cached += size;
+            return;
+        }
+    }
+    alignedFree(block);
+}
+
+void FramePool::setRetainLimit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retain_bytes_ = bytes;
+    releaseToFit(0);
+}
+
+size_t FramePool::retainLimit() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return retain_bytes_;
+}
+
+void FramePool::trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& size_blocks : free_blocks_) {
+        for (void* block : size_blocks.second) {
+            alignedFree(block);
+        }
+    }
+    free_blocks_.clear();
+    stats_.bytes_cached = 0;
+}
+
+FramePool::Stats FramePool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.bytes_live = live_bytes_.load();
+    stats.bytes_peak = peak_bytes_.load();
+    return stats;
+}
+
+void FramePool::resetPeak() {
+    peak_bytes_ = live_bytes_.load();
+}
+
+void FramePool::trackLive(size_t bytes) {
+    size_t live = live_bytes_.fetch_add(bytes) + bytes;
+    size_t peak = peak_bytes_.load();
+    while (live > peak && !peak_bytes_.compare_exchange_weak(peak, live)) {
+    }
+}
+
+void FramePool::releaseToFit(size_t incoming) {
+    // Largest blocks are released first
+    while (stats_.bytes_cached + incoming > retain_bytes_ && !free_blocks_.empty()) {
+        auto largest = std::prev(free_blocks_.end());
+        if (largest->second.empty()) {
+            free_blocks_.erase(largest);
+            continue;
+        }
+        alignedFree(largest->second.back());
+        largest->second.pop_back();
+        stats_.bytes_cached -= largest->first;
+    }
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,469 @@
+#include <iostream>
+#include <algorithm>
+#include <glad/glad.h>
+#include "gpu_processor.h"
+
+namespace {
+
+const int kGroupSize = 16;
+
+// Shared by every pass: one invocation per output pixel of the frame
+const char* kComputePrelude = R"(
+    #version 430 core
+    layout (local_size_x = 16, local_size_y = 16) in;
+    layout (rgba32f, binding = 0) uniform writeonly image2D dst;
+
+    // Samples outside the frame read as zero, like the CPU kernels
+    vec4 fetch(sampler2D tex, ivec2 p) {
+        ivec2 size = textureSize(tex, 0);
+        if (p.x < 0 || p.y < 0 || p.x >= size.x || p.y >= size.y) return vec4(0.0);
+        return texelFetch(tex, p, 0);
+    }
+)";
+
+// 1D kernel along `direction`; weights come from ImageFilters::gaussianBlurKernels
+const char* kSeparableSource = R"(
+    uniform sampler2D src;
+    uniform ivec2 direction;
+    uniform int radius;
+    layout (std430, binding = 0) readonly buffer Weights { float weights[]; };
+
+    void main() {
+        ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+        if (any(greaterThanEqual(p, imageSize(dst)))) return;
+
+        vec4 sum = vec4(0.0);
+        for (int i = -radius; i <= radius; ++i) {
+            sum += fetch(src, p + direction * i) * weights[i + radius];
+        }
+        imageStore(dst, p, sum);
+    }
+)";
+
+// ImageFilters::sharpen: 3x3 cross kernel, every channel clamped to [0, 1]
+const char* kSharpenSource = R"(
+    uniform sampler2D src;
+    uniform float strength;
+
+    void main() {
+        ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+        if (any(greaterThanEqual(p, imageSize(dst)))) return;
+
+        vec4 sum = fetch(src, p) * (1.0 + 4.0 * strength)
+                 - strength * (fetch(src, p + ivec2(-1, 0)) + fetch(src, p + ivec2(1, 0)) +
+                               fetch(src, p + ivec2(0, -1)) + fetch(src, p + ivec2(0, 1)));
+        imageStore(dst, p, clamp(sum, 0.0, 1.0));
+    }
+)";
+
+// Sobel (mode 0) or Laplacian (mode 1) magnitude of Rec.601 luma, written to
+// all channels; frames with fewer than 3 channels use channel 0 as the luma
+const char* kEdgeSource = R"(
+    uniform sampler2D src;
+    uniform int mode;
+    uniform int channels;
+
+    float luma(ivec2 p) {
+        vec4 c = fetch(src, p);
+        return channels < 3 ? c.r : dot(c.rgb, vec3(0.299, 0.587, 0.114));
+    }
+
+    void main() {
+        ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+        if (any(greaterThanEqual(p, imageSize(dst)))) return;
+
+        float edge;
+        if (mode == 0) {
+            float tl = luma(p + ivec2(-1, -1)), t = luma(p + ivec2(0, -1)), tr = luma(p + ivec2(1, -1));
+            float l = luma(p + ivec2(-1, 0)), r = luma(p + ivec2(1, 0));
+            float bl = luma(p + ivec2(-1, 1)), b = luma(p + ivec2(0, 1)), br = luma(p + ivec2(1, 1));
+            float gx = (tr + 2.0 * r + br) - (tl + 2.0 * l + bl);
+            float gy = (bl + 2.0 * b + br) - (tl + 2.0 * t + tr);
+            edge = min(1.0, sqrt(gx * gx + gy * gy));
+        } else {
+            edge = abs(4.0 * luma(p) - luma(p + ivec2(-1, 0)) - luma(p + ivec2(1, 0)) -
+                       luma(p + ivec2(0, -1)) - luma(p + ivec2(0, 1)));
+        }
+        imageStore(dst, p, vec4(edge));
+    }
+)";
+
+// Copy (mode 0) or EXRProcessor::applyToneMapping (mode 1, alpha untouched)
+const char* kPointSource = R"(
+    uniform sampler2D src;
+    uniform int mode;
+    uniform float exposure;
+    uniform float gamma;
+
+    void main() {
+        ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+        if (any(greaterThanEqual(p, imageSize(dst)))) return;
+
+        vec4 color = texelFetch(src, p, 0);
+        if (mode == 1) {
+            // Negative input (filter ringing) maps to 0 like the CPU path, not NaN
+            color.rgb = pow(max(1.0 - exp(-color.rgb * exposure), vec3(0.0)), vec3(1.0 / gamma));
+        }
+        imageStore(dst, p, color);
+    }
+)";
+
+// ImageFilters::unsharpMask combine step
+const char* kUnsharpSource = R"(
+    uniform sampler2D original;
+    uniform sampler2D blurred;
+    uniform float amount;
+    uniform float threshold;
+
+    void main() {
+        ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+        if (any(greaterThanEqual(p, imageSize(dst)))) return;
+
+        vec4 o = texelFetch(original, p, 0);
+        vec4 diff = o - texelFetch(blurred, p, 0);
+        vec4 sharpened = clamp(o + amount * diff, 0.0, 1.0);
+        imageStore(dst, p, mix(o, sharpened, greaterThanEqual(abs(diff), vec4(threshold))));
+    }
+)";
+
+// Compositor::blend; modes numbered as in Compositor::BlendMode. Channels past
+// each input's channel count read as zero, matching the CPU padding.
+const char* kBlendSource = R"(
+    uniform sampler2D base;
+    uniform sampler2D overlay;
+    uniform int mode;
+    uniform float opacity;
+    uniform int base_channels;
+    uniform int overlay_channels;
+
+    vec4 channelMask(int channels) {
+        return vec4(lessThan(ivec4(0, 1, 2, 3), ivec4(channels)));
+    }
+
+    vec4 blendMode(vec4 b, vec4 o) {
+        vec4 one = vec4(1.0);
+        if (mode == 1) return b * o;
+        if (mode == 2) return one - (one - b) * (one - o);
+        if (mode == 3) return mix(one - 2.0 * (one - b) * (one - o), 2.0 * b * o, lessThan(b, vec4(0.5)));
+        if (mode == 4) return mix(2.0 * b * (one - o) + sqrt(b) * (2.0 * o - one),
+                                  2.0 * b * o + b * b * (one - 2.0 * o), lessThan(o, vec4(0.5)));
+        if (mode == 5) return mix(one - 2.0 * (one - b) * (one - o), 2.0 * b * o, lessThan(o, vec4(0.5)));
+        if (mode == 6) return mix(one, b / (one - o), lessThan(o, one));
+        if (mode == 7) return mix(vec4(0.0), one - (one - b) / o, greaterThan(o, vec4(0.0)));
+        if (mode == 8) return b + o;
+        if (mode == 9) return b + o - one;
+        return o;
+    }
+
+    void main() {
+        ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+        if (any(greaterThanEqual(p, imageSize(dst)))) return;
+
+        vec4 b = texelFetch(base, p, 0) * channelMask(base_channels);
+        vec4 o = texelFetch(overlay, p, 0) * channelMask(overlay_channels);
+        imageStore(dst, p, clamp(b * (1.0 - opacity) + blendMode(b, o) * opacity, 0.0, 1.0));
+    }
+)";
+
+GLenum readbackFormat(int channels) {
+    return (channels >= 4) ? GL_RGBA :
+           (channels == 3) ? GL_RGB :
+           (channels == 2) ? GL_RG : GL_RED;
+}
+
+} // namespace
+
+GPUProcessor::GPUProcessor()
+    : available_(false), separable_program_(0), sharpen_program_(0), edge_program_(0),
+      point_program_(0), unsharp_program_(0), blend_program_(0), weights_buffer_(0),
+      current_(0), width_(0), height_(0), channels_(0) {
+    textures_[0] = textures_[1] = textures_[2] = 0;
+}
+
+GPUProcessor::~GPUProcessor() {
+    cleanup();
+}
+
+bool GPUProcessor::initialize() {
+    cleanup();
+
+    if (!GLAD_GL_VERSION_4_3) {
+        std::cout << "Compute shaders unavailable, viewer filters run on the CPU" << std::endl;
+        return false;
+    }
+
+    separable_program_ = buildProgram(kSeparableSource);
+    sharpen_program_ = buildProgram(kSharpenSource);
+    edge_program_ = buildProgram(kEdgeSource);
+    point_program_ = buildProgram(kPointSource);
+    unsharp_program_ = buildProgram(kUnsharpSource);
+    blend_program_ = buildProgram(kBlendSource);
+
+    if (!separable_program_ || !sharpen_program_ || !edge_program_ ||
+        !point_program_ || !unsharp_program_ || !blend_program_) {
+        std::cerr << "Failed to build GPU filter programs" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    glGenBuffers(1, &weights_buffer_);
+    available_ = true;
+    return true;
+}
+
+void GPUProcessor::cleanup() {
+    unsigned int* programs[] = {&separable_program_, &sharpen_program_, &edge_program_,
+                                &point_program_, &unsharp_program_, &blend_program_};
+    for (unsigned int* program : programs) {
+        if (*program) {
+            glDeleteProgram(*program);
+            *program = 0;
+        }
+    }
+    if (weights_buffer_) {
+        glDeleteBuffers(1, &weights_buffer_);
+        weights_buffer_ = 0;
+    }
+    if (textures_[0]) {
+        glDeleteTextures(3, textures_);
+        textures_[0] = textures_[1] = textures_[2] = 0;
+    }
+
+    width_ = height_ = channels_ = 0;
+    current_ = 0;
+    available_ = false;
+}
+
+bool GPUProcessor::setSource(unsigned int texture, int width, int height, int channels) {
+    if (!available_ || !texture || width <= 0 || height <= 0) return false;
+
+    ensureTextures(width, height);
+    channels_ = channels;
+
+    // A shader copy also converts RGBA16F sources to the RGBA32F working format
+    glUseProgram(point_program_);
+    glUniform1i(glGetUniformLocation(point_program_, "mode"), 0);
+    bindSource(0, texture, point_program_, "src");
+    current_ = 0;
+    dispatch(point_program_, current_);
+    return true;
+}
+
+void GPUProcessor::gaussianBlur(float sigma) {
+    if (!hasFrame() || sigma <= 0.0f) return;
+
+    int dst = spare(current_);
+    blurInto(current_, dst, spare(current_, dst), sigma);
+    current_ = dst;
+}
+
+void GPUProcessor::sharpen(float strength) {
+    if (!hasFrame() || strength <= 0.0f) return;
+
+    int dst = spare(current_);
+    glUseProgram(sharpen_program_);
+    glUniform1f(glGetUniformLocation(sharpen_program_, "strength"), strength);
+    bindSource(0, textures_[current_], sharpen_program_, "src");
+    dispatch(sharpen_program_, dst);
+    current_ = dst;
+}
+
+void GPUProcessor::sobelEdgeDetection() {
+    if (!hasFrame()) return;
+
+    int dst = spare(current_);
+    glUseProgram(edge_program_);
+    glUniform1i(glGetUniformLocation(edge_program_, "mode"), 0);
+    glUniform1i(glGetUniformLocation(edge_program_, "channels"), channels_);
+    bindSource(0, textures_[current_], edge_program_, "src");
+    dispatch(edge_program_, dst);
+    current_ = dst;
+}
+
+void GPUProcessor::laplacianEdgeDetection() {
+    if (!hasFrame()) return;
+
+    int dst = spare(current_);
+    glUseProgram(edge_program_);
+    glUniform1i(glGetUniformLocation(edge_program_, "mode"), 1);
+    glUniform1i(glGetUniformLocation(edge_program_, "channels"), channels_);
+    bindSource(0, textures_[current_], edge_program_, "src");
+    dispatch(edge_program_, dst);
+    current_ = dst;
+}
+
+void GPUProcessor::unsharpMask(float radius, float amount, float threshold) {
+    if (!hasFrame()) return;
+
+    int blurred = spare(current_);
+    int tmp = spare(current_, blurred);
+    if (radius > 0.0f) {
+        blurInto(current_, blurred, tmp, radius);
+    } else {
+        glUseProgram(point_program_);
+        glUniform1i(glGetUniformLocation(point_program_, "mode"), 0);
+        bindSource(0, textures_[current_], point_program_, "src");
+        dispatch(point_program_, blurred);
+    }
+
+    glUseProgram(unsharp_program_);
+    glUniform1f(glGetUniformLocation(unsharp_program_, "amount"), amount);
+    glUniform1f(glGetUniformLocation(unsharp_program_, "threshold"), threshold);
+    bindSource(0, textures_[current_], unsharp_program_, "original");
+    bindSource(1, textures_[blurred], unsharp_program_, "blurred");
+    dispatch(unsharp_program_, tmp);
+    current_ = tmp;
+}
+
+void GPUProcessor::toneMapping(float exposure, float gamma) {
+    if (!hasFrame()) return;
+
+    int dst = spare(current_);
+    glUseProgram(point_program_);
+    glUniform1i(glGetUniformLocation(point_program_, "mode"), 1);
+    glUniform1f(glGetUniformLocation(point_program_, "exposure"), exposure);
+    glUniform1f(glGetUniformLocation(point_program_, "gamma"), gamma);
+    bindSource(0, textures_[current_], point_program_, "src");
+    dispatch(point_program_, dst);
+    current_ = dst;
+}
+
+void GPUProcessor::blend(unsigned int overlay_texture, int overlay_channels,
+                         ImageProcessing::Compositor::BlendMode mode, float opacity) {
+    if (!hasFrame() || !overlay_texture) return;
+
+    int dst = spare(current_);
+    glUseProgram(blend_program_);
+    glUniform1i(glGetUniformLocation(blend_program_, "mode"), static_cast<int>(mode));
+    glUniform1f(glGetUniformLocation(blend_program_, "opacity"), opacity);
+    glUniform1i(glGetUniformLocation(blend_program_, "base_channels"), channels_);
+    glUniform1i(glGetUniformLocation(blend_program_, "overlay_channels"), overlay_channels);
+    bindSource(0, textures_[current_], blend_program_, "base");
+    bindSource(1, overlay_texture, blend_program_, "overlay");
+    dispatch(blend_program_, dst);
+
+    current_ = dst;
+    channels_ = std::max(channels_, overlay_channels);
+}
+
+bool GPUProcessor::readback(ImageProcessing::ImageData& image, ImageProcessing::PixelLayout layout) {
+    using namespace ImageProcessing;
+    if (!hasFrame()) return false;
+
+    int channels = std::min(channels_, 4);
+    ImageData result(width_, height_, channels);
+
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_2D, textures_[current_]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, readbackFormat(channels), GL_FLOAT, result.data.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    result.setLayout(layout);
+    image = std::move(result);
+    return true;
+}
+
+unsigned int GPUProcessor::buildProgram(const std::string& source) {
+    std::string full_source = std::string(kComputePrelude) + source;
+    const char* src = full_source.c_str();
+
+    unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char info_log[512];
+        glGetShaderInfoLog(shader, 512, nullptr, info_log);
+        std::cerr << "Compute shader compilation failed: " << info_log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info_log[512];
+        glGetProgramInfoLog(program, 512, nullptr, info_log);
+        std::cerr << "Compute program linking failed: " << info_log << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+void GPUProcessor::ensureTextures(int width, int height) {
+    if (textures_[0] && width == width_ && height == height_) return;
+
+    if (textures_[0]) {
+        glDeleteTextures(3, textures_);
+    }
+    glGenTextures(3, textures_);
+
+    for (unsigned int texture : textures_) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    width_ = width;
+    height_ = height;
+}
+
+void GPUProcessor::bindSource(int unit, unsigned int texture, unsigned int program, const char* name) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(glGetUniformLocation(program, name), unit);
+}
+
+void GPUProcessor::dispatch(unsigned int program, int dst) {
+    glUseProgram(program);
+    glBindImageTexture(0, textures_[dst], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glDispatchCompute((width_ + kGroupSize - 1) / kGroupSize, (height_ + kGroupSize - 1) / kGroupSize, 1);
+
+    // The next pass samples what this one wrote
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void GPUProcessor::blurInto(int src, int dst, int tmp, float sigma) {
+    std::vector<std::vector<float>> kernels = ImageProcessing::ImageFilters::gaussianBlurKernels(sigma);
+
+    glUseProgram(separable_program_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, weights_buffer_);
+
+    // Rows into tmp, columns into dst; later kernels continue from dst
+    int from = src;
+    for (const auto& kernel : kernels) {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, kernel.size() * sizeof(float), kernel.data(), GL_STREAM_DRAW);
+        glUniform1i(glGetUniformLocation(separable_program_, "radius"), static_cast<int>(kernel.size() / 2));
+
+        glUniform2i(glGetUniformLocation(separable_program_, "direction"), 1, 0);
+        bindSource(0, textures_[from], separable_program_, "src");
+        dispatch(separable_program_, tmp);
+
+        glUniform2i(glGetUniformLocation(separable_program_, "direction"), 0, 1);
+        bindSource(0, textures_[tmp], separable_program_, "src");
+        dispatch(separable_program_, dst);
+        from = dst;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+}
+
+int GPUProcessor::spare(int exclude_a, int exclude_b) const {
+    for (int i = 0; i < 3; ++i) {
+        if (i != exclude_a && i != exclude_b) return i;
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "exr_processor.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdint>
+
+// MSVC never defines __F16C__, but every CPU /arch:AVX2 targets has it
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define SCBW_F16C 1
+#endif
+
+#if defined(SCBW_F16C)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace ImageProcessing {
+
+namespace {
+
+// Samples converted per parallel task by convertToHalf/convertToFloat
+const int kConvertBlock = 16384;
+
+} // namespace
+
+void halfToFloat(const half* src, float* dst, size_t count) {
+    size_t i = 0;
+#if defined(SCBW_F16C)
+    const uint16_t* bits = reinterpret_cast<const uint16_t*>(src);
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint16_t* bits = reinterpret_cast<const uint16_t*>(src);
+    for (; i + 4 <= count; i += 4) {
+        float16x4_t h = vreinterpret_f16_u16(vld1_u16(bits + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(h));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+void floatToHalf(const float* src, half* dst, size_t count) {
+    size_t i = 0;
+#if defined(SCBW_F16C)
+    uint16_t* bits = reinterpret_cast<uint16_t*>(dst);
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bits + i), h);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint16_t* bits = reinterpret_cast<uint16_t*>(dst);
+    for (; i + 4 <= count; i += 4) {
+        float16x4_t h = vcvt_f16_f32(vld1q_f32(src + i));
+        vst1_u16(bits + i, vreinterpret_u16_f16(h));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+void convertToHalf(const ImageData& input, HalfImageData& output) {
+    output = HalfImageData(input.width, input.height, input.channels, input.layout);
+    output.setWindowsFrom(input);
+
+    // Both images share a layout, so the conversion is element-wise over the buffer
+    size_t count = input.data.size();
+    int blocks = static_cast<int>((count + kConvertBlock - 1) / kConvertBlock);
+    parallelFor(0, blocks, [&](int b_begin, int b_end) {
+        size_t begin = static_cast<size_t>(b_begin) * kConvertBlock;
+        size_t end = std::min(count, static_cast<size_t>(b_end) * kConvertBlock);
+        floatToHalf(input.data.data() + begin, output.data.data() + begin, end - begin);
+    });
+}
+
+void convertToFloat(const HalfImageData& input, ImageData& output) {
+    output = ImageData(input.width, input.height, input.channels, input.layout);
+    output.setWindowsFrom(input);
+
+    size_t count = input.data.size();
+    int blocks = static_cast<int>((count + kConvertBlock - 1) / kConvertBlock);
+    parallelFor(0, blocks, [&](int b_begin, int b_end) {
+        size_t begin = static_cast<size_t>(b_begin) * kConvertBlock;
+        size_t end = std::min(count, static_cast<size_t>(b_end) * kConvertBlock);
+        halfToFloat(input.data.data() + begin, output.data.data() + begin, end - begin);
+    });
+}
+
+void processHalfRows(HalfImageData& image, const std::function<void(ImageData&)>& kernel, int block_rows) {
+    block_rows = std::max(1, block_rows);
+    int blocks = (image.height + block_rows - 1) / block_rows;
+
+    // Rows of one plane are contiguous; interleaved images are a single plane
+    int planes = (image.layout == PixelLayout::PLANAR) ? image.channels : 1;
+    size_t plane_row = static_cast<size_t>(image.width) * image.channels / std::max(1, planes);
+
+    parallelFor(0, blocks, [&](int b_begin, int b_end) {
+        ImageData block(image.width, block_rows, image.channels, image.layout);
+
+        for (int b = b_begin; b < b_end; ++b) {
+            int y0 = b * block_rows;
+            int rows = std::min(block_rows, image.height - y0);
+            if (rows != block.height) {
+                block = ImageData(image.width, rows, image.channels, image.layout);
+            }
+
+            for (int p = 0; p < planes; ++p) {
+                halfToFloat(image.data.data() + p * image.channelStride() + y0 * plane_row,
+                            block.data.data() + p * block.channelStride(), rows * plane_row);
+            }
+
+            kernel(block);
+
+            for (int p = 0; p < planes; ++p) {
+                floatToHalf(block.data.data() + p * block.channelStride(),
+                            image.data.data() + p * image.channelStride() + y0 * plane_row, rows * plane_row);
+            }
+        }
+    });
+}
+
+} // namespace ImageProcessing
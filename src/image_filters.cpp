@@ -1,12 +1,22 @@
 #include "exr_processor.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include "image_view.h"
+#include "simd.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 
 namespace ImageProcessing {
 
-void ImageFilters::gaussianBlur(ImageData& image, float sigma) {
-    if (sigma <= 0.0f) return;
-    
+namespace {
+
+// Above this sigma gaussianBlur switches from the direct kernel to stacked box passes
+const float kStackedBoxSigma = 8.0f;
+const int kStackedBoxPasses = 3;
+
+// Normalised direct kernel used below kStackedBoxSigma, radius ceil(2 sigma)
+std::vector<float> gaussianKernel(float sigma) {
     int kernel_size = static_cast<int>(std::ceil(2.0f * sigma) * 2 + 1);
     std::vector<float> kernel(kernel_size);
     int center = kernel_size / 2;
@@ -24,215 +34,615 @@ void ImageFilters::gaussianBlur(ImageData& image, float sigma) {
         val /= sum;
     }
     
-    // Apply horizontal blur
-    ImageData temp(image.width, image.height, image.channels);
-    int half_kernel = kernel_size / 2;
-    
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            for (int c = 0; c < image.channels; ++c) {
-                float sum = 0.0f;
-                
-                for (int kx = 0; kx < kernel_size; ++kx) {
-                    int px = x + kx - half_kernel;
-                    if (px >= 0 && px < image.width) {
-                        sum += image(px, y, c) * kernel[kx];
+    return kernel;
+}
+
+// Box widths (odd) whose n-fold convolution has variance closest to sigma^2
+std::vector<int> stackedBoxRadii(float sigma, int passes) {
+    float ideal = std::sqrt(12.0f * sigma * sigma / passes + 1.0f);
+    int lower = static_cast<int>(std::floor(ideal));
+    if (lower % 2 == 0) --lower;
+    int upper = lower + 2;
+
+    float m_ideal = (12.0f * sigma * sigma - passes * lower * lower - 4.0f * passes * lower - 3.0f * passes) /
+                    (-4.0f * lower - 4.0f);
+    int m = static_cast<int>(std::round(m_ideal));
+
+    std::vector<int> radii(passes);
+    for (int i = 0; i < passes; ++i) {
+        radii[i] = ((i < m) ? lower : upper) / 2;
+    }
+    return radii;
+}
+
+// Running-sum box filter along x; samples outside the image count as zero.
+// Interleaved rows are walked once with one sum per channel.
+template <class Shape>
+void boxBlurRows(const ImageData& src, ImageData& dst, int radius) {
+    auto in = Shape::view(src);
+    auto out = Shape::view(dst);
+    int width = src.width;
+    double scale = 1.0 / (2 * radius + 1);
+
+    parallelFor(0, src.height, [&](int y_begin, int y_end) {
+        const size_t xs = in.pixelStride();
+        std::vector<double> sums(xs);
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int p = 0; p < in.planes(); ++p) {
+                const float* row = in.row(y, p);
+                float* dst_row = out.row(y, p);
+
+                std::fill(sums.begin(), sums.end(), 0.0);
+                for (int x = 0; x < std::min(radius, width - 1) + 1; ++x) {
+                    for (size_t c = 0; c < xs; ++c) sums[c] += row[x * xs + c];
+                }
+                for (int x = 0; x < width; ++x) {
+                    int enter = x + radius + 1;
+                    int leave = x - radius;
+                    for (size_t c = 0; c < xs; ++c) {
+                        dst_row[x * xs + c] = static_cast<float>(sums[c] * scale);
+                        if (enter < width) sums[c] += row[enter * xs + c];
+                        if (leave >= 0) sums[c] -= row[leave * xs + c];
                     }
                 }
-                
-                temp(x, y, c) = sum;
             }
         }
-    }
-    
-    // Apply vertical blur
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            for (int c = 0; c < image.channels; ++c) {
-                float sum = 0.0f;
-                
-                for (int ky = 0; ky < kernel_size; ++ky) {
-                    int py = y + ky - half_kernel;
-                    if (py >= 0 && py < image.height) {
-                        sum += temp(x, py, c) * kernel[ky];
-                    }
+    });
+}
+
+// Running-sum box filter along y, one accumulator per sample of a strip of
+// columns so rows stay sequential in memory
+template <class Shape>
+void boxBlurColumns(const ImageData& src, ImageData& dst, int radius) {
+    auto in = Shape::view(src);
+    auto out = Shape::view(dst);
+    int height = src.height;
+    double scale = 1.0 / (2 * radius + 1);
+
+    parallelFor(0, src.width, [&](int x_begin, int x_end) {
+        const size_t xs = in.pixelStride();
+        const size_t span = static_cast<size_t>(x_end - x_begin) * xs;
+        std::vector<double> sums(span * in.planes(), 0.0);
+
+        auto accumulate = [&](int y, double sign) {
+            for (int p = 0; p < in.planes(); ++p) {
+                const float* row = in.row(y, p) + x_begin * xs;
+                double* acc = &sums[p * span];
+                for (size_t i = 0; i < span; ++i) {
+                    acc[i] += sign * row[i];
+                }
+            }
+        };
+
+        for (int y = 0; y < std::min(radius, height - 1) + 1; ++y) {
+            accumulate(y, 1.0);
+        }
+        for (int y = 0; y < height; ++y) {
+            for (int p = 0; p < in.planes(); ++p) {
+                const double* acc = &sums[p * span];
+                float* row = out.row(y, p) + x_begin * xs;
+                for (size_t i = 0; i < span; ++i) {
+                    row[i] = static_cast<float>(acc[i] * scale);
                 }
-                
-                image(x, y, c) = sum;
             }
+            if (y + radius + 1 < height) accumulate(y + radius + 1, 1.0);
+            if (y - radius >= 0) accumulate(y - radius, -1.0);
         }
+    }, 16);
+}
+
+
+using simd::VecF;
+
+// 3x3 edge operators over the neighbourhood of one sample, constant-folded.
+// Written against the simd helpers so vectors and the scalar tail share code.
+struct SobelOp {
+    template <class V> static V apply(V tl, V t, V tr, V l, V, V r, V bl, V b, V br) {
+        V gx = (tr - tl) + V(2.0f) * (r - l) + (br - bl);
+        V gy = (bl + V(2.0f) * b + br) - (tl + V(2.0f) * t + tr);
+        return simd::min(simd::sqrt(gx * gx + gy * gy), V(1.0f));
+    }
+};
+
+struct LaplacianOp {
+    template <class V> static V apply(V, V t, V, V l, V c, V r, V, V b, V) {
+        return simd::abs(V(4.0f) * c - t - l - r - b);
+    }
+};
+
+// Rows of luma are padded with a zero sample either side, so pixel x sits at
+// [x + 1] and the taps at x - 1 and x + 1 need no bounds checks
+template <class Op>
+void edgeRun(const float* above, const float* row, const float* below, float* out, int width) {
+    int x = 0;
+    for (; x + VecF::width <= width; x += VecF::width) {
+        Op::apply(VecF::load(above + x), VecF::load(above + x + 1), VecF::load(above + x + 2),
+                  VecF::load(row + x), VecF::load(row + x + 1), VecF::load(row + x + 2),
+                  VecF::load(below + x), VecF::load(below + x + 1), VecF::load(below + x + 2)).store(out + x);
+    }
+    for (; x < width; ++x) {
+        out[x] = Op::apply(above[x], above[x + 1], above[x + 2],
+                           row[x], row[x + 1], row[x + 2],
+                           below[x], below[x + 1], below[x + 2]);
     }
 }
 
-void ImageFilters::sharpen(ImageData& image, float strength) {
-    if (strength <= 0.0f) return;
-    
-    // Create sharpening kernel
-    std::vector<std::vector<float>> kernel = {
-        {0, -strength, 0},
-        {-strength, 1 + 4 * strength, -strength},
-        {0, -strength, 0}
-    };
-    
-    ImageData temp = image;
-    int kernel_size = 3;
-    int half_kernel = kernel_size / 2;
-    
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            for (int c = 0; c < image.channels; ++c) {
-                float sum = 0.0f;
-                
-                for (int ky = 0; ky < kernel_size; ++ky) {
-                    for (int kx = 0; kx < kernel_size; ++kx) {
-                        int px = x + kx - half_kernel;
-                        int py = y + ky - half_kernel;
-                        
-                        if (px >= 0 && px < image.width && py >= 0 && py < image.height) {
-                            sum += temp(px, py, c) * kernel[ky][kx];
+// Rec. 601 luma of row y into out[1..width]; single- and two-channel images use channel 0
+void lumaRow(const ImageData& image, int y, float* out) {
+    int width = image.width;
+    out[0] = 0.0f;
+    out[width + 1] = 0.0f;
+    float* dst = out + 1;
+
+    if (image.channels < 3) {
+        const float* src = &image.data[image.index(0, y, 0)];
+        size_t ps = image.pixelStride();
+        for (int x = 0; x < width; ++x) {
+            dst[x] = src[x * ps];
+        }
+        return;
+    }
+
+    const float* r = &image.data[image.index(0, y, 0)];
+    const float* g = &image.data[image.index(0, y, 1)];
+    const float* b = &image.data[image.index(0, y, 2)];
+    if (image.layout == PixelLayout::PLANAR) {
+        const VecF wr(0.299f), wg(0.587f), wb(0.114f);
+        int x = 0;
+        for (; x + VecF::width <= width; x += VecF::width) {
+            (wr * VecF::load(r + x) + wg * VecF::load(g + x) + wb * VecF::load(b + x)).store(dst + x);
+        }
+        for (; x < width; ++x) {
+            dst[x] = 0.299f * r[x] + 0.587f * g[x] + 0.114f * b[x];
+        }
+        return;
+    }
+
+    size_t ps = image.pixelStride();
+    for (int x = 0; x < width; ++x) {
+        size_t i = x * ps;
+        dst[x] = 0.299f * r[i] + 0.587f * g[i] + 0.114f * b[i];
+    }
+}
+
+// Where edgeFilter writes: `channels` copies of each result, sample (x, y, c)
+// at base + (y * width + x) * pixel_stride + c * channel_stride
+struct EdgeOutput {
+    float* base;
+    size_t pixel_stride;
+    size_t channel_stride;
+    int channels;
+};
+
+// Luma, the 3x3 operator and the write-out fused into one pass over the
+// image. Each band of rows keeps three rolling luma rows; the output may
+// alias the input, because a band only overwrites row y once rows y - 1 to
+// y + 1 are in its window, and the rows bordering other bands are read
+// before any band starts writing.
+template <class Op>
+void edgeFilter(const ImageData& image, const EdgeOutput& output) {
+    int width = image.width;
+    int height = image.height;
+    if (width <= 0 || height <= 0) return;
+
+    size_t padded = static_cast<size_t>(width) + 2;
+    int bands = std::max(1, std::min(height / 4, ThreadPool::global().threadCount() * 4));
+    auto band_begin = [&](int band) { return static_cast<int>(static_cast<long long>(height) * band / bands); };
+
+    // Row above and row below each band, zero past the image edges
+    std::vector<float> borders(static_cast<size_t>(bands) * 2 * padded, 0.0f);
+    parallelFor(0, bands, [&](int b_begin, int b_end) {
+        for (int band = b_begin; band < b_end; ++band) {
+            int above = band_begin(band) - 1;
+            int below = band_begin(band + 1);
+            if (above >= 0) lumaRow(image, above, &borders[(band * 2) * padded]);
+            if (below < height) lumaRow(image, below, &borders[(band * 2 + 1) * padded]);
+        }
+    });
+
+    parallelFor(0, bands, [&](int b_begin, int b_end) {
+        std::vector<float> window(4 * padded);
+        for (int band = b_begin; band < b_end; ++band) {
+            int y_begin = band_begin(band);
+            int y_end = band_begin(band + 1);
+            const float* top = &borders[(band * 2) * padded];
+            const float* bottom = &borders[(band * 2 + 1) * padded];
+            float* above = &window[0];
+            float* row = &window[padded];
+            float* below = &window[2 * padded];
+            float* edges = &window[3 * padded];
+
+            std::memcpy(above, top, padded * sizeof(float));
+            lumaRow(image, y_begin, row);
+            if (y_begin + 1 < y_end) {
+                lumaRow(image, y_begin + 1, below);
+            } else {
+                std::memcpy(below, bottom, padded * sizeof(float));
+            }
+
+            for (int y = y_begin; y < y_end; ++y) {
+                edgeRun<Op>(above, row, below, edges, width);
+
+                float* dst = output.base + static_cast<size_t>(y) * width * output.pixel_stride;
+                if (output.pixel_stride == 1) {
+                    for (int c = 0; c < output.channels; ++c) {
+                        std::memcpy(dst + c * output.channel_stride, edges, width * sizeof(float));
+                    }
+                } else {
+                    for (int x = 0; x < width; ++x, dst += output.pixel_stride) {
+                        for (int c = 0; c < output.channels; ++c) {
+                            dst[c * output.channel_stride] = edges[x];
                         }
                     }
                 }
-                
-                image(x, y, c) = std::max(0.0f, std::min(1.0f, sum));
+
+                // Slide the window down; row y + 2 has not been written yet
+                if (y + 1 >= y_end) break;
+                float* next = above;
+                if (y + 2 < y_end) {
+                    lumaRow(image, y + 2, next);
+                } else {
+                    std::memcpy(next, bottom, padded * sizeof(float));
+                }
+                above = row;
+                row = below;
+                below = next;
             }
         }
-    }
+    });
 }
 
-void ImageFilters::sobelEdgeDetection(ImageData& image) {
-    if (image.channels < 3) return;
-    
-    // Convert to grayscale first
-    ImageData grayscale(image.width, image.height, 1);
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            float gray = 0.299f * image(x, y, 0) + 0.587f * image(x, y, 1) + 0.114f * image(x, y, 2);
-            grayscale(x, y, 0) = gray;
-        }
-    }
-    
-    // Sobel kernels
-    std::vector<std::vector<int>> sobel_x = {
-        {-1, 0, 1},
-        {-2, 0, 2},
-        {-1, 0, 1}
-    };
-    
-    std::vector<std::vector<int>> sobel_y = {
-        {-1, -2, -1},
-        {0, 0, 0},
-        {1, 2, 1}
-    };
-    
-    ImageData edges(image.width, image.height, 1);
-    int kernel_size = 3;
-    int half_kernel = kernel_size / 2;
-    
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            float gx = 0.0f, gy = 0.0f;
-            
-            for (int ky = 0; ky < kernel_size; ++ky) {
-                for (int kx = 0; kx < kernel_size; ++kx) {
-                    int px = x + kx - half_kernel;
-                    int py = y + ky - half_kernel;
-                    
-                    if (px >= 0 && px < image.width && py >= 0 && py < image.height) {
-                        float pixel = grayscale(px, py, 0);
-                        gx += pixel * sobel_x[ky][kx];
-                        gy += pixel * sobel_y[ky][kx];
+// Horizontal pass of separableConvolve. Pixels whose taps all land inside
+// the row are summed a vector of samples at a time: the taps of interleaved
+// channels sit a whole pixel stride apart, which the shape makes a constant.
+template <class Shape>
+void convolveRows(const ImageData& src, ImageData& dst, const std::vector<float>& kernel) {
+    auto in = Shape::view(src);
+    auto out = Shape::view(dst);
+    int width = src.width;
+    int taps = static_cast<int>(kernel.size());
+    int half = taps / 2;
+    int inner_begin = std::min(half, width);
+    int inner_end = std::max(inner_begin, width - half);
+
+    parallelFor(0, src.height, [&](int y_begin, int y_end) {
+        const size_t xs = in.pixelStride();
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int p = 0; p < in.planes(); ++p) {
+                const float* row = in.row(y, p);
+                float* dst_row = out.row(y, p);
+
+                size_t i = inner_begin * xs;
+                size_t i_end = inner_end * xs;
+                for (; i + VecF::width <= i_end; i += VecF::width) {
+                    const float* window = row + i - half * xs;
+                    VecF sum(0.0f);
+                    for (int k = 0; k < taps; ++k) {
+                        sum = sum + VecF::load(window + k * xs) * VecF(kernel[k]);
                     }
+                    sum.store(dst_row + i);
                 }
+                for (; i < i_end; ++i) {
+                    const float* window = row + i - half * xs;
+                    float sum = 0.0f;
+                    for (int k = 0; k < taps; ++k) {
+                        sum += window[k * xs] * kernel[k];
+                    }
+                    dst_row[i] = sum;
+                }
+
+                // Pixels near the ends skip the taps that fall outside
+                auto edge = [&](int x) {
+                    for (size_t c = 0; c < xs; ++c) {
+                        float sum = 0.0f;
+                        for (int k = 0; k < taps; ++k) {
+                            int px = x + k - half;
+                            if (px >= 0 && px < width) {
+                                sum += row[px * xs + c] * kernel[k];
+                            }
+                        }
+                        dst_row[x * xs + c] = sum;
+                    }
+                };
+                for (int x = 0; x < inner_begin; ++x) edge(x);
+                for (int x = inner_end; x < width; ++x) edge(x);
             }
-            
-            float magnitude = std::sqrt(gx * gx + gy * gy);
-            edges(x, y, 0) = std::min(1.0f, magnitude);
         }
-    }
-    
-    // Copy edges to all channels
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            float edge_val = edges(x, y, 0);
-            for (int c = 0; c < image.channels; ++c) {
-                image(x, y, c) = edge_val;
+    });
+}
+
+// Vertical pass of separableConvolve: each output row is a weighted sum of
+// whole input rows, so it is one contiguous run per plane
+template <class Shape>
+void convolveColumns(const ImageData& src, ImageData& dst, const std::vector<float>& kernel) {
+    auto in = Shape::view(src);
+    auto out = Shape::view(dst);
+    int height = src.height;
+    int taps = static_cast<int>(kernel.size());
+    int half = taps / 2;
+    const size_t count = in.rowSamples();
+
+    parallelFor(0, height, [&](int y_begin, int y_end) {
+        std::vector<const float*> rows(taps);
+        std::vector<float> weights(taps);
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int p = 0; p < in.planes(); ++p) {
+                // Rows past the top and bottom edges are skipped
+                int used = 0;
+                for (int k = 0; k < taps; ++k) {
+                    int py = y + k - half;
+                    if (py >= 0 && py < height) {
+                        rows[used] = in.row(py, p);
+                        weights[used] = kernel[k];
+                        ++used;
+                    }
+                }
+
+                float* dst_row = out.row(y, p);
+                size_t i = 0;
+                for (; i + VecF::width <= count; i += VecF::width) {
+                    VecF sum(0.0f);
+                    for (int k = 0; k < used; ++k) {
+                        sum = sum + VecF::load(rows[k] + i) * VecF(weights[k]);
+                    }
+                    sum.store(dst_row + i);
+                }
+                for (; i < count; ++i) {
+                    float sum = 0.0f;
+                    for (int k = 0; k < used; ++k) {
+                        sum += rows[k][i] * weights[k];
+                    }
+                    dst_row[i] = sum;
+                }
             }
         }
-    }
+    });
 }
 
-void ImageFilters::laplacianEdgeDetection(ImageData& image) {
-    if (image.channels < 3) return;
-    
-    // Convert to grayscale first
-    ImageData grayscale(image.width, image.height, 1);
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            float gray = 0.299f * image(x, y, 0) + 0.587f * image(x, y, 1) + 0.114f * image(x, y, 2);
-            grayscale(x, y, 0) = gray;
+// Cross-shaped sharpen of one sample from its four neighbours, constant-folded
+// from the 3x3 kernel; missing neighbours are passed as zero
+template <class V>
+V sharpenSample(V up, V left, V centre, V right, V down, V side, V middle) {
+    return simd::clamp01(up * side + left * side + centre * middle + right * side + down * side);
+}
+
+template <class Shape>
+void sharpenRows(const ImageData& src, ImageData& dst, float strength) {
+    auto in = Shape::view(src);
+    auto out = Shape::view(dst);
+    int width = src.width;
+    int height = src.height;
+    const size_t count = in.rowSamples();
+    std::vector<float> zero_row(count, 0.0f);
+
+    parallelFor(0, height, [&](int y_begin, int y_end) {
+        const size_t xs = in.pixelStride();
+        const float side = -strength;
+        const float middle = 1.0f + 4.0f * strength;
+        const VecF side_v(side), middle_v(middle);
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int p = 0; p < in.planes(); ++p) {
+                const float* up = (y > 0) ? in.row(y - 1, p) : zero_row.data();
+                const float* row = in.row(y, p);
+                const float* down = (y + 1 < height) ? in.row(y + 1, p) : zero_row.data();
+                float* dst_row = out.row(y, p);
+
+                // The first and last pixel have no left or right neighbour
+                auto edge = [&](int x) {
+                    for (size_t c = 0; c < xs; ++c) {
+                        size_t i = x * xs + c;
+                        float left = (x > 0) ? row[i - xs] : 0.0f;
+                        float right = (x + 1 < width) ? row[i + xs] : 0.0f;
+                        dst_row[i] = sharpenSample(up[i], left, row[i], right, down[i], side, middle);
+                    }
+                };
+                edge(0);
+                if (width < 2) continue;
+
+                size_t i = xs;
+                size_t i_end = (width - 1) * xs;
+                for (; i + VecF::width <= i_end; i += VecF::width) {
+                    sharpenSample(VecF::load(up + i), VecF::load(row + i - xs), VecF::load(row + i),
+                                  VecF::load(row + i + xs), VecF::load(down + i), side_v, middle_v)
+                        .store(dst_row + i);
+                }
+                for (; i < i_end; ++i) {
+                    dst_row[i] = sharpenSample(up[i], row[i - xs], row[i], row[i + xs], down[i], side, middle);
+                }
+                edge(width - 1);
+            }
         }
-    }
-    
-    // Laplacian kernel
-    std::vector<std::vector<int>> laplacian = {
-        {0, -1, 0},
-        {-1, 4, -1},
-        {0, -1, 0}
-    };
-    
-    ImageData edges(image.width, image.height, 1);
-    int kernel_size = 3;
-    int half_kernel = kernel_size / 2;
-    
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            float sum = 0.0f;
-            
-            for (int ky = 0; ky < kernel_size; ++ky) {
-                for (int kx = 0; kx < kernel_size; ++kx) {
-                    int px = x + kx - half_kernel;
-                    int py = y + ky - half_kernel;
-                    
-                    if (px >= 0 && px < image.width && py >= 0 && py < image.height) {
-                        sum += grayscale(px, py, 0) * laplacian[ky][kx];
+    });
+}
+
+// original + amount * (original - blurred), clamped, where the difference
+// reaches the threshold. Both images have the shape, so every plane row is
+// one contiguous run of samples.
+template <class Shape>
+void unsharpRows(ImageData& image, const ImageData& blurred, float amount, float threshold) {
+    auto view = Shape::view(image);
+    auto soft = Shape::view(blurred);
+    const size_t count = view.rowSamples();
+
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        const VecF amount_v(amount), threshold_v(threshold);
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int p = 0; p < view.planes(); ++p) {
+                float* row = view.row(y, p);
+                const float* blurred_row = soft.row(y, p);
+                size_t i = 0;
+                for (; i + VecF::width <= count; i += VecF::width) {
+                    VecF original = VecF::load(row + i);
+                    VecF difference = original - VecF::load(blurred_row + i);
+                    VecF sharpened = simd::clamp01(original + amount_v * difference);
+                    simd::select(simd::le(threshold_v, simd::abs(difference)), sharpened, original).store(row + i);
+                }
+                for (; i < count; ++i) {
+                    float original = row[i];
+                    float difference = original - blurred_row[i];
+                    if (std::abs(difference) >= threshold) {
+                        row[i] = simd::clamp01(original + amount * difference);
                     }
                 }
             }
-            
-            edges(x, y, 0) = std::abs(sum);
         }
+    });
+}
+
+} // namespace
+
+void ImageFilters::gaussianBlur(ImageData& image, float sigma) {
+    if (sigma <= 0.0f) return;
+    ProfileScope scope("filter.gaussian_blur", image);
+
+    if (sigma >= kStackedBoxSigma) {
+        stackedBoxBlur(image, sigma, kStackedBoxPasses);
+        return;
     }
     
-    // Copy edges to all channels
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            float edge_val = edges(x, y, 0);
-            for (int c = 0; c < image.channels; ++c) {
-                image(x, y, c) = edge_val;
-            }
-        }
+    separableConvolve(image, gaussianKernel(sigma));
+}
+
+void ImageFilters::separableConvolve(ImageData& image, const std::vector<float>& kernel) {
+    if (kernel.empty()) return;
+
+    // Rows into temp, then columns back; every sample of temp is written before it is read
+    ImageData temp;
+    temp.reshape(image.width, image.height, image.channels, image.layout);
+    dispatchShape(image, [&](auto shape) {
+        typedef decltype(shape) Shape;
+        convolveRows<Shape>(image, temp, kernel);
+        convolveColumns<Shape>(temp, image, kernel);
+    });
+}
+
+void ImageFilters::stackedBoxBlur(ImageData& image, float sigma, int passes) {
+    if (sigma <= 0.0f || passes <= 0) return;
+
+    // Each pass is O(1) per sample whatever the radius: rows into temp, columns back
+    ImageData temp;
+    temp.reshape(image.width, image.height, image.channels, image.layout);
+    for (int radius : stackedBoxRadii(sigma, passes)) {
+        if (radius <= 0) continue;
+        dispatchShape(image, [&](auto shape) {
+            typedef decltype(shape) Shape;
+            boxBlurRows<Shape>(image, temp, radius);
+            boxBlurColumns<Shape>(temp, image, radius);
+        });
     }
 }
 
+std::vector<std::vector<float>> ImageFilters::gaussianBlurKernels(float sigma) {
+    std::vector<std::vector<float>> kernels;
+    if (sigma <= 0.0f) return kernels;
+    if (sigma < kStackedBoxSigma) {
+        kernels.push_back(gaussianKernel(sigma));
+        return kernels;
+    }
+
+    for (int radius : stackedBoxRadii(sigma, kStackedBoxPasses)) {
+        if (radius <= 0) continue;
+        kernels.push_back(std::vector<float>(2 * radius + 1, 1.0f / (2 * radius + 1)));
+    }
+    return kernels;
+}
+
+int ImageFilters::gaussianBlurRadius(float sigma) {
+    if (sigma <= 0.0f) return 0;
+    if (sigma < kStackedBoxSigma) {
+        return static_cast<int>(std::ceil(2.0f * sigma));
+    }
+
+    // The stacked boxes reach as far as the sum of their radii
+    int radius = 0;
+    for (int r : stackedBoxRadii(sigma, kStackedBoxPasses)) {
+        radius += r;
+    }
+    return radius;
+}
+
+void ImageFilters::sharpen(ImageData& image, float strength) {
+    ProfileScope scope("filter.sharpen", image);
+    if (strength <= 0.0f) return;
+    
+    ImageData temp = image;
+    dispatchShape(image, [&](auto shape) {
+        sharpenRows<decltype(shape)>(temp, image, strength);
+    });
+}
+
+void ImageFilters::sobelEdgeDetection(ImageData& image) {
+    if (image.channels < 1) return;
+    ProfileScope scope("filter.sobel", image);
+    
+    // The magnitude replaces every channel, alpha included
+    edgeFilter<SobelOp>(image, {image.data.data(), image.pixelStride(), image.channelStride(), image.channels});
+}
+
+void ImageFilters::laplacianEdgeDetection(ImageData& image) {
+    if (image.channels < 1) return;
+    ProfileScope scope("filter.laplacian", image);
+    
+    edgeFilter<LaplacianOp>(image, {image.data.data(), image.pixelStride(), image.channelStride(), image.channels});
+}
+
+void ImageFilters::sobelEdgeMask(const ImageData& image, ImageData& mask) {
+    ProfileScope scope("filter.sobel_mask", image);
+    mask.reshape(image.width, image.height, 1, PixelLayout::INTERLEAVED);
+    mask.setWindowsFrom(image);
+    if (image.channels < 1) return;
+    
+    edgeFilter<SobelOp>(image, {mask.data.data(), 1, 0, 1});
+}
+
+void ImageFilters::laplacianEdgeMask(const ImageData& image, ImageData& mask) {
+    ProfileScope scope("filter.laplacian_mask", image);
+    mask.reshape(image.width, image.height, 1, PixelLayout::INTERLEAVED);
+    mask.setWindowsFrom(image);
+    if (image.channels < 1) return;
+    
+    edgeFilter<LaplacianOp>(image, {mask.data.data(), 1, 0, 1});
+}
+
 void ImageFilters::unsharpMask(ImageData& image, float radius, float amount, float threshold) {
+    ProfileScope scope("filter.unsharp_mask", image);
     ImageData blurred = image;
     gaussianBlur(blurred, radius);
     
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            for (int c = 0; c < image.channels; ++c) {
-                float original = image(x, y, c);
-                float blurred_val = blurred(x, y, c);
-                float difference = original - blurred_val;
-                
-                if (std::abs(difference) >= threshold) {
-                    image(x, y, c) = original + amount * difference;
-                    image(x, y, c) = std::max(0.0f, std::min(1.0f, image(x, y, c)));
-                }
-            }
-        }
-    }
+    dispatchShape(image, [&](auto shape) {
+        unsharpRows<decltype(shape)>(image, blurred, amount, threshold);
+    });
+}
+
+void ImageFilters::gaussianBlur(ImageData& image, float sigma, const Imath::Box2i& roi) {
+    processRegion(image, roi, gaussianBlurRadius(sigma), [sigma](ImageData& region) {
+        gaussianBlur(region, sigma);
+    });
+}
+
+void ImageFilters::sharpen(ImageData& image, float strength, const Imath::Box2i& roi) {
+    processRegion(image, roi, 1, [strength](ImageData& region) {
+        sharpen(region, strength);
+    });
+}
+
+void ImageFilters::sobelEdgeDetection(ImageData& image, const Imath::Box2i& roi) {
+    processRegion(image, roi, 1, [](ImageData& region) {
+        sobelEdgeDetection(region);
+    });
+}
+
+void ImageFilters::laplacianEdgeDetection(ImageData& image, const Imath::Box2i& roi) {
+    processRegion(image, roi, 1, [](ImageData& region) {
+        laplacianEdgeDetection(region);
+    });
+}
+
+void ImageFilters::unsharpMask(ImageData& image, float radius, float amount, float threshold,
+                               const Imath::Box2i& roi) {
+    processRegion(image, roi, gaussianBlurRadius(radius), [=](ImageData& region) {
+        unsharpMask(region, radius, amount, threshold);
+    });
 }
 
 } // namespace ImageProcessing
\ No newline at end of file
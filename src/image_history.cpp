@@ -0,0 +1,244 @@
+#include "image_history.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+namespace ImageProcessing {
+
+namespace {
+
+// Calls fn(image_offset, tile_offset, count) for each contiguous run of samples
+// of the tile whose top-left pixel is (x0, y0)
+template <typename Fn>
+void forEachRun(const ImageData& image, int x0, int y0, int tw, int th, Fn fn) {
+    size_t tile_offset = 0;
+    if (image.layout == PixelLayout::PLANAR) {
+        for (int c = 0; c < image.channels; ++c) {
+            for (int y = y0; y < y0 + th; ++y) {
+                fn(image.index(x0, y, c), tile_offset, static_cast<size_t>(tw));
+                tile_offset += tw;
+            }
+        }
+    } else {
+        size_t count = static_cast<size_t>(tw) * image.channels;
+        for (int y = y0; y < y0 + th; ++y) {
+            fn(image.index(x0, y, 0), tile_offset, count);
+            tile_offset += count;
+        }
+    }
+}
+
+} // namespace
+
+TiledImage::TiledImage()
+    : tile_size_(kDefaultTileSize), tiles_x_(0), tiles_y_(0), shared_tiles_(0) {}
+
+void TiledImage::assign(const ImageData& image, const TiledImage* reference, int tile_size) {
+    ProfileScope scope("history.tile", image);
+
+    tile_size = std::max(8, tile_size);
+    int tiles_x = (image.width + tile_size - 1) / tile_size;
+    int tiles_y = (image.height + tile_size - 1) / tile_size;
+    bool comparable = reference && reference != this && !reference->empty()
+                   && reference->header_.hasShape(image.width, image.height, image.channels, image.layout)
+                   && reference->tile_size_ == tile_size;
+
+    std::vector<TilePtr> tiles(static_cast<size_t>(tiles_x) * tiles_y);
+    std::vector<char> shared(tiles.size(), 0);
+    parallelFor(0, tiles_y, [&](int ty_begin, int ty_end) {
+        for (int ty = ty_begin; ty < ty_end; ++ty) {
+            for (int tx = 0; tx < tiles_x; ++tx) {
+                size_t t = static_cast<size_t>(ty) * tiles_x + tx;
+                int x0 = tx * tile_size;
+                int y0 = ty * tile_size;
+                int tw = std::min(tile_size, image.width - x0);
+                int th = std::min(tile_size, image.height - y0);
+                const float* samples = image.data.data();
+
+                // Unchanged tiles are compared run by run and taken over as they are
+                if (comparable) {
+                    const Tile& old = *reference->tiles_[t];
+                    bool same = true;
+                    forEachRun(image, x0, y0, tw, th, [&](size_t offset, size_t tile_offset, size_t count) {
+                        same = same && std::memcmp(samples + offset, old.data() + tile_offset,
+                                                   count * sizeof(float)) == 0;
+                    });
+                    if (same) {
+                        tiles[t] = reference->tiles_[t];
+                        shared[t] = 1;
+                        continue;
+                    }
+                }
+
+                std::shared_ptr<Tile> tile = std::make_shared<Tile>(static_cast<size_t>(tw) * th * image.channels);
+                forEachRun(image, x0, y0, tw, th, [&](size_t offset, size_t tile_offset, size_t count) {
+                    std::memcpy(tile->data() + tile_offset, samples + offset, count * sizeof(float));
+                });
+                tiles[t] = std::move(tile);
+            }
+        }
+    });
+
+    header_ = ImageData();
+    header_.width = image.width;
+    header_.height = image.height;
+    header_.channels = image.channels;
+    header_.layout = image.layout;
+    header_.setWindowsFrom(image);
+    tile_size_ = tile_size;
+    tiles_x_ = tiles_x;
+    tiles_y_ = tiles_y;
+    tiles_ = std::move(tiles);
+    shared_tiles_ = static_cast<size_t>(std::count(shared.begin(), shared.end(), 1));
+    for (size_t t = 0; t < tiles_.size(); ++t) {
+        if (!shared[t]) scope.addWritten(tiles_[t]->size() * sizeof(float));
+    }
+}
+
+void TiledImage::toImage(ImageData& image) const {
+    ProfileScope scope("history.untile");
+
+    image.reshape(header_.width, header_.height, header_.channels, header_.layout);
+    image.setWindowsFrom(header_);
+    parallelFor(0, tiles_y_, [&](int ty_begin, int ty_end) {
+        for (int ty = ty_begin; ty < ty_end; ++ty) {
+            for (int tx = 0; tx < tiles_x_; ++tx) {
+                const Tile& tile = *tiles_[static_cast<size_t>(ty) * tiles_x_ + tx];
+                int x0 = tx * tile_size_;
+                int y0 = ty * tile_size_;
+                int tw = std::min(tile_size_, header_.width - x0);
+                int th = std::min(tile_size_, header_.height - y0);
+                forEachRun(image, x0, y0, tw, th, [&](size_t offset, size_t tile_offset, size_t count) {
+                    std::memcpy(image.data.data() + offset, tile.data() + tile_offset, count * sizeof(float));
+                });
+            }
+        }
+    });
+    scope.addImageWritten(image);
+}
+
+void TiledImage::clear() {
+    header_ = ImageData();
+    tiles_x_ = 0;
+    tiles_y_ = 0;
+    tiles_.clear();
+    shared_tiles_ = 0;
+}
+
+size_t TiledImage::bytes() const {
+    size_t total = 0;
+    for (const TilePtr& tile : tiles_) {
+        total += tile->size() * sizeof(float);
+    }
+    return total;
+}
+
+ImageHistory::ImageHistory(size_t budget_bytes)
+    : epoch_(0), budget_bytes_(budget_bytes), bytes_used_(0), newest_steps_(0) {}
+
+uint64_t ImageHistory::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    states_.clear();
+    bytes_used_ = 0;
+    return ++epoch_;
+}
+
+uint64_t ImageHistory::truncate(size_t steps) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    states_.erase(states_.upper_bound(steps), states_.end());
+    bytes_used_ = uniqueBytes();
+    return ++epoch_;
+}
+
+uint64_t ImageHistory::epoch() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return epoch_;
+}
+
+void ImageHistory::store(uint64_t epoch, size_t steps, const ImageData& image) {
+    if (image.data.empty()) return;
+
+    // The nearest state below is the likeliest to share tiles; copy its handles
+    // so the tiling runs outside the lock
+    TiledImage reference;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (epoch != epoch_) return;
+        auto below = states_.lower_bound(steps);
+        if (below != states_.begin()) {
+            reference = std::prev(below)->second;
+        }
+    }
+
+    TiledImage state;
+    state.assign(image, &reference);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (epoch != epoch_) return;
+    states_[steps] = std::move(state);
+    newest_steps_ = steps;
+    bytes_used_ = uniqueBytes();
+    enforceBudget();
+}
+
+bool ImageHistory::restore(size_t max_steps, size_t& steps, ImageData& image) const {
+    TiledImage state;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto above = states_.upper_bound(max_steps);
+        if (above == states_.begin()) return false;
+        steps = std::prev(above)->first;
+        state = std::prev(above)->second;
+    }
+    state.toImage(image);
+    return true;
+}
+
+void ImageHistory::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_bytes_ = bytes;
+    enforceBudget();
+}
+
+size_t ImageHistory::budget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_bytes_;
+}
+
+size_t ImageHistory::bytesUsed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_used_;
+}
+
+size_t ImageHistory::stateCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return states_.size();
+}
+
+size_t ImageHistory::uniqueBytes() const {
+    std::unordered_set<const TiledImage::Tile*> seen;
+    size_t total = 0;
+    for (const auto& state : states_) {
+        for (const TiledImage::TilePtr& tile : state.second.tiles()) {
+            if (seen.insert(tile.get()).second) {
+                total += tile->size() * sizeof(float);
+            }
+        }
+    }
+    return total;
+}
+
+void ImageHistory::enforceBudget() {
+    // Fewest edits first, passing over the state stored last: after an undo
+    // and a new edit that is not the deepest one
+    while (bytes_used_ > budget_bytes_ && states_.size() > 1) {
+        auto victim = states_.begin();
+        if (victim->first == newest_steps_) ++victim;
+        states_.erase(victim);
+        bytes_used_ = uniqueBytes();
+    }
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,114 @@
+#include "image_pyramid.h"
+#include "thread_pool.h"
+#include "simd.h"
+#include <algorithm>
+
+namespace ImageProcessing {
+
+namespace {
+
+using simd::VecF;
+
+// Sums two rows with vector adds, then folds horizontal pixel pairs.
+// `stride` is the distance between pixels: the channel count when interleaved, 1 per plane.
+void downsampleRow(const float* row0, const float* row1, float* out, int in_width, int out_width,
+                   int stride, std::vector<float>& sums) {
+    size_t count = static_cast<size_t>(in_width) * stride;
+    size_t i = 0;
+    for (; i + VecF::width <= count; i += VecF::width) {
+        (VecF::load(row0 + i) + VecF::load(row1 + i)).store(sums.data() + i);
+    }
+    for (; i < count; ++i) {
+        sums[i] = row0[i] + row1[i];
+    }
+
+    for (int x = 0; x < out_width; ++x) {
+        const float* left = sums.data() + static_cast<size_t>(2 * x) * stride;
+        const float* right = sums.data() + static_cast<size_t>(std::min(2 * x + 1, in_width - 1)) * stride;
+        float* dst = out + static_cast<size_t>(x) * stride;
+        for (int c = 0; c < stride; ++c) {
+            dst[c] = 0.25f * (left[c] + right[c]);
+        }
+    }
+}
+
+// Floor division, so windows left of or above the origin stay on the pixel grid
+int halveCoordinate(int v, int levels) {
+    for (int i = 0; i < levels; ++i) {
+        v = (v >= 0) ? v / 2 : (v - 1) / 2;
+    }
+    return v;
+}
+
+} // namespace
+
+void ImagePyramid::build(const ImageData& base, int max_levels, int min_dimension) {
+    levels_.clear();
+    min_dimension = std::max(1, min_dimension);
+
+    while (max_levels < 0 || levelCount() < max_levels) {
+        const ImageData& source = levels_.empty() ? base : levels_.back();
+        if ((source.width + 1) / 2 < min_dimension || (source.height + 1) / 2 < min_dimension) break;
+        if (source.width <= 1 && source.height <= 1) break;
+
+        // Reduced into a local first; growing levels_ would move the source
+        ImageData reduced;
+        downsample2x(source, reduced);
+        levels_.push_back(std::move(reduced));
+    }
+}
+
+int ImagePyramid::levelForSize(int width, int height, int target_width, int target_height) {
+    if (target_width <= 0 || target_height <= 0) return 0;
+
+    int level = 0;
+    while (true) {
+        int next_width = (width + 1) / 2;
+        int next_height = (height + 1) / 2;
+        if (next_width < target_width || next_height < target_height) break;
+        if (next_width == width && next_height == height) break;
+        width = next_width;
+        height = next_height;
+        ++level;
+    }
+    return level;
+}
+
+void ImagePyramid::downsample2x(const ImageData& input, ImageData& output) {
+    int out_width = std::max(1, (input.width + 1) / 2);
+    int out_height = std::max(1, (input.height + 1) / 2);
+    output = ImageData(out_width, out_height, input.channels, input.layout);
+    reduceWindows(input, output);
+    if (input.data.empty()) return;
+
+    // Interleaved rows are one run of pixels; planar images are reduced plane by plane
+    int planes = (input.layout == PixelLayout::PLANAR) ? input.channels : 1;
+    int stride = static_cast<int>(input.pixelStride());
+    size_t in_row = static_cast<size_t>(input.width) * stride;
+    size_t out_row = static_cast<size_t>(out_width) * stride;
+
+    parallelFor(0, out_height, [&](int y_begin, int y_end) {
+        std::vector<float> sums(in_row);
+        for (int p = 0; p < planes; ++p) {
+            const float* in_plane = input.data.data() + p * input.channelStride();
+            float* out_plane = output.data.data() + p * output.channelStride();
+
+            for (int y = y_begin; y < y_end; ++y) {
+                const float* row0 = in_plane + static_cast<size_t>(2 * y) * in_row;
+                const float* row1 = in_plane + static_cast<size_t>(std::min(2 * y + 1, input.height - 1)) * in_row;
+                downsampleRow(row0, row1, out_plane + y * out_row, input.width, out_width, stride, sums);
+            }
+        }
+    });
+}
+
+void ImagePyramid::reduceWindows(const ImageData& input, ImageData& output, int levels) {
+    output.x_offset = halveCoordinate(input.x_offset, levels);
+    output.y_offset = halveCoordinate(input.y_offset, levels);
+    output.display_window.min.x = halveCoordinate(input.display_window.min.x, levels);
+    output.display_window.min.y = halveCoordinate(input.display_window.min.y, levels);
+    output.display_window.max.x = halveCoordinate(input.display_window.max.x, levels);
+    output.display_window.max.y = halveCoordinate(input.display_window.max.y, levels);
+}
+
+} // namespace ImageProcessing
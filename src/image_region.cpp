@@ -0,0 +1,83 @@
+#include "exr_processor.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace ImageProcessing {
+
+namespace {
+
+// Copies a width x height block between images of the same channel count and
+// layout, one contiguous row run per plane
+void copyBlock(const ImageData& src, int src_x, int src_y, ImageData& dst, int dst_x, int dst_y,
+               int width, int height) {
+    int planes = (src.layout == PixelLayout::PLANAR) ? src.channels : 1;
+    size_t lane = src.pixelStride();
+
+    parallelFor(0, height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int p = 0; p < planes; ++p) {
+                const float* in = src.data.data() + p * src.channelStride() +
+                                  (static_cast<size_t>(src_y + y) * src.width + src_x) * lane;
+                float* out = dst.data.data() + p * dst.channelStride() +
+                             (static_cast<size_t>(dst_y + y) * dst.width + dst_x) * lane;
+                std::copy(in, in + width * lane, out);
+            }
+        }
+    });
+}
+
+} // namespace
+
+void processRegion(ImageData& image, const Imath::Box2i& roi, int halo,
+                   const std::function<void(ImageData&)>& kernel) {
+    // Region in sample coordinates, clipped to the data window; [x0, x1) x [y0, y1)
+    int x0 = std::max(roi.min.x - image.x_offset, 0);
+    int y0 = std::max(roi.min.y - image.y_offset, 0);
+    int x1 = std::min(roi.max.x - image.x_offset + 1, image.width);
+    int y1 = std::min(roi.max.y - image.y_offset + 1, image.height);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    if (x0 == 0 && y0 == 0 && x1 == image.width && y1 == image.height) {
+        kernel(image);
+        return;
+    }
+
+    // The halo gives the kernel real neighbours inside the frame; at the data
+    // window edges it sees the same zero padding as a full-frame run
+    halo = std::max(0, halo);
+    int cx0 = std::max(0, x0 - halo);
+    int cy0 = std::max(0, y0 - halo);
+    int cx1 = std::min(image.width, x1 + halo);
+    int cy1 = std::min(image.height, y1 + halo);
+
+    ImageData region;
+    region.reshape(cx1 - cx0, cy1 - cy0, image.channels, image.layout);
+    region.x_offset = image.x_offset + cx0;
+    region.y_offset = image.y_offset + cy0;
+    region.display_window = image.display_window;
+    copyBlock(image, cx0, cy0, region, 0, 0, region.width, region.height);
+
+    kernel(region);
+
+    copyBlock(region, x0 - cx0, y0 - cy0, image, x0, y0, x1 - x0, y1 - y0);
+}
+
+bool cropImage(const ImageData& image, const Imath::Box2i& window, ImageData& output) {
+    int x0 = std::max(window.min.x - image.x_offset, 0);
+    int y0 = std::max(window.min.y - image.y_offset, 0);
+    int x1 = std::min(window.max.x - image.x_offset + 1, image.width);
+    int y1 = std::min(window.max.y - image.y_offset + 1, image.height);
+    if (x0 >= x1 || y0 >= y1) return false;
+
+    ImageData cropped;
+    cropped.reshape(x1 - x0, y1 - y0, image.channels, image.layout);
+    cropped.x_offset = image.x_offset + x0;
+    cropped.y_offset = image.y_offset + y0;
+    cropped.display_window = image.display_window;
+    copyBlock(image, x0, y0, cropped, 0, 0, cropped.width, cropped.height);
+
+    output = std::move(cropped);
+    return true;
+}
+
+} // namespace ImageProcessing
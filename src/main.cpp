@@ -1,4 +1,5 @@
 #include <iostream>
+#include <cstdlib>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "exr_processor.h"
@@ -126,7 +127,7 @@ void demonstrateEXRProcessing() {
     std::cout << "\n=== EXR Processing Complete ===" << std::endl;
 }
 
-int main() {
+int main(int argc, char** argv) {
     std::cout << "EXR Processing Demo - OpenGL with GLAD" << std::endl;
     
     // Demonstrate EXR processing first
@@ -162,8 +163,13 @@ int main() {
     Viewer viewer;
     viewer.initialize();
     
-    // Load a test EXR if it exists
-    viewer.loadEXRImage("test_output.exr");
+    // A frame pattern and range open flipbook mode, e.g. beauty.%04d.exr 1001 1100
+    if (argc >= 4) {
+        viewer.loadSequence(argv[1], std::atoi(argv[2]), std::atoi(argv[3]));
+    } else {
+        // Load a test EXR if it exists
+        viewer.loadEXRImage(argc >= 2 ? argv[1] : "test_output.exr");
+    }
     
     // Set up input callbacks
     glfwSetKeyCallback(window, [](GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -191,9 +197,42 @@ int main() {
                 case GLFW_KEY_R:
                     viewer->resetImage();
                     break;
+                case GLFW_KEY_Z:
+                    viewer->undo();
+                    break;
+                case GLFW_KEY_Y:
+                    viewer->redo();
+                    break;
                 case GLFW_KEY_S:
                     viewer->saveCurrentImage("viewer_output.exr");
                     break;
+                case GLFW_KEY_H:
+                    viewer->setHalfFloatUpload(!viewer->halfFloatUpload());
+                    break;
+                case GLFW_KEY_G:
+                    viewer->setGPUProcessing(!viewer->gpuProcessing());
+                    break;
+                case GLFW_KEY_P: {
+                    // Box pyramid, then Mitchell, then Lanczos3 proxies
+                    using ImageProcessing::ResampleFilter;
+                    ResampleFilter next = ResampleFilter::BOX;
+                    if (viewer->proxyFilter() == ResampleFilter::BOX) {
+                        next = ResampleFilter::MITCHELL;
+                    } else if (viewer->proxyFilter() == ResampleFilter::MITCHELL) {
+                        next = ResampleFilter::LANCZOS3;
+                    }
+                    viewer->setProxyFilter(next);
+                    break;
+                }
+                case GLFW_KEY_SPACE:
+                    viewer->togglePlayback();
+                    break;
+                case GLFW_KEY_LEFT:
+                    viewer->stepFrame(-1);
+                    break;
+                case GLFW_KEY_RIGHT:
+                    viewer->stepFrame(1);
+                    break;
                 case GLFW_KEY_EQUAL:
                 case GLFW_KEY_KP_ADD:
                     viewer->setExposure(viewer->exposure_ * 1.1f);
@@ -208,6 +247,16 @@ int main() {
     
     glfwSetWindowUserPointer(window, &viewer);
     
+    // Previews follow the framebuffer size
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height) {
+        glViewport(0, 0, width, height);
+        Viewer* viewer = static_cast<Viewer*>(glfwGetWindowUserPointer(window));
+        viewer->setWindowSize(width, height);
+    });
+    int framebuffer_width, framebuffer_height;
+    glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+    viewer.setWindowSize(framebuffer_width, framebuffer_height);
+    
     std::cout << "\n=== Viewer Controls ===" << std::endl;
     std::cout << "1 - Apply Gaussian blur" << std::endl;
     std::cout << "2 - Apply sharpening" << std::endl;
@@ -215,7 +264,13 @@ int main() {
     std::cout << "4 - Apply tone mapping" << std::endl;
     std::cout << "T - Toggle tonemapping display" << std::endl;
     std::cout << "R - Reset image" << std::endl;
+    std::cout << "Z/Y - Undo/redo last edit" << std::endl;
     std::cout << "S - Save current image" << std::endl;
+    std::cout << "H - Toggle half-float texture upload" << std::endl;
+    std::cout << "G - Toggle GPU filter processing" << std::endl;
+    std::cout << "P - Cycle proxy filter (box/Mitchell/Lanczos3)" << std::endl;
+    std::cout << "Space - Play/pause sequence" << std::endl;
+    std::cout << "Left/Right - Step sequence frame" << std::endl;
     std::cout << "+/- - Adjust exposure" << std::endl;
     std::cout << "ESC - Exit" << std::endl;
     
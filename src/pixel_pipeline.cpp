@@ -0,0 +1,213 @@
+#include "pixel_pipeline.h"
+#include "thread_pool.h"
+#include "color_lut.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace ImageProcessing {
+
+namespace {
+
+// Pixels per fused tile: 16 KB of RGBA floats, so a tile stays in L1 across the chain
+const size_t kFuseTilePixels = 1024;
+
+} // namespace
+
+PixelPipeline& PixelPipeline::toneMap(float exposure, float gamma) {
+    color::FilmicToneMap op{exposure, 1.0f / gamma};
+    return pointOp("tone_mapping", [op](float* pixels, size_t count, int channels) {
+        color::transformInterleaved(pixels, count, channels, op);
+    });
+}
+
+PixelPipeline& PixelPipeline::toLinear() {
+    return pointOp("to_linear", [](float* pixels, size_t count, int channels) {
+        color::transformInterleaved(pixels, count, channels, color::SRGBToLinear());
+    });
+}
+
+PixelPipeline& PixelPipeline::toSRGB() {
+    return pointOp("to_srgb", [](float* pixels, size_t count, int channels) {
+        color::transformInterleaved(pixels, count, channels, color::LinearToSRGB());
+    });
+}
+
+PixelPipeline& PixelPipeline::lut(const ColorLUT& table, float exposure) {
+    // Shared so copies of the pipeline don't duplicate a 3D table
+    std::shared_ptr<const ColorLUT> shared = std::make_shared<ColorLUT>(table);
+    return pointOp("lut", [shared, exposure](float* pixels, size_t count, int channels) {
+        if (channels < 3 || shared->empty()) return;
+        for (size_t i = 0; i < count; ++i) {
+            float* p = pixels + i * channels;
+            float rgb[3] = {p[0] * exposure, p[1] * exposure, p[2] * exposure};
+            shared->lookup(rgb, p);
+        }
+    });
+}
+
+PixelPipeline& PixelPipeline::premultiplyAlpha() {
+    return pointOp("premultiply_alpha", [](float* pixels, size_t count, int channels) {
+        if (channels < 4) return;
+        for (size_t i = 0; i < count; ++i) {
+            float* p = pixels + i * channels;
+            p[0] *= p[3];
+            p[1] *= p[3];
+            p[2] *= p[3];
+        }
+    });
+}
+
+PixelPipeline& PixelPipeline::unpremultiplyAlpha() {
+    return pointOp("unpremultiply_alpha", [](float* pixels, size_t count, int channels) {
+        if (channels < 4) return;
+        for (size_t i = 0; i < count; ++i) {
+            float* p = pixels + i * channels;
+            if (p[3] > 0.0f) {
+                p[0] /= p[3];
+                p[1] /= p[3];
+                p[2] /= p[3];
+            }
+        }
+    });
+}
+
+PixelPipeline& PixelPipeline::gain(float factor) {
+    return pointOp("gain", [factor](float* pixels, size_t count, int channels) {
+        for (size_t i = 0; i < count; ++i) {
+            float* p = pixels + i * channels;
+            for (int c = 0; c < channels; ++c) {
+                if (c == 3) continue; // Skip alpha
+                p[c] *= factor;
+            }
+        }
+    });
+}
+
+PixelPipeline& PixelPipeline::clamp(float min_val, float max_val) {
+    return pointOp("clamp", [min_val, max_val](float* pixels, size_t count, int channels) {
+        size_t samples = count * channels;
+        for (size_t i = 0; i < samples; ++i) {
+            pixels[i] = std::max(min_val, std::min(max_val, pixels[i]));
+        }
+    });
+}
+
+PixelPipeline& PixelPipeline::pointOp(const std::string& name, const PointKernel& kernel) {
+    stages_.push_back({name, kernel, nullptr});
+    return *this;
+}
+
+PixelPipeline& PixelPipeline::gaussianBlur(float sigma) {
+    return imageOp("gaussian_blur", [sigma](ImageData& image) {
+        ImageFilters::gaussianBlur(image, sigma);
+    });
+}
+
+PixelPipeline& PixelPipeline::sharpen(float strength) {
+    return imageOp("sharpen", [strength](ImageData& image) {
+        ImageFilters::sharpen(image, strength);
+    });
+}
+
+PixelPipeline& PixelPipeline::edgeDetection() {
+    return imageOp("edge_detection", [](ImageData& image) {
+        ImageFilters::sobelEdgeDetection(image);
+    });
+}
+
+PixelPipeline& PixelPipeline::imageOp(const std::string& name, const std::function<void(ImageData&)>& op) {
+    stages_.push_back({name, nullptr, op});
+    return *this;
+}
+
+int PixelPipeline::passCount() const {
+    int passes = 0;
+    bool in_point_run = false;
+    for (const auto& stage : stages_) {
+        if (stage.point) {
+            if (!in_point_run) ++passes;
+            in_point_run = true;
+        } else {
+            ++passes;
+            in_point_run = false;
+        }
+    }
+    return passes;
+}
+
+void PixelPipeline::run(ImageData& image) const {
+    size_t i = 0;
+    while (i < stages_.size()) {
+        if (!stages_[i].point) {
+            stages_[i].image(image);
+            ++i;
+            continue;
+        }
+
+        size_t last = i;
+        while (last < stages_.size() && stages_[last].point) {
+            ++last;
+        }
+        runPointStages(image, i, last);
+        i = last;
+    }
+}
+
+void PixelPipeline::run(HalfImageData& image) const {
+    // Pure point chains widen a block of rows at a time; barriers need the whole frame
+    bool point_only = std::all_of(stages_.begin(), stages_.end(),
+                                  [](const Stage& stage) { return static_cast<bool>(stage.point); });
+    if (point_only) {
+        processHalfRows(image, [this](ImageData& block) { run(block); });
+        return;
+    }
+
+    ImageData widened;
+    convertToFloat(image, widened);
+    run(widened);
+    convertToHalf(widened, image);
+}
+
+void PixelPipeline::runPointStages(ImageData& image, size_t first, size_t last) const {
+    int channels = image.channels;
+    size_t pixels = static_cast<size_t>(image.width) * image.height;
+    int tiles = static_cast<int>((pixels + kFuseTilePixels - 1) / kFuseTilePixels);
+    bool planar = image.layout == PixelLayout::PLANAR && channels > 1;
+
+    parallelFor(0, tiles, [&](int t_begin, int t_end) {
+        std::vector<float> scratch(planar ? kFuseTilePixels * channels : 0);
+
+        for (int t = t_begin; t < t_end; ++t) {
+            size_t begin = static_cast<size_t>(t) * kFuseTilePixels;
+            size_t count = std::min(kFuseTilePixels, pixels - begin);
+
+            // Interleaved tiles are used in place; planar tiles are gathered into pixel order
+            float* tile = image.data.data() + begin * channels;
+            if (planar) {
+                tile = scratch.data();
+                for (int c = 0; c < channels; ++c) {
+                    const float* plane = image.data.data() + c * image.channelStride() + begin;
+                    for (size_t p = 0; p < count; ++p) {
+                        tile[p * channels + c] = plane[p];
+                    }
+                }
+            }
+
+            for (size_t s = first; s < last; ++s) {
+                stages_[s].point(tile, count, channels);
+            }
+
+            if (planar) {
+                for (int c = 0; c < channels; ++c) {
+                    float* plane = image.data.data() + c * image.channelStride() + begin;
+                    for (size_t p = 0; p < count; ++p) {
+                        plane[p] = tile[p * channels + c];
+                    }
+                }
+            }
+        }
+    });
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,155 @@
+#include "preview_worker.h"
+#include "image_pyramid.h"
+#include "resampler.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace ImageProcessing {
+
+PreviewWorker::PreviewWorker()
+    : generation_(0), applied_(0), has_pending_(false), running_(false),
+      has_result_(false), stopping_(false), latest_generation_(0) {
+    thread_ = std::thread(&PreviewWorker::run, this);
+}
+
+PreviewWorker::~PreviewWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        latest_generation_.store(std::numeric_limits<uint64_t>::max());
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void PreviewWorker::submit(Request request) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latest_generation_.store(request.generation);
+        pending_ = std::move(request);
+        has_pending_ = true;
+    }
+    cv_.notify_one();
+}
+
+void PreviewWorker::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_generation_.store(std::numeric_limits<uint64_t>::max());
+    pending_ = Request();
+    has_pending_ = false;
+    result_ = Result();
+    has_result_ = false;
+}
+
+bool PreviewWorker::takeResult(Result& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!has_result_) return false;
+    result = std::move(result_);
+    result_ = Result();
+    has_result_ = false;
+    return true;
+}
+
+bool PreviewWorker::busy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return has_pending_ || running_;
+}
+
+bool PreviewWorker::cancelled(uint64_t generation) const {
+    return latest_generation_.load() != generation;
+}
+
+void PreviewWorker::run() {
+    for (;;) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || has_pending_; });
+            if (stopping_) return;
+            request = std::move(pending_);
+            pending_ = Request();
+            has_pending_ = false;
+            running_ = true;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool complete = true;
+
+        // A new generation starts over from a checkpoint or the source; the same one keeps the applied steps
+        if (request.generation != generation_ || !frame_ || applied_ > request.steps.size()) {
+            generation_ = request.generation;
+            applied_ = 0;
+            frame_.reset();
+
+            if (request.resume) {
+                ImageData checkpoint;
+                size_t steps = request.resume(checkpoint);
+                if (steps > 0 && steps <= request.steps.size() && !checkpoint.data.empty()) {
+                    frame_ = std::make_shared<const ImageData>(std::move(checkpoint));
+                    applied_ = steps;
+                }
+            }
+
+            if (!frame_ && request.level > 0 && request.source) {
+                ProfileScope scope("preview.reduce", *request.source);
+                ImageData reduced;
+                if (request.reduce_filter == ResampleFilter::BOX) {
+                    ImagePyramid::downsample2x(*request.source, reduced);
+                    for (int level = 2; level <= request.level && !cancelled(request.generation); ++level) {
+                        ImageData next;
+                        ImagePyramid::downsample2x(reduced, next);
+                        reduced = std::move(next);
+                    }
+                } else {
+                    int width = request.source->width;
+                    int height = request.source->height;
+                    for (int level = 0; level < request.level; ++level) {
+                        width = std::max(1, (width + 1) / 2);
+                        height = std::max(1, (height + 1) / 2);
+                    }
+                    Resampler::resize(*request.source, reduced, width, height, request.reduce_filter);
+                    ImagePyramid::reduceWindows(*request.source, reduced, request.level);
+                }
+                if (cancelled(request.generation)) {
+                    complete = false;
+                } else {
+                    scope.addImageWritten(reduced);
+                    frame_ = std::make_shared<const ImageData>(std::move(reduced));
+                }
+            } else if (!frame_) {
+                frame_ = request.source;
+            }
+        }
+
+        // Copy on write: the published frame may still be on screen
+        if (complete && frame_ && applied_ < request.steps.size()) {
+            ImageData working = *frame_;
+            size_t step = applied_;
+            for (; step < request.steps.size(); ++step) {
+                if (cancelled(request.generation)) break;
+                request.steps[step](working);
+            }
+            if (step == request.steps.size()) {
+                frame_ = std::make_shared<const ImageData>(std::move(working));
+                applied_ = step;
+            } else {
+                complete = false;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        if (complete && frame_ && !cancelled(request.generation)) {
+            result_.generation = request.generation;
+            result_.steps = applied_;
+            result_.image = frame_;
+            result_.milliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            has_result_ = true;
+        }
+    }
+}
+
+} // namespace ImageProcessing
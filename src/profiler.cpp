@@ -0,0 +1,248 @@
+#include "profiler.h"
+#include "frame_pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+namespace ImageProcessing {
+
+namespace {
+
+thread_local int t_frame = -1;
+thread_local int t_thread_index = -1;
+std::atomic<int> g_next_thread(0);
+
+const size_t kDefaultEventLimit = 1000000;
+
+bool envEnabled() {
+    const char* env = std::getenv("SCBW_PROFILE");
+    return env && *env && std::string(env) != "0";
+}
+
+void writeAtExit() {
+    Profiler& profiler = Profiler::global();
+    if (const char* path = std::getenv("SCBW_PROFILE_TRACE")) {
+        profiler.writeChromeTrace(path);
+    }
+    if (const char* path = std::getenv("SCBW_PROFILE_SUMMARY")) {
+        profiler.writeSummary(path);
+    }
+}
+
+// Scope names are identifiers, but quotes and control characters must not break the JSON
+std::string jsonString(const char* text) {
+    std::string out = "\"";
+    for (const char* p = text; *p; ++p) {
+        if (*p == '"' || *p == '\\') {
+            out += '\\';
+            out += *p;
+        } else if (static_cast<unsigned char>(*p) < 0x20) {
+            out += ' ';
+        } else {
+            out += *p;
+        }
+    }
+    return out + "\"";
+}
+
+void writeScopeStats(std::FILE* file, const Profiler::ScopeStats& stats) {
+    std::fprintf(file,
+                 "{\"calls\": %zu, \"total_ms\": %.3f, \"mean_ms\": %.3f, \"max_ms\": %.3f, "
+                 "\"bytes_read\": %llu, \"bytes_written\": %llu, \"pixels\": %llu, "
+                 "\"megapixels_per_second\": %.3f}",
+                 stats.calls, stats.total_ms, stats.calls ? stats.total_ms / stats.calls : 0.0, stats.max_ms,
+                 static_cast<unsigned long long>(stats.bytes_read),
+                 static_cast<unsigned long long>(stats.bytes_written),
+                 static_cast<unsigned long long>(stats.pixels), stats.megapixelsPerSecond());
+}
+
+void accumulate(Profiler::ScopeStats& stats, const Profiler::Event& event) {
+    double ms = event.duration_us / 1000.0;
+    ++stats.calls;
+    stats.total_ms += ms;
+    stats.max_ms = std::max(stats.max_ms, ms);
+    stats.bytes_read += event.bytes_read;
+    stats.bytes_written += event.bytes_written;
+    stats.pixels += event.pixels;
+}
+
+} // namespace
+
+std::atomic<bool> Profiler::enabled_(false);
+
+Profiler::Profiler() : event_limit_(kDefaultEventLimit), dropped_(0) {
+    if (envEnabled()) {
+        enabled_ = true;
+        std::atexit(&writeAtExit);
+    }
+}
+
+Profiler& Profiler::global() {
+    // Never destroyed, so the exit handler and late scopes can still use it
+    static Profiler* profiler = new Profiler();
+    return *profiler;
+}
+
+namespace {
+
+// Reads SCBW_PROFILE before main so enabled() is right from the first scope
+const bool g_profiler_initialised = (Profiler::global(), true);
+
+} // namespace
+
+void Profiler::setEnabled(bool enabled) {
+    enabled_ = enabled;
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+    dropped_ = 0;
+    FramePool::global().resetPeak();
+}
+
+void Profiler::record(const Event& event) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (events_.size() >= event_limit_) {
+        ++dropped_;
+        return;
+    }
+    events_.push_back(event);
+}
+
+void Profiler::setEventLimit(size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    event_limit_ = limit;
+}
+
+size_t Profiler::droppedEvents() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+std::map<std::string, Profiler::ScopeStats> Profiler::summary() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, ScopeStats> scopes;
+    for (const Event& event : events_) {
+        accumulate(scopes[event.name], event);
+    }
+    return scopes;
+}
+
+std::vector<Profiler::Event> Profiler::events() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const {
+    std::vector<Event> events = this->events();
+
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Failed to write trace: " << path << std::endl;
+        return false;
+    }
+
+    std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (size_t i = 0; i < events.size(); ++i) {
+        const Event& event = events[i];
+        std::fprintf(file,
+                     "{\"name\": %s, \"cat\": \"scbw\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                     "\"ts\": %lld, \"dur\": %lld, \"args\": {\"frame\": %d, \"bytes_read\": %llu, "
+                     "\"bytes_written\": %llu, \"pixels\": %llu}}%s\n",
+                     jsonString(event.name).c_str(), event.thread,
+                     static_cast<long long>(event.start_us), static_cast<long long>(event.duration_us),
+                     event.frame, static_cast<unsigned long long>(event.bytes_read),
+                     static_cast<unsigned long long>(event.bytes_written),
+                     static_cast<unsigned long long>(event.pixels), (i + 1 < events.size()) ? "," : "");
+    }
+    std::fprintf(file, "]}\n");
+
+    bool ok = std::fclose(file) == 0;
+    if (!ok) {
+        std::cerr << "Failed to write trace: " << path << std::endl;
+    }
+    return ok;
+}
+
+bool Profiler::writeSummary(const std::string& path) const {
+    std::vector<Event> events = this->events();
+    FramePool::Stats memory = FramePool::global().stats();
+
+    // Per-frame wall time runs from the first scope of a frame to the end of its last one
+    struct FrameTotals {
+        int64_t begin = INT64_MAX;
+        int64_t end = INT64_MIN;
+        std::map<std::string, ScopeStats> scopes;
+    };
+    std::map<std::string, ScopeStats> scopes;
+    std::map<int, FrameTotals> frames;
+    for (const Event& event : events) {
+        accumulate(scopes[event.name], event);
+        if (event.frame >= 0) {
+            FrameTotals& frame = frames[event.frame];
+            frame.begin = std::min(frame.begin, event.start_us);
+            frame.end = std::max(frame.end, event.start_us + event.duration_us);
+            accumulate(frame.scopes[event.name], event);
+        }
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Failed to write profile summary: " << path << std::endl;
+        return false;
+    }
+
+    std::fprintf(file, "{\n  \"peak_image_bytes\": %zu,\n  \"live_image_bytes\": %zu,\n  \"dropped_events\": %zu,\n",
+                 memory.bytes_peak, memory.bytes_live, droppedEvents());
+
+    std::fprintf(file, "  \"scopes\": {");
+    size_t index = 0;
+    for (const auto& scope : scopes) {
+        std::fprintf(file, "%s\n    %s: ", index++ ? "," : "", jsonString(scope.first.c_str()).c_str());
+        writeScopeStats(file, scope.second);
+    }
+    std::fprintf(file, "\n  },\n  \"frames\": [");
+
+    index = 0;
+    for (const auto& frame : frames) {
+        std::fprintf(file, "%s\n    {\"frame\": %d, \"wall_ms\": %.3f, \"scopes\": {", index++ ? "," : "",
+                     frame.first, (frame.second.end - frame.second.begin) / 1000.0);
+        size_t scope_index = 0;
+        for (const auto& scope : frame.second.scopes) {
+            std::fprintf(file, "%s%s: ", scope_index++ ? ", " : "", jsonString(scope.first.c_str()).c_str());
+            writeScopeStats(file, scope.second);
+        }
+        std::fprintf(file, "}}");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+
+    bool ok = std::fclose(file) == 0;
+    if (!ok) {
+        std::cerr << "Failed to write profile summary: " << path << std::endl;
+    }
+    return ok;
+}
+
+int64_t Profiler::nowMicroseconds() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int Profiler::threadIndex() {
+    if (t_thread_index < 0) {
+        t_thread_index = g_next_thread.fetch_add(1);
+    }
+    return t_thread_index;
+}
+
+int Profiler::currentFrame() {
+    return t_frame;
+}
+
+void Profiler::setCurrentFrame(int frame) {
+    t_frame = frame;
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,442 @@
+#include "raw_frame.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ImageProcessing {
+
+namespace {
+
+const char kMagic[8] = {'S', 'C', 'B', 'W', 'R', 'A', 'W', '1'};
+const uint32_t kVersion = 1;
+// Fixed rather than the host page size so files are identical everywhere;
+// 16 KB-page hosts still only fault in the passes that are touched, at
+// 16 KB granularity
+const uint64_t kPassAlignment = 4096;
+const size_t kNameBytes = 64;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pass_count;
+    uint64_t data_offset;
+    uint8_t reserved[40];
+};
+
+struct PassRecord {
+    char name[kNameBytes];
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    uint32_t layout;
+    uint32_t sample_type;
+    int32_t x_offset;
+    int32_t y_offset;
+    int32_t display_window[4];
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+static_assert(sizeof(FileHeader) == 64, "raw frame header layout");
+static_assert(sizeof(PassRecord) == 128, "raw frame pass record layout");
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t sampleBytes(RawSampleType type) {
+    return type == RawSampleType::HALF ? sizeof(half) : sizeof(float);
+}
+
+// Bytes of a pass's samples, or false when they would exceed `limit`. Each
+// factor is checked before it is multiplied in, so the product cannot wrap
+// around to a plausible size.
+bool passBytesWithin(const RawPassInfo& pass, uint64_t limit, uint64_t& bytes) {
+    bytes = 0;
+    if (pass.width == 0 || pass.height == 0 || pass.channels == 0) return true;
+    uint64_t product = pass.sampleBytes();
+    for (uint64_t factor : {static_cast<uint64_t>(pass.channels), static_cast<uint64_t>(pass.width),
+                            static_cast<uint64_t>(pass.height)}) {
+        if (product > limit / factor) return false;
+        product *= factor;
+    }
+    bytes = product;
+    return true;
+}
+
+void convertRun(const float* src, float* dst, size_t count) { std::memcpy(dst, src, count * sizeof(float)); }
+void convertRun(const half* src, half* dst, size_t count) { std::memcpy(dst, src, count * sizeof(half)); }
+void convertRun(const half* src, float* dst, size_t count) { halfToFloat(src, dst, count); }
+void convertRun(const float* src, half* dst, size_t count) { floatToHalf(src, dst, count); }
+
+template <typename T>
+struct SourcePass {
+    std::string name;
+    const BasicImageData<T>* image;
+};
+
+template <typename Out, typename T>
+bool writeConverted(std::FILE* file, const BasicImageData<T>& image) {
+    const size_t kChunk = 64 * 1024;
+    size_t count = image.data.size();
+    std::vector<Out> converted(std::min(count, kChunk));
+    for (size_t start = 0; start < count; start += kChunk) {
+        size_t n = std::min(kChunk, count - start);
+        convertRun(image.data.data() + start, converted.data(), n);
+        if (std::fwrite(converted.data(), sizeof(Out), n, file) != n) return false;
+    }
+    return true;
+}
+
+// Samples in the image's own order; converted through a small buffer when
+// the stored type differs from the image's
+template <typename T>
+bool writeSamples(std::FILE* file, const BasicImageData<T>& image, RawSampleType sample_type) {
+    if (RawSampleTypeOf<T>::value == sample_type) {
+        size_t count = image.data.size();
+        return std::fwrite(image.data.data(), sizeof(T), count, file) == count;
+    }
+    return sample_type == RawSampleType::HALF ? writeConverted<half>(file, image)
+                                              : writeConverted<float>(file, image);
+}
+
+bool writePadding(std::FILE* file, uint64_t bytes) {
+    static const char zeros[kPassAlignment] = {};
+    return bytes == 0 || std::fwrite(zeros, 1, bytes, file) == bytes;
+}
+
+template <typename T>
+bool writeFrame(const std::string& filepath, const std::vector<SourcePass<T>>& passes, RawSampleType sample_type) {
+    ProfileScope scope("raw.save");
+    if (passes.empty()) {
+        std::cerr << "No passes to write: " << filepath << std::endl;
+        return false;
+    }
+
+    std::set<std::string> names;
+    std::vector<PassRecord> records(passes.size());
+    uint64_t offset = alignUp(sizeof(FileHeader) + passes.size() * sizeof(PassRecord), kPassAlignment);
+    uint64_t data_offset = offset;
+    for (size_t i = 0; i < passes.size(); ++i) {
+        const std::string& name = passes[i].name;
+        const BasicImageData<T>& image = *passes[i].image;
+        if (name.empty() || name.size() >= kNameBytes || !names.insert(name).second) {
+            std::cerr << "Invalid or duplicate raw frame pass name '" << name << "': " << filepath << std::endl;
+            return false;
+        }
+
+        PassRecord& record = records[i];
+        std::memset(&record, 0, sizeof(record));
+        std::memcpy(record.name, name.data(), name.size());
+        record.width = image.width;
+        record.height = image.height;
+        record.channels = image.channels;
+        record.layout = image.layout == PixelLayout::PLANAR ? 1 : 0;
+        record.sample_type = static_cast<uint32_t>(sample_type);
+        record.x_offset = image.x_offset;
+        record.y_offset = image.y_offset;
+        record.display_window[0] = image.display_window.min.x;
+        record.display_window[1] = image.display_window.min.y;
+        record.display_window[2] = image.display_window.max.x;
+        record.display_window[3] = image.display_window.max.y;
+        record.offset = offset;
+        record.bytes = static_cast<uint64_t>(image.data.size()) * sampleBytes(sample_type);
+        offset = alignUp(offset + record.bytes, kPassAlignment);
+
+        scope.addImageRead(image);
+        scope.addPixels(static_cast<uint64_t>(image.width) * image.height);
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.pass_count = static_cast<uint32_t>(passes.size());
+    header.data_offset = data_offset;
+
+    // Written under a temporary name and renamed, so a reader on another
+    // host sees either the old frame or the complete new one
+    std::string temp_path = filepath + ".tmp" + std::to_string(getpid());
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to write raw frame: " << filepath << std::endl;
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(records.data(), sizeof(PassRecord), records.size(), file) == records.size() &&
+              writePadding(file, data_offset - sizeof(header) - records.size() * sizeof(PassRecord));
+    for (size_t i = 0; ok && i < passes.size(); ++i) {
+        uint64_t end = records[i].offset + records[i].bytes;
+        uint64_t next = (i + 1 < passes.size()) ? records[i + 1].offset : end;
+        ok = writeSamples(file, *passes[i].image, sample_type) && writePadding(file, next - end);
+    }
+    ok = (std::fclose(file) == 0) && ok;
+    if (ok) {
+        ok = std::rename(temp_path.c_str(), filepath.c_str()) == 0;
+    }
+    if (!ok) {
+        std::remove(temp_path.c_str());
+        std::cerr << "Failed to write raw frame: " << filepath << std::endl;
+        return false;
+    }
+
+    scope.addWritten(offset);
+    return true;
+}
+
+template <typename Src, typename Dst>
+void copyPass(const RawPassInfo& pass, const Src* src, BasicImageData<Dst>& image) {
+    if (pass.layout == image.layout) {
+        // Identical sample order: one run per plane and row block
+        int planes = (pass.layout == PixelLayout::PLANAR) ? pass.channels : 1;
+        size_t row_samples = static_cast<size_t>(pass.width) * pass.pixelStride();
+        parallelFor(0, pass.height, [&](int y_begin, int y_end) {
+            size_t begin = static_cast<size_t>(y_begin) * row_samples;
+            size_t count = static_cast<size_t>(y_end - y_begin) * row_samples;
+            for (int p = 0; p < planes; ++p) {
+                size_t plane = p * pass.channelStride();
+                convertRun(src + plane + begin, image.data.data() + plane + begin, count);
+            }
+        });
+        return;
+    }
+
+    size_t src_pixel = pass.pixelStride();
+    size_t src_channel = pass.channelStride();
+    parallelFor(0, pass.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int x = 0; x < pass.width; ++x) {
+                const Src* in = src + (static_cast<size_t>(y) * pass.width + x) * src_pixel;
+                for (int c = 0; c < pass.channels; ++c) {
+                    convertRun(in + c * src_channel, &image(x, y, c), 1);
+                }
+            }
+        }
+    });
+}
+
+template <typename T>
+bool readPassInto(const RawFrame& frame, const std::string& pass_name, BasicImageData<T>& image,
+                  PixelLayout layout) {
+    const RawPassInfo* pass = frame.findPass(pass_name);
+    if (!pass) {
+        std::cerr << "No pass '" << pass_name << "' in raw frame: " << frame.path() << std::endl;
+        return false;
+    }
+
+    ProfileScope scope("raw.read_pass");
+    if (!image.hasShape(pass->width, pass->height, pass->channels, layout)) {
+        image.reshape(pass->width, pass->height, pass->channels, layout);
+    }
+    image.x_offset = pass->x_offset;
+    image.y_offset = pass->y_offset;
+    image.display_window = pass->display_window;
+
+    const void* data = frame.passData(*pass);
+    if (pass->sample_type == RawSampleType::HALF) {
+        copyPass(*pass, static_cast<const half*>(data), image);
+    } else {
+        copyPass(*pass, static_cast<const float*>(data), image);
+    }
+
+    scope.addRead(pass->bytes);
+    scope.addImageWritten(image);
+    return true;
+}
+
+template <typename T>
+bool readRGBAInto(const RawFrame& frame, BasicImageData<T>& image, PixelLayout layout) {
+    if (frame.passes().empty()) {
+        std::cerr << "Raw frame has no passes: " << frame.path() << std::endl;
+        return false;
+    }
+    const RawPassInfo& pass = frame.passes().front();
+    if (pass.channels == 4) {
+        return readPassInto(frame, pass.name, image, layout);
+    }
+
+    BasicImageData<T> source;
+    if (!readPassInto(frame, pass.name, source, layout)) return false;
+    image.reshape(source.width, source.height, 4, layout);
+    image.setWindowsFrom(source);
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int x = 0; x < image.width; ++x) {
+                for (int c = 0; c < 4; ++c) {
+                    image(x, y, c) = (c < source.channels) ? source(x, y, c) : T(c == 3 ? 1.0f : 0.0f);
+                }
+            }
+        }
+    });
+    return true;
+}
+
+} // namespace
+
+bool saveRawFrame(const std::string& filepath, const std::vector<RenderPass>& passes, RawSampleType sample_type) {
+    std::vector<SourcePass<float>> sources;
+    for (const RenderPass& pass : passes) {
+        sources.push_back({pass.name, &pass.image});
+    }
+    return writeFrame(filepath, sources, sample_type);
+}
+
+bool saveRawFrame(const std::string& filepath, const std::string& pass_name, const ImageData& image,
+                  RawSampleType sample_type) {
+    std::vector<SourcePass<float>> sources(1, SourcePass<float>{pass_name, &image});
+    return writeFrame(filepath, sources, sample_type);
+}
+
+bool saveRawFrame(const std::string& filepath, const std::string& pass_name, const HalfImageData& image) {
+    std::vector<SourcePass<half>> sources(1, SourcePass<half>{pass_name, &image});
+    return writeFrame(filepath, sources, RawSampleType::HALF);
+}
+
+bool isRawFrame(const std::string& filepath) {
+    char magic[sizeof(kMagic)];
+    std::FILE* file = std::fopen(filepath.c_str(), "rb");
+    if (!file) return false;
+    bool match = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                 std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+    std::fclose(file);
+    return match;
+}
+
+RawFrame::RawFrame() : mapping_(nullptr), mapping_bytes_(0) {
+}
+
+RawFrame::~RawFrame() {
+    close();
+}
+
+bool RawFrame::open(const std::string& filepath) {
+    close();
+
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open raw frame: " << filepath << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        std::cerr << "Not a raw frame: " << filepath << std::endl;
+        return false;
+    }
+
+    size_t file_bytes = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, file_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);    // The mapping keeps the file alive
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map raw frame: " << filepath << std::endl;
+        return false;
+    }
+    mapping_ = mapping;
+    mapping_bytes_ = file_bytes;
+    path_ = filepath;
+
+    auto fail = [&](const char* reason) {
+        std::cerr << reason << ": " << filepath << std::endl;
+        close();
+        return false;
+    };
+
+    FileHeader header;
+    std::memcpy(&header, mapping_, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) return fail("Not a raw frame");
+    if (header.version != kVersion) return fail("Unsupported raw frame version");
+    if (sizeof(FileHeader) + static_cast<uint64_t>(header.pass_count) * sizeof(PassRecord) > file_bytes) {
+        return fail("Truncated raw frame header");
+    }
+
+    const char* records = static_cast<const char*>(mapping_) + sizeof(FileHeader);
+    for (uint32_t i = 0; i < header.pass_count; ++i) {
+        PassRecord record;
+        std::memcpy(&record, records + i * sizeof(PassRecord), sizeof(record));
+
+        RawPassInfo pass;
+        pass.name.assign(record.name, strnlen(record.name, kNameBytes));
+        pass.width = record.width;
+        pass.height = record.height;
+        pass.channels = record.channels;
+        pass.layout = record.layout == 1 ? PixelLayout::PLANAR : PixelLayout::INTERLEAVED;
+        pass.sample_type = static_cast<RawSampleType>(record.sample_type);
+        pass.x_offset = record.x_offset;
+        pass.y_offset = record.y_offset;
+        pass.display_window = Imath::Box2i(Imath::V2i(record.display_window[0], record.display_window[1]),
+                                           Imath::V2i(record.display_window[2], record.display_window[3]));
+        pass.offset = record.offset;
+        pass.bytes = record.bytes;
+
+        if (pass.sample_type != RawSampleType::HALF && pass.sample_type != RawSampleType::FLOAT) {
+            return fail("Unknown sample type in raw frame");
+        }
+        uint64_t sample_bytes = 0;
+        if (pass.width < 0 || pass.height < 0 || pass.channels < 0 || record.layout > 1 ||
+            !passBytesWithin(pass, file_bytes, sample_bytes) || pass.bytes != sample_bytes) {
+            return fail("Inconsistent pass record in raw frame");
+        }
+        if (pass.offset % kPassAlignment != 0 || pass.offset > file_bytes || pass.bytes > file_bytes - pass.offset) {
+            return fail("Pass data outside raw frame");
+        }
+        passes_.push_back(pass);
+    }
+    return true;
+}
+
+void RawFrame::close() {
+    if (mapping_) {
+        munmap(mapping_, mapping_bytes_);
+        mapping_ = nullptr;
+        mapping_bytes_ = 0;
+    }
+    passes_.clear();
+    path_.clear();
+}
+
+const RawPassInfo* RawFrame::findPass(const std::string& name) const {
+    for (const RawPassInfo& pass : passes_) {
+        if (pass.name == name) return &pass;
+    }
+    return nullptr;
+}
+
+const void* RawFrame::passData(const RawPassInfo& pass) const {
+    return static_cast<const char*>(mapping_) + pass.offset;
+}
+
+void RawFrame::prefetch(const RawPassInfo& pass) const {
+    if (!mapping_ || pass.bytes == 0) return;
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(passData(pass)) & ~(page - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(passData(pass)) + pass.bytes;
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+}
+
+bool RawFrame::readPass(const std::string& pass_name, ImageData& image, PixelLayout layout) const {
+    return readPassInto(*this, pass_name, image, layout);
+}
+
+bool RawFrame::readPass(const std::string& pass_name, HalfImageData& image, PixelLayout layout) const {
+    return readPassInto(*this, pass_name, image, layout);
+}
+
+bool RawFrame::readRGBA(ImageData& image, PixelLayout layout) const {
+    return readRGBAInto(*this, image, layout);
+}
+
+bool RawFrame::readRGBA(HalfImageData& image, PixelLayout layout) const {
+    return readRGBAInto(*this, image, layout);
+}
+
+} // namespace ImageProcessing
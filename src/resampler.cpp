@@ -0,0 +1,291 @@
+#include "resampler.h"
+#include "image_view.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace ImageProcessing {
+
+namespace {
+
+using simd::VecF;
+
+const double kPi = 3.14159265358979323846;
+
+// Vectors accumulated side by side in the horizontal pass; strides needing
+// more (odd dynamic channel counts) use the scalar loop
+const int kMaxBlocks = 4;
+
+double sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= kPi;
+    return std::sin(x) / x;
+}
+
+double filterWeight(ResampleFilter filter, double x) {
+    x = std::abs(x);
+    switch (filter) {
+        case ResampleFilter::BOX:
+            return x < 0.5 ? 1.0 : (x == 0.5 ? 0.5 : 0.0);
+        case ResampleFilter::BILINEAR:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case ResampleFilter::MITCHELL: {
+            const double b = 1.0 / 3.0;
+            const double c = 1.0 / 3.0;
+            if (x < 1.0) {
+                return ((12.0 - 9.0 * b - 6.0 * c) * x * x * x + (-18.0 + 12.0 * b + 6.0 * c) * x * x +
+                        (6.0 - 2.0 * b)) / 6.0;
+            }
+            if (x < 2.0) {
+                return ((-b - 6.0 * c) * x * x * x + (6.0 * b + 30.0 * c) * x * x +
+                        (-12.0 * b - 48.0 * c) * x + (8.0 * b + 24.0 * c)) / 6.0;
+            }
+            return 0.0;
+        }
+        case ResampleFilter::LANCZOS3:
+            return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+int greatestCommonDivisor(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Horizontal pass into a target-width x source-height temporary. `expanded`
+// repeats each tap weight once per sample of a pixel, so an output pixel is
+// a dot product over its window of taps * stride samples. `blocks` vectors
+// are summed side by side until the block is a whole number of pixels;
+// each lane then always holds the same channel and the lanes fold into the
+// channels once per output pixel.
+template <class Shape>
+void resampleRows(const ImageData& input, ImageData& temp, const std::vector<int>& first,
+                  const std::vector<float>& expanded, int taps) {
+    auto in = Shape::view(input);
+    auto out = Shape::view(temp);
+    const int width = temp.width;
+
+    parallelFor(0, input.height, [&](int y_begin, int y_end) {
+        const size_t xs = in.pixelStride();
+        const size_t window = taps * xs;
+        const int blocks = static_cast<int>(xs) / greatestCommonDivisor(static_cast<int>(xs), VecF::width);
+        const size_t block = static_cast<size_t>(blocks) * VecF::width;
+        float lanes[kMaxBlocks * VecF::width];
+
+        for (int y = y_begin; y < y_end; ++y) {
+            for (int p = 0; p < in.planes(); ++p) {
+                const float* row = in.row(y, p);
+                float* dst = out.row(y, p);
+
+                for (int x = 0; x < width; ++x, dst += xs) {
+                    const float* src = row + first[x] * xs;
+                    const float* weights = &expanded[x * window];
+
+                    if (blocks > kMaxBlocks) {
+                        for (size_t c = 0; c < xs; ++c) {
+                            float sum = 0.0f;
+                            for (int k = 0; k < taps; ++k) {
+                                sum += src[k * xs + c] * weights[k * xs + c];
+                            }
+                            dst[c] = sum;
+                        }
+                        continue;
+                    }
+
+                    VecF acc[kMaxBlocks];
+                    for (int b = 0; b < blocks; ++b) acc[b] = VecF(0.0f);
+                    size_t j = 0;
+                    for (; j + block <= window; j += block) {
+                        for (int b = 0; b < blocks; ++b) {
+                            size_t i = j + b * VecF::width;
+                            acc[b] = acc[b] + VecF::load(src + i) * VecF::load(weights + i);
+                        }
+                    }
+                    for (int b = 0; b < blocks; ++b) acc[b].store(lanes + b * VecF::width);
+                    for (size_t lane = 0; j < window; ++j, ++lane) {
+                        lanes[lane] += src[j] * weights[j];
+                    }
+
+                    for (size_t c = 0; c < xs; ++c) {
+                        float sum = 0.0f;
+                        for (size_t lane = c; lane < block; lane += xs) {
+                            sum += lanes[lane];
+                        }
+                        dst[c] = sum;
+                    }
+                }
+            }
+        }
+    });
+}
+
+// Vertical pass: each output row is a weighted sum of whole temporary rows,
+// one contiguous run per plane
+template <class Shape>
+void resampleColumns(const ImageData& temp, ImageData& output, const std::vector<int>& first,
+                     const std::vector<float>& weights, int taps) {
+    auto in = Shape::view(temp);
+    auto out = Shape::view(output);
+    const size_t count = in.rowSamples();
+
+    parallelFor(0, output.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            const float* w = &weights[static_cast<size_t>(y) * taps];
+            for (int p = 0; p < in.planes(); ++p) {
+                float* dst = out.row(y, p);
+                size_t i = 0;
+                for (; i + VecF::width <= count; i += VecF::width) {
+                    VecF sum(0.0f);
+                    for (int k = 0; k < taps; ++k) {
+                        sum = sum + VecF::load(in.row(first[y] + k, p) + i) * VecF(w[k]);
+                    }
+                    sum.store(dst + i);
+                }
+                for (; i < count; ++i) {
+                    float sum = 0.0f;
+                    for (int k = 0; k < taps; ++k) {
+                        sum += in.row(first[y] + k, p)[i] * w[k];
+                    }
+                    dst[i] = sum;
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+Resampler::Resampler() : filter_(ResampleFilter::LANCZOS3) {}
+
+Resampler::Resampler(int src_width, int src_height, int dst_width, int dst_height, ResampleFilter filter)
+    : filter_(filter),
+      horizontal_(buildAxis(src_width, dst_width, filter)),
+      vertical_(buildAxis(src_height, dst_height, filter)) {}
+
+float Resampler::support(ResampleFilter filter) {
+    switch (filter) {
+        case ResampleFilter::BOX: return 0.5f;
+        case ResampleFilter::BILINEAR: return 1.0f;
+        case ResampleFilter::MITCHELL: return 2.0f;
+        case ResampleFilter::LANCZOS3: return 3.0f;
+    }
+    return 1.0f;
+}
+
+Resampler::Axis Resampler::buildAxis(int source, int target, ResampleFilter filter) {
+    Axis axis;
+    axis.source = std::max(0, source);
+    axis.target = std::max(0, target);
+    if (axis.source == 0 || axis.target == 0) return axis;
+
+    // Reductions stretch the filter so it spans all the source pixels an output covers
+    double scale = static_cast<double>(axis.source) / axis.target;
+    double stretch = std::max(1.0, scale);
+    double radius = support(filter) * stretch;
+
+    // Taps per output, with samples past the edges folded onto the edge pixel
+    std::vector<std::vector<double>> taps(axis.target);
+    std::vector<int> starts(axis.target);
+    for (int i = 0; i < axis.target; ++i) {
+        double centre = (i + 0.5) * scale - 0.5;
+        int lo = static_cast<int>(std::ceil(centre - radius));
+        int hi = static_cast<int>(std::floor(centre + radius));
+        int begin = std::max(0, std::min(lo, axis.source - 1));
+        int end = std::max(0, std::min(hi, axis.source - 1));
+
+        std::vector<double>& w = taps[i];
+        w.assign(end - begin + 1, 0.0);
+        double sum = 0.0;
+        for (int j = lo; j <= hi; ++j) {
+            double weight = filterWeight(filter, (j - centre) / stretch);
+            w[std::max(begin, std::min(j, end)) - begin] += weight;
+            sum += weight;
+        }
+        if (std::abs(sum) < 1e-12) {
+            // Only possible for a degenerate filter; take the nearest pixel
+            std::fill(w.begin(), w.end(), 0.0);
+            w[std::max(0, std::min(static_cast<int>(std::lround(centre)), end) - begin)] = 1.0;
+            sum = 1.0;
+        }
+        for (double& weight : w) weight /= sum;
+
+        // Taps that land on zeros of the filter (integer offsets of Lanczos) are dropped
+        size_t front = 0;
+        size_t back = w.size();
+        while (back - front > 1 && std::abs(w[front]) < 1e-9) ++front;
+        while (back - front > 1 && std::abs(w[back - 1]) < 1e-9) --back;
+        w = std::vector<double>(w.begin() + front, w.begin() + back);
+        starts[i] = begin + static_cast<int>(front);
+    }
+
+    // A common tap count keeps the loops uniform; short windows are padded
+    // with zero weights and slid back inside the source
+    for (const std::vector<double>& w : taps) {
+        axis.taps = std::max(axis.taps, static_cast<int>(w.size()));
+    }
+    axis.first.resize(axis.target);
+    axis.weights.assign(static_cast<size_t>(axis.target) * axis.taps, 0.0f);
+    for (int i = 0; i < axis.target; ++i) {
+        int first = std::min(starts[i], axis.source - axis.taps);
+        axis.first[i] = first;
+        for (size_t k = 0; k < taps[i].size(); ++k) {
+            axis.weights[static_cast<size_t>(i) * axis.taps + (starts[i] - first) + k] =
+                static_cast<float>(taps[i][k]);
+        }
+    }
+    return axis;
+}
+
+bool Resampler::resample(const ImageData& input, ImageData& output) const {
+    if (input.width != sourceWidth() || input.height != sourceHeight()) {
+        std::cerr << "Resampler built for " << sourceWidth() << "x" << sourceHeight()
+                  << " given a " << input.width << "x" << input.height << " image" << std::endl;
+        return false;
+    }
+    ProfileScope scope("resample", input);
+
+    int channels = input.channels;
+    PixelLayout layout = input.layout;
+    if (targetWidth() == 0 || targetHeight() == 0 || input.data.empty()) {
+        output = ImageData(targetWidth(), targetHeight(), channels, layout);
+        return true;
+    }
+
+    // Each tap weight repeated for every sample of a pixel
+    size_t stride = (layout == PixelLayout::PLANAR) ? 1 : channels;
+    std::vector<float> expanded(horizontal_.weights.size() * stride);
+    for (size_t t = 0; t < horizontal_.weights.size(); ++t) {
+        std::fill_n(expanded.begin() + t * stride, stride, horizontal_.weights[t]);
+    }
+
+    // Rows first; the input is not read again, so output may alias it
+    ImageData temp;
+    temp.reshape(targetWidth(), sourceHeight(), channels, layout);
+    dispatchShape(input, [&](auto shape) {
+        resampleRows<decltype(shape)>(input, temp, horizontal_.first, expanded, horizontal_.taps);
+    });
+
+    output.reshape(targetWidth(), targetHeight(), channels, layout);
+    output.x_offset = 0;
+    output.y_offset = 0;
+    output.display_window = Imath::Box2i(Imath::V2i(0, 0), Imath::V2i(targetWidth() - 1, targetHeight() - 1));
+    dispatchShape(temp, [&](auto shape) {
+        resampleColumns<decltype(shape)>(temp, output, vertical_.first, vertical_.weights, vertical_.taps);
+    });
+    scope.addImageWritten(output);
+    return true;
+}
+
+void Resampler::resize(const ImageData& input, ImageData& output, int width, int height, ResampleFilter filter) {
+    Resampler(input.width, input.height, width, height, filter).resample(input, output);
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,420 @@
+#include "result_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+namespace ImageProcessing {
+
+namespace {
+
+// Samples hashed per parallel task; block hashes are combined in order, so the
+// key does not depend on the thread count
+const size_t kHashBlock = 65536;
+
+const char kBlobMagic[8] = {'S', 'C', 'B', 'W', 'R', 'E', 'S', '2'};
+const char kBlobSuffix[] = ".scbw";
+
+struct BlobHeader {
+    char magic[8];
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    int32_t layout;
+    int32_t x_offset;
+    int32_t y_offset;
+    int32_t display[4];     // min x, min y, max x, max y
+};
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// xxHash64-style round and finaliser
+inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    return rotl(acc, 31) * kPrime1;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    return h ^ (h >> 32);
+}
+
+uint64_t hashBytes(const void* data, size_t bytes, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t lanes[4] = {seed + kPrime1, seed + kPrime2, seed, seed - kPrime1};
+
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        for (int l = 0; l < 4; ++l) {
+            uint64_t word;
+            std::memcpy(&word, p + i + l * 8, 8);
+            lanes[l] = round64(lanes[l], word);
+        }
+    }
+
+    uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+    h = round64(h, bytes);
+    for (; i < bytes; ++i) {
+        h = round64(h, p[i]);
+    }
+    return avalanche(h);
+}
+
+} // namespace
+
+ResultCache::KeyBuilder::KeyBuilder(const std::string& operation) : state_(kPrime3) {
+    add(operation);
+}
+
+ResultCache::KeyBuilder& ResultCache::KeyBuilder::add(Key value) {
+    state_ = round64(state_, value);
+    return *this;
+}
+
+ResultCache::KeyBuilder& ResultCache::KeyBuilder::add(int value) {
+    return add(static_cast<Key>(static_cast<int64_t>(value)));
+}
+
+ResultCache::KeyBuilder& ResultCache::KeyBuilder::add(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return add(static_cast<Key>(bits));
+}
+
+ResultCache::KeyBuilder& ResultCache::KeyBuilder::add(const std::string& value) {
+    return add(hashBytes(value.data(), value.size(), 0));
+}
+
+ResultCache::Key ResultCache::KeyBuilder::key() const {
+    return avalanche(state_);
+}
+
+ResultCache::ResultCache(size_t memory_budget)
+    : memory_(memory_budget), disk_budget_bytes_(0), disk_used_bytes_(0), disk_generation_(0) {
+}
+
+ResultCache::Key ResultCache::hashImage(const ImageData& image) {
+    size_t count = image.data.size();
+    int blocks = static_cast<int>((count + kHashBlock - 1) / kHashBlock);
+    std::vector<uint64_t> block_hashes(blocks);
+
+    parallelFor(0, blocks, [&](int b_begin, int b_end) {
+        for (int b = b_begin; b < b_end; ++b) {
+            size_t begin = static_cast<size_t>(b) * kHashBlock;
+            size_t end = std::min(count, begin + kHashBlock);
+            block_hashes[b] = hashBytes(image.data.data() + begin, (end - begin) * sizeof(float), b);
+        }
+    });
+
+    KeyBuilder builder("image");
+    builder.add(image.width).add(image.height).add(image.channels).add(static_cast<int>(image.layout));
+    builder.add(image.x_offset).add(image.y_offset);
+    builder.add(image.display_window.min.x).add(image.display_window.min.y);
+    builder.add(image.display_window.max.x).add(image.display_window.max.y);
+    for (uint64_t h : block_hashes) {
+        builder.add(h);
+    }
+    return builder.key();
+}
+
+ResultCache::Key ResultCache::hashSamples(const float* samples, size_t count, Key seed) {
+    return hashBytes(samples, count * sizeof(float), seed);
+}
+
+ResultCache::Key ResultCache::hashFile(const std::string& path) {
+    KeyBuilder builder("file");
+    builder.add(path);
+
+    // Seconds alone miss a rewrite of the same size within one second, which
+    // renders of fixed-size frames do all the time
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+#ifdef __APPLE__
+        long nanoseconds = info.st_mtimespec.tv_nsec;
+#else
+        long nanoseconds = info.st_mtim.tv_nsec;
+#endif
+        builder.add(static_cast<Key>(info.st_size)).add(static_cast<Key>(info.st_mtime))
+               .add(static_cast<Key>(nanoseconds));
+    }
+    return builder.key();
+}
+
+ResultCache::ResultPtr ResultCache::find(Key key) {
+    if (ResultPtr result = memory_.find(keyString(key))) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.memory_hits;
+        return result;
+    }
+
+    ResultPtr result = readBlob(key);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (result) {
+            ++stats_.disk_hits;
+        } else {
+            ++stats_.misses;
+        }
+    }
+
+    if (result) {
+        memory_.insert(keyString(key), result);
+    }
+    return result;
+}
+
+void ResultCache::insert(Key key, ResultPtr result) {
+    if (!result) return;
+    memory_.insert(keyString(key), result);
+    writeBlob(key, *result);
+}
+
+void ResultCache::insert(Key key, const ImageData& result) {
+    insert(key, std::make_shared<const ImageData>(result));
+}
+
+void ResultCache::getOrCompute(Key key, ImageData& output, const std::function<void(ImageData&)>& compute) {
+    if (ResultPtr cached = find(key)) {
+        output = *cached;
+        return;
+    }
+
+    compute(output);
+    insert(key, output);
+}
+
+bool ResultCache::setDiskCache(const std::string& directory, size_t budget_bytes) {
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        std::cerr << "Result cache directory does not exist: " << directory << std::endl;
+        return false;
+    }
+
+    // Adopt blobs from earlier runs, most recently used (touched) first
+    std::vector<std::pair<time_t, std::pair<Key, size_t>>> found;
+    size_t suffix_length = sizeof(kBlobSuffix) - 1;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() != 16 + suffix_length || name.compare(16, suffix_length, kBlobSuffix) != 0) continue;
+
+        struct stat info;
+        std::string path = directory + "/" + name;
+        if (stat(path.c_str(), &info) != 0) continue;
+
+        Key key = std::strtoull(name.substr(0, 16).c_str(), nullptr, 16);
+        found.push_back({info.st_mtime, {key, static_cast<size_t>(info.st_size)}});
+    }
+    closedir(dir);
+
+    std::sort(found.begin(), found.end(),
+              [](const std::pair<time_t, std::pair<Key, size_t>>& a,
+                 const std::pair<time_t, std::pair<Key, size_t>>& b) { return a.first > b.first; });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    disk_directory_ = directory;
+    disk_budget_bytes_ = budget_bytes;
+    disk_entries_.clear();
+    disk_index_.clear();
+    disk_writing_.clear();
+    disk_used_bytes_ = 0;
+    ++disk_generation_;
+
+    for (const auto& blob : found) {
+        disk_entries_.push_back(blob.second);
+        disk_index_[blob.second.first] = std::prev(disk_entries_.end());
+        disk_used_bytes_ += blob.second.second;
+    }
+    evictDiskToFit(0);
+    return true;
+}
+
+void ResultCache::disableDiskCache() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    disk_directory_.clear();
+    disk_entries_.clear();
+    disk_index_.clear();
+    disk_writing_.clear();
+    disk_used_bytes_ = 0;
+    ++disk_generation_;
+}
+
+bool ResultCache::diskCacheEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !disk_directory_.empty();
+}
+
+size_t ResultCache::diskBytesUsed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return disk_used_bytes_;
+}
+
+ResultCache::Stats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ResultCache::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ = Stats();
+}
+
+std::string ResultCache::keyString(Key key) {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return name;
+}
+
+std::string ResultCache::blobPath(Key key) const {
+    return disk_directory_ + "/" + keyString(key) + kBlobSuffix;
+}
+
+// Only the index is touched under mutex_; files are read and written outside
+// it, so a large blob never holds up lookups and inserts on other threads
+
+ResultCache::ResultPtr ResultCache::readBlob(Key key) {
+    std::string path;
+    size_t bytes;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = disk_index_.find(key);
+        if (it == disk_index_.end()) return nullptr;
+        path = blobPath(key);
+        bytes = it->second->second;
+        generation = disk_generation_;
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    BlobHeader header;
+    bool ok = file && std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, kBlobMagic, sizeof(kBlobMagic)) == 0 &&
+              header.width >= 0 && header.height >= 0 && header.channels >= 0 &&
+              (header.layout == static_cast<int32_t>(PixelLayout::INTERLEAVED) ||
+               header.layout == static_cast<int32_t>(PixelLayout::PLANAR));
+
+    // The header must describe exactly the samples the file holds, checked
+    // before anything is allocated so a corrupt header cannot ask for gigabytes
+    if (ok) {
+        uint64_t pixels = static_cast<uint64_t>(header.width) * static_cast<uint64_t>(header.height);
+        uint64_t stored = (bytes >= sizeof(BlobHeader)) ? (bytes - sizeof(BlobHeader)) / sizeof(float) : 0;
+        ok = (header.channels == 0 || pixels <= stored / header.channels) &&
+             sizeof(BlobHeader) + pixels * header.channels * sizeof(float) == bytes;
+    }
+
+    std::shared_ptr<ImageData> result;
+    if (ok) {
+        result = std::make_shared<ImageData>(header.width, header.height, header.channels,
+                                             static_cast<PixelLayout>(header.layout));
+        result->x_offset = header.x_offset;
+        result->y_offset = header.y_offset;
+        result->display_window = Imath::Box2i(Imath::V2i(header.display[0], header.display[1]),
+                                              Imath::V2i(header.display[2], header.display[3]));
+        ok = std::fread(result->data.data(), sizeof(float), result->data.size(), file) == result->data.size();
+    }
+    if (file) std::fclose(file);
+    if (ok) utime(path.c_str(), nullptr);
+
+    // The entry may have been evicted, or the directory replaced, meanwhile
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = (generation == disk_generation_) ? disk_index_.find(key) : disk_index_.end();
+    if (!ok) {
+        // Unreadable or truncated blobs are dropped rather than served
+        if (it != disk_index_.end()) {
+            disk_used_bytes_ -= it->second->second;
+            disk_entries_.erase(it->second);
+            disk_index_.erase(it);
+            std::remove(path.c_str());
+        }
+        return nullptr;
+    }
+
+    if (it != disk_index_.end()) {
+        disk_entries_.splice(disk_entries_.begin(), disk_entries_, it->second);
+    }
+    return result;
+}
+
+void ResultCache::writeBlob(Key key, const ImageData& result) {
+    size_t bytes = sizeof(BlobHeader) + result.data.size() * sizeof(float);
+    std::string path;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (disk_directory_.empty() || bytes > disk_budget_bytes_ || disk_index_.count(key) ||
+            !disk_writing_.insert(key).second) {
+            return;
+        }
+        // The room is taken now, so writers running side by side stay inside the budget
+        evictDiskToFit(bytes);
+        disk_used_bytes_ += bytes;
+        path = blobPath(key);
+        generation = disk_generation_;
+    }
+
+    BlobHeader header;
+    std::memcpy(header.magic, kBlobMagic, sizeof(kBlobMagic));
+    header.width = result.width;
+    header.height = result.height;
+    header.channels = result.channels;
+    header.layout = static_cast<int32_t>(result.layout);
+    header.x_offset = result.x_offset;
+    header.y_offset = result.y_offset;
+    header.display[0] = result.display_window.min.x;
+    header.display[1] = result.display_window.min.y;
+    header.display[2] = result.display_window.max.x;
+    header.display[3] = result.display_window.max.y;
+
+    // Written under a temporary name so a crash never leaves a partial blob
+    // behind, and readers never see one being written
+    std::string temp_path = path + ".tmp";
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    bool ok = file && std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(result.data.data(), sizeof(float), result.data.size(), file) == result.data.size();
+    if (file && std::fclose(file) != 0) ok = false;
+
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write result cache blob: " << path << std::endl;
+        std::remove(temp_path.c_str());
+        ok = false;
+    }
+
+    // A replaced directory dropped the reservation along with its entries
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation != disk_generation_) return;
+    disk_writing_.erase(key);
+    if (!ok) {
+        disk_used_bytes_ -= bytes;
+        return;
+    }
+    disk_entries_.emplace_front(key, bytes);
+    disk_index_[key] = disk_entries_.begin();
+}
+
+void ResultCache::evictDiskToFit(size_t incoming) {
+    while (!disk_entries_.empty() && disk_used_bytes_ + incoming > disk_budget_bytes_) {
+        Key victim = disk_entries_.back().first;
+        disk_used_bytes_ -= disk_entries_.back().second;
+        std::remove(blobPath(victim).c_str());
+        disk_index_.erase(victim);
+        disk_entries_.pop_back();
+        ++stats_.disk_evictions;
+    }
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,241 @@
+#include "sequence_player.h"
+#include "batch_processor.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace ImageProcessing {
+
+SequencePlayer::SequencePlayer(size_t cache_budget_bytes, int decode_threads)
+    : cache_(cache_budget_bytes), first_frame_(0), step_(1), fps_(24.0), loop_(true), prefetch_(16),
+      playing_(false), position_(0), shown_index_(-1), shown_tick_(-1), lookup_tick_(-1),
+      play_start_index_(0), shown_count_(0), dropped_count_(0),
+      frame_bytes_(0), stopping_(false), decode_threads_(std::max(1, decode_threads)) {
+}
+
+SequencePlayer::~SequencePlayer() {
+    close();
+}
+
+bool SequencePlayer::open(const std::string& pattern, int first_frame, int last_frame, int step) {
+    close();
+
+    paths_ = BatchProcessor::expandFramePattern(pattern, first_frame, last_frame, step);
+    if (paths_.empty()) {
+        std::cerr << "Empty frame range for sequence: " << pattern << std::endl;
+        return false;
+    }
+
+    first_frame_ = first_frame;
+    step_ = std::max(1, step);
+    position_ = 0;
+    shown_index_ = -1;
+    playing_ = false;
+    resetStats();
+
+    startWorkers(decode_threads_);
+    schedulePrefetch();
+    return true;
+}
+
+void SequencePlayer::close() {
+    stopWorkers();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    paths_.clear();
+    requests_.clear();
+    in_flight_.clear();
+    failed_.clear();
+    frame_bytes_ = 0;
+    cache_.clear();
+}
+
+void SequencePlayer::play() {
+    if (paths_.empty() || playing_) return;
+
+    playing_ = true;
+    play_start_ = std::chrono::steady_clock::now();
+    play_start_index_ = position_;
+    shown_tick_ = -1;
+    lookup_tick_ = -1;
+}
+
+void SequencePlayer::pause() {
+    playing_ = false;
+}
+
+void SequencePlayer::seek(int index) {
+    if (paths_.empty()) return;
+
+    int count = frameCount();
+    position_ = loop_ ? ((index % count) + count) % count : std::max(0, std::min(count - 1, index));
+    if (playing_) {
+        // Restart the clock from the new position
+        playing_ = false;
+        play();
+    }
+    schedulePrefetch();
+}
+
+void SequencePlayer::stepFrames(int delta) {
+    seek(position_ + delta);
+}
+
+FrameCache::FramePtr SequencePlayer::update() {
+    if (paths_.empty()) return nullptr;
+
+    long long tick = 0;
+    if (playing_) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - play_start_).count();
+        tick = static_cast<long long>(std::floor(elapsed * fps_));
+
+        int count = frameCount();
+        long long index = play_start_index_ + tick;
+        if (!loop_ && index >= count) {
+            index = count - 1;
+            playing_ = false;
+        }
+        int due = static_cast<int>(index % count);
+        if (due != position_) {
+            position_ = due;
+            schedulePrefetch();
+        }
+    }
+
+    if (position_ == shown_index_) return nullptr;
+
+    // Only the first look at a due frame counts towards the hit rate
+    FrameCache::FramePtr frame;
+    if (!playing_ || tick != lookup_tick_) {
+        frame = cache_.find(paths_[position_]);
+        lookup_tick_ = tick;
+    } else {
+        frame = cache_.peek(paths_[position_]);
+    }
+
+    if (!frame) {
+        schedulePrefetch();
+        return nullptr;
+    }
+
+    if (playing_) {
+        dropped_count_ += static_cast<int>(std::max(0LL, tick - shown_tick_ - 1));
+    }
+    shown_tick_ = tick;
+    shown_index_ = position_;
+    ++shown_count_;
+    return frame;
+}
+
+void SequencePlayer::setFps(double fps) {
+    if (fps <= 0.0) return;
+
+    fps_ = fps;
+    if (playing_) {
+        playing_ = false;
+        play();
+    }
+}
+
+void SequencePlayer::setPrefetch(int frames) {
+    prefetch_ = std::max(1, frames);
+    schedulePrefetch();
+}
+
+SequencePlayer::Stats SequencePlayer::stats() const {
+    Stats result;
+    result.shown = shown_count_;
+    result.dropped = dropped_count_;
+    result.cache = cache_.stats();
+    return result;
+}
+
+void SequencePlayer::resetStats() {
+    shown_count_ = 0;
+    dropped_count_ = 0;
+    cache_.resetStats();
+}
+
+size_t SequencePlayer::prefetchDepth() const {
+    // Prefetching more than the cache holds would evict the frames about to play
+    size_t depth = static_cast<size_t>(prefetch_);
+    if (frame_bytes_ > 0) {
+        size_t fit = cache_.budget() / frame_bytes_;
+        depth = std::min(depth, fit > 1 ? fit - 1 : size_t(1));
+    }
+    return depth;
+}
+
+void SequencePlayer::schedulePrefetch() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (paths_.empty()) return;
+
+    // Pending requests are replaced by the window ahead of the new position, nearest first
+    requests_.clear();
+    int count = frameCount();
+    size_t depth = std::min(prefetchDepth(), static_cast<size_t>(count));
+    for (size_t i = 0; i < depth; ++i) {
+        int index = position_ + static_cast<int>(i);
+        if (index >= count) {
+            if (!loop_) break;
+            index %= count;
+        }
+        if (in_flight_.count(index) || failed_.count(index) || cache_.contains(paths_[index])) continue;
+        requests_.push_back(index);
+    }
+    cv_.notify_all();
+}
+
+void SequencePlayer::decodeLoop() {
+    EXRProcessor processor;
+
+    for (;;) {
+        int index;
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stopping_ || !requests_.empty(); });
+            if (stopping_) return;
+            index = requests_.front();
+            requests_.pop_front();
+            in_flight_.insert(index);
+            path = paths_[index];
+        }
+
+        auto image = std::make_shared<ImageData>();
+        bool ok = processor.loadEXR(path, *image);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_flight_.erase(index);
+        if (!ok) {
+            failed_.insert(index);
+            continue;
+        }
+        frame_bytes_ = FrameCache::frameBytes(*image);
+        cache_.insert(path, std::move(image));
+    }
+}
+
+void SequencePlayer::startWorkers(int count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    for (int i = 0; i < count; ++i) {
+        workers_.emplace_back(&SequencePlayer::decodeLoop, this);
+    }
+}
+
+void SequencePlayer::stopWorkers() {
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        workers.swap(workers_);
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+} // namespace ImageProcessing
@@ -0,0 +1,486 @@
+#include "thread_pool.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace ImageProcessing {
+
+namespace {
+
+// Pool and queue slot of the current thread; -1 outside pool workers
+thread_local ThreadPool* t_pool = nullptr;
+thread_local int t_index = -1;
+
+// Shared between the caller and the helper tasks of one parallelFor
+struct ParallelForState {
+    std::atomic<int> next;
+    std::atomic<int> completed;
+    int end;
+    int chunk;
+    int chunk_count;
+    const std::function<void(int, int)>* fn;
+    ThreadPool* pool;
+    int frame;          // Profiler frame of the calling thread, for helpers
+
+    // Claims chunks until none are left; returns once this thread has no more work.
+    // Helpers that start after the loop finished claim nothing and never touch fn.
+    void run() {
+        for (;;) {
+            int chunk_begin = next.fetch_add(chunk);
+            if (chunk_begin >= end) return;
+            (*fn)(chunk_begin, std::min(end, chunk_begin + chunk));
+
+            if (completed.fetch_add(1) + 1 == chunk_count) {
+                pool->signal();
+            }
+        }
+    }
+};
+
+#ifdef __linux__
+// Cores granted by the cgroup CPU quota (v2 cpu.max or v1 cfs), 0 when unlimited
+int cgroupCpuLimit() {
+    long long quota = -1;
+    long long period = 0;
+    std::ifstream v2("/sys/fs/cgroup/cpu.max");
+    std::string quota_text;
+    if (v2 >> quota_text >> period) {
+        if (quota_text != "max") quota = std::atoll(quota_text.c_str());
+    } else {
+        std::ifstream v1_quota("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+        std::ifstream v1_period("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+        if (!(v1_quota >> quota) || !(v1_period >> period)) return 0;
+    }
+    if (quota <= 0 || period <= 0) return 0;
+    return static_cast<int>(std::max(1LL, (quota + period - 1) / period));
+}
+#endif
+
+} // namespace
+
+struct TaskGroup::State {
+    std::atomic<int> pending{0};    // Tasks queued or running
+    ThreadPool* pool = nullptr;
+    int max_concurrency = 0;
+    StatePtr parent;                // Capped group this one was created in
+
+    // Capped groups only. At most max_concurrency threads are `active` for
+    // the group; its tasks wait in `tasks` for a runner, and nested work that
+    // found every slot taken waits in `waiting` for a thread already inside.
+    std::mutex mutex;
+    std::deque<ThreadPool::Task> tasks;
+    std::deque<ThreadPool::Task> waiting;
+    std::atomic<int> waiting_count{0};
+    int active = 0;
+
+    // Whether the calling thread already works for this group
+    bool entered() const {
+        for (const State* state = current().get(); state; state = state->parent.get()) {
+            if (state == this) return true;
+        }
+        return false;
+    }
+
+    // Takes a slot of `target` and of every enclosing group the calling
+    // thread is not inside yet; all of them or none
+    static bool acquire(const StatePtr& target, std::vector<StatePtr>& taken) {
+        for (StatePtr state = target; state && !state->entered(); state = state->parent) {
+            bool free;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                free = state->active < state->max_concurrency;
+                if (free) ++state->active;
+            }
+            if (!free) {
+                for (const StatePtr& held : taken) finish(held);
+                taken.clear();
+                return false;
+            }
+            taken.push_back(state);
+        }
+        return true;
+    }
+
+    // Gives a slot back, or hands it to a runner when work is queued
+    static void finish(const StatePtr& state) {
+        bool queued;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            queued = !state->tasks.empty() || !state->waiting.empty();
+            if (!queued) --state->active;
+        }
+        if (queued) startRunner(state);
+    }
+
+    // Drains the group's queues on a slot the caller already took
+    static void startRunner(const StatePtr& state) {
+        submitWithin(state->parent, *state->pool, [state]() {
+            StatePtr outer = current();
+            current() = state;
+            for (;;) {
+                ThreadPool::Task next;
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (!state->pop(next)) {
+                        --state->active;
+                        break;
+                    }
+                }
+                next();
+            }
+            current() = outer;
+        }, true);
+    }
+
+    // Next queued task, nested work first; the mutex must be held
+    bool pop(ThreadPool::Task& task) {
+        if (!waiting.empty()) {
+            task = std::move(waiting.front());
+            waiting.pop_front();
+            waiting_count.fetch_sub(1);
+            return true;
+        }
+        if (!tasks.empty()) {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    // Queues a task that has to hold a slot of `target` (null: none) to run
+    static void submitWithin(const StatePtr& target, ThreadPool& pool, ThreadPool::Task task, bool required) {
+        if (!target) {
+            pool.submit(std::move(task));
+            return;
+        }
+        pool.submit([target, task, required]() {
+            if (target->entered()) {
+                task();
+                return;
+            }
+            std::vector<StatePtr> taken;
+            if (acquire(target, taken)) {
+                StatePtr outer = current();
+                current() = target;
+                task();
+                current() = outer;
+                for (const StatePtr& held : taken) finish(held);
+            } else if (required) {
+                {
+                    std::lock_guard<std::mutex> lock(target->mutex);
+                    target->waiting.push_back(task);
+                    target->waiting_count.fetch_add(1);
+                }
+                target->pool->signal();
+            }
+        });
+    }
+};
+
+ThreadPool::ThreadPool(int worker_count) : thread_count_(1), queued_(0), stopping_(false) {
+    int threads = (worker_count > 0) ? worker_count + 1 : defaultThreadCount();
+    startWorkers(threads - 1);
+}
+
+ThreadPool::~ThreadPool() {
+    stopWorkers();
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+int ThreadPool::defaultThreadCount() {
+    if (const char* env = std::getenv("SCBW_NUM_THREADS")) {
+        int requested = std::atoi(env);
+        if (requested > 0) return requested;
+    }
+    unsigned int hardware = std::thread::hardware_concurrency();
+    int cores = hardware > 0 ? static_cast<int>(hardware) : 1;
+#ifdef __linux__
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0 && CPU_COUNT(&affinity) > 0) {
+        cores = CPU_COUNT(&affinity);
+    }
+    if (int quota = cgroupCpuLimit()) {
+        cores = std::min(cores, quota);
+    }
+#endif
+    return cores;
+}
+
+void ThreadPool::setThreadCount(int thread_count) {
+    if (thread_count <= 0) {
+        thread_count = defaultThreadCount();
+    }
+    if (thread_count == threadCount()) return;
+
+    stopWorkers();
+    startWorkers(thread_count - 1);
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& fn) {
+    if (end <= begin) return;
+    grain = std::max(1, grain);
+
+    int range = end - begin;
+    int threads = threadCount();
+
+    // Small ranges run on the calling thread
+    if (threads == 1 || range <= grain) {
+        fn(begin, end);
+        return;
+    }
+
+    // A few chunks per thread so uneven rows still balance out
+    auto state = std::make_shared<ParallelForState>();
+    state->chunk = std::max(grain, (range + threads * 4 - 1) / (threads * 4));
+    state->chunk_count = (range + state->chunk - 1) / state->chunk;
+    state->next = begin;
+    state->completed = 0;
+    state->end = end;
+    state->fn = &fn;
+    state->pool = this;
+    state->frame = Profiler::currentFrame();
+
+    // Inside a capped group a helper only runs on a free slot of the group
+    int helpers = std::min(threads - 1, state->chunk_count - 1);
+    for (int i = 0; i < helpers; ++i) {
+        TaskGroup::submit(*this, [state]() {
+            FrameScope frame_scope(state->frame);
+            state->run();
+        }, false);
+    }
+
+    state->run();
+    waitUntil([&state]() { return state->completed.load() == state->chunk_count; });
+}
+
+void ThreadPool::submit(Task task) {
+    int slot = (t_pool == this && t_index >= 0) ? t_index : static_cast<int>(queues_.size()) - 1;
+    {
+        std::lock_guard<std::mutex> lock(queues_[slot]->mutex);
+        queues_[slot]->tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+
+    // Taking the lock orders the push before a sleeper's check of queued_
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    cv_.notify_one();
+}
+
+void ThreadPool::waitUntil(const std::function<bool()>& done) {
+    int self = (t_pool == this && t_index >= 0) ? t_index : static_cast<int>(queues_.size()) - 1;
+    while (!done()) {
+        // Nested work parked on this thread's groups first: only threads
+        // inside a group may run it
+        if (TaskGroup::runWaiting(*this) || runOne(self)) continue;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&]() { return queued_.load() > 0 || TaskGroup::hasWaiting(*this) || done(); });
+    }
+}
+
+void ThreadPool::signal() {
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    cv_.notify_all();
+}
+
+bool ThreadPool::pop(int self, Task& task) {
+    int count = static_cast<int>(queues_.size());
+
+    // Newest own task first: its data is the most likely to still be in cache
+    {
+        WorkQueue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Then the oldest task of another queue, which tends to be the largest
+    for (int i = 1; i < count; ++i) {
+        WorkQueue& victim = *queues_[(self + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runOne(int self) {
+    if (queued_.load() == 0) return false;
+
+    Task task;
+    if (!pop(self, task)) return false;
+    queued_.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::startWorkers(int worker_count) {
+    worker_count = std::max(0, worker_count);
+
+    // Tasks left over from the previous workers stay on the injection queue
+    std::unique_ptr<WorkQueue> injection;
+    if (!queues_.empty()) {
+        injection = std::move(queues_.back());
+    } else {
+        injection.reset(new WorkQueue());
+    }
+    queues_.clear();
+    for (int i = 0; i < worker_count; ++i) {
+        queues_.emplace_back(new WorkQueue());
+    }
+    queues_.push_back(std::move(injection));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    thread_count_ = worker_count + 1;
+    for (int i = 0; i < worker_count; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+void ThreadPool::stopWorkers() {
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        workers.swap(workers_);
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Hand anything still queued by a worker to the injection queue
+    if (queues_.size() > 1) {
+        WorkQueue& injection = *queues_.back();
+        for (size_t i = 0; i + 1 < queues_.size(); ++i) {
+            for (Task& task : queues_[i]->tasks) {
+                injection.tasks.push_back(std::move(task));
+            }
+            queues_[i]->tasks.clear();
+        }
+    }
+    thread_count_ = 1;
+}
+
+void ThreadPool::workerLoop(int index) {
+    t_pool = this;
+    t_index = index;
+
+    for (;;) {
+        if (runOne(index)) continue;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopping_ || queued_.load() > 0; });
+        if (stopping_) return;
+    }
+}
+
+TaskGroup::TaskGroup(int max_concurrency, ThreadPool& pool)
+    : pool_(pool), max_concurrency_(std::max(0, max_concurrency)), state_(std::make_shared<State>()) {
+    state_->pool = &pool_;
+    state_->max_concurrency = max_concurrency_;
+    if (current() && current()->pool == &pool_) {
+        state_->parent = current();
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    wait();
+}
+
+TaskGroup::StatePtr& TaskGroup::current() {
+    static thread_local StatePtr state;
+    return state;
+}
+
+void TaskGroup::run(ThreadPool::Task task) {
+    StatePtr state = state_;
+    state->pending.fetch_add(1);
+    // Scopes in the task count toward the frame that queued it, whichever thread runs it
+    int frame = Profiler::currentFrame();
+    ThreadPool::Task counted = [state, task, frame]() {
+        {
+            FrameScope frame_scope(frame);
+            task();
+        }
+        if (state->pending.fetch_sub(1) == 1) state->pool->signal();
+    };
+
+    if (max_concurrency_ == 0) {
+        State::submitWithin(state->parent, pool_, std::move(counted), true);
+        return;
+    }
+
+    // A runner drains the group's queue; only max_concurrency threads work for it at once
+    bool start_runner = false;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->tasks.push_back(std::move(counted));
+        if (state->active < max_concurrency_) {
+            ++state->active;
+            start_runner = true;
+        }
+    }
+    if (start_runner) State::startRunner(state);
+}
+
+void TaskGroup::wait() {
+    std::shared_ptr<State> state = state_;
+    pool_.waitUntil([&state]() { return state->pending.load() == 0; });
+}
+
+void TaskGroup::submit(ThreadPool& pool, ThreadPool::Task task, bool required) {
+    StatePtr target = current();
+    if (target && target->pool != &pool) target.reset();
+    State::submitWithin(target, pool, std::move(task), required);
+}
+
+bool TaskGroup::runWaiting(ThreadPool& pool) {
+    for (StatePtr state = current(); state; state = state->parent) {
+        if (state->pool != &pool || state->waiting_count.load() == 0) continue;
+
+        ThreadPool::Task next;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->waiting.empty()) continue;
+            next = std::move(state->waiting.front());
+            state->waiting.pop_front();
+            state->waiting_count.fetch_sub(1);
+        }
+        next();
+        return true;
+    }
+    return false;
+}
+
+bool TaskGroup::hasWaiting(ThreadPool& pool) {
+    for (const State* state = current().get(); state; state = state->parent.get()) {
+        if (state->pool == &pool && state->waiting_count.load() > 0) return true;
+    }
+    return false;
+}
+
+void parallelFor(int begin, int end, const std::function<void(int, int)>& fn, int grain) {
+    ThreadPool::global().parallelFor(begin, end, grain, fn);
+}
+
+} // namespace ImageProcessing
@@ -114,10 +114,14 @@ void Viewer::set_window_size(int width, int height) {
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "viewer.h"
+#include "profiler.h"
 
 Viewer::Viewer() 
     : initialized_(false), shader_program_(0), vao_(0), vbo_(0), ebo_(0), 
-      texture_id_(0), exposure_(1.0f), gamma_(2.2f), show_tonemapped_(true) {
+      exposure_(1.0f), gamma_(2.2f), show_tonemapped_(true), lut_texture_(0),
+      gpu_enabled_(false), gpu_active_(false),
+      history_(std::make_shared<ImageProcessing::ImageHistory>()), preview_generation_(0), preview_steps_(0), preview_level_(0),
+      proxy_filter_(ImageProcessing::ResampleFilter::BOX), window_width_(0), window_height_(0) {
     
     // Vertex shader source
     vertex_shader_source_ = R"(
@@ -144,6 +148,12 @@ Viewer::Viewer()
         uniform float exposure;
         uniform float gamma;
         uniform bool showTonemapped;
+        uniform int lutType;        // 0 none, 1 per-channel 1D, 2 3D
+        uniform int lutSize;
+        uniform vec3 lutDomainMin;
+        uniform vec3 lutDomainMax;
+        uniform sampler2D lut1d;
+        uniform sampler3D lut3d;
         
         vec3 tonemap(vec3 color) {
             // Simple Reinhard tonemapping
@@ -152,11 +162,23 @@ Viewer::Viewer()
             return pow(color, vec3(1.0 / gamma));
         }
         
+        // Texel centres, so GL_LINEAR filtering matches ColorLUT::lookup
+        vec3 applyLUT(vec3 color) {
+            vec3 t = clamp((color * exposure - lutDomainMin) / (lutDomainMax - lutDomainMin), 0.0, 1.0);
+            vec3 coord = (t * float(lutSize - 1) + 0.5) / float(lutSize);
+            if (lutType == 2) {
+                return texture(lut3d, coord).rgb;
+            }
+            return vec3(texture(lut1d, vec2(coord.r, 0.5)).r,
+                        texture(lut1d, vec2(coord.g, 0.5)).g,
+                        texture(lut1d, vec2(coord.b, 0.5)).b);
+        }
+        
         void main() {
             vec4 texColor = texture(imageTexture, TexCoord);
             
             if (showTonemapped) {
-                vec3 tonemapped = tonemap(texColor.rgb);
+                vec3 tonemapped = (lutType != 0) ? applyLUT(texColor.rgb) : tonemap(texColor.rgb);
                 FragColor = vec4(tonemapped, texColor.a);
             } else {
                 FragColor = texColor;
@@ -182,8 +204,11 @@ void Viewer::initialize() {
     // Setup quad for rendering
     setupQuad();
     
-    // Create texture
-    glGenTextures(1, &texture_id_);
+    // Texture storage is created on the first upload
+    texture_.initialize();
+    overlay_texture_.initialize(1);
+    gpu_enabled_ = gpu_.initialize();
+    uploadDisplayLUT();
     
     initialized_ = true;
     std::cout << "Viewer initialized with EXR processing support" << std::endl;
@@ -191,6 +216,18 @@ void Viewer::initialize() {
 
 void Viewer::render() {
     if (!initialized_) return;
+    ImageProcessing::ProfileScope scope("viewer.render");
+    
+    // Sequence frames are swapped in without waiting on decodes
+    if (player_) {
+        if (ImageProcessing::FrameCache::FramePtr frame = player_->update()) {
+            playback_frame_ = frame;
+            refreshPreview();
+        }
+    }
+    
+    // Finished previews are swapped in here; the draw below never waits for one
+    collectPreview();
     
     glUseProgram(shader_program_);
     
@@ -199,9 +236,19 @@ void Viewer::render() {
     
     // Bind texture
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glBindTexture(GL_TEXTURE_2D, gpu_active_ ? gpu_.resultTexture() : texture_.textureId());
     glUniform1i(glGetUniformLocation(shader_program_, "imageTexture"), 0);
     
+    // 1D and 3D LUT samplers get their own units; sampler types may not share one
+    if (lut_texture_) {
+        bool is_3d = display_lut_.type() == ImageProcessing::ColorLUT::LUT_3D;
+        glActiveTexture(is_3d ? GL_TEXTURE3 : GL_TEXTURE2);
+        glBindTexture(is_3d ? GL_TEXTURE_3D : GL_TEXTURE_2D, lut_texture_);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glUniform1i(glGetUniformLocation(shader_program_, "lut1d"), 2);
+    glUniform1i(glGetUniformLocation(shader_program_, "lut3d"), 3);
+    
     // Draw quad
     glBindVertexArray(vao_);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
@@ -221,9 +268,17 @@ void Viewer::cleanup() {
         glDeleteBuffers(1, &ebo_);
         ebo_ = 0;
     }
-    if (texture_id_) {
-        glDeleteTextures(1, &texture_id_);
-        texture_id_ = 0;
+    player_.reset();
+    playback_frame_.reset();
+    preview_worker_.cancel();
+    preview_.reset();
+    texture_.cleanup();
+    overlay_texture_.cleanup();
+    gpu_.cleanup();
+    gpu_active_ = false;
+    if (lut_texture_) {
+        glDeleteTextures(1, &lut_texture_);
+        lut_texture_ = 0;
     }
     if (shader_program_) {
         glDeleteProgram(shader_program_);
@@ -245,14 +300,81 @@ bool Viewer::loadEXRImage(const std::string& filepath) {
         return false;
     }
     
-    current_image_ = std::move(image);
-    loadImageToTexture(current_image_);
+    current_image_ = std::make_shared<const ImageData>(std::move(image));
+    player_.reset();
+    playback_frame_.reset();
+    edits_.clear();
+    redo_.clear();
+    refreshPreview();
     
     std::cout << "Loaded EXR image: " << filepath 
-              << " (" << current_image_.width << "x" << current_image_.height << ")" << std::endl;
+              << " (" << current_image_->width << "x" << current_image_->height << ")" << std::endl;
     return true;
 }
 
+bool Viewer::loadSequence(const std::string& pattern, int first_frame, int last_frame, double fps) {
+    using namespace ImageProcessing;
+    
+    std::unique_ptr<SequencePlayer> player(new SequencePlayer());
+    if (!player->open(pattern, first_frame, last_frame)) {
+        return false;
+    }
+    player->setFps(fps);
+    
+    player_ = std::move(player);
+    playback_frame_.reset();
+    edits_.clear();
+    redo_.clear();
+    history_->clear();
+    gpu_active_ = false;
+    
+    std::cout << "Loaded sequence: " << pattern << " [" << first_frame << "-" << last_frame
+              << "] at " << fps << " fps" << std::endl;
+    return true;
+}
+
+void Viewer::togglePlayback() {
+    if (!player_) return;
+    
+    if (player_->playing()) {
+        player_->pause();
+        printPlaybackStats();
+    } else {
+        player_->play();
+    }
+}
+
+void Viewer::stepFrame(int delta) {
+    if (!player_) return;
+    
+    player_->pause();
+    player_->stepFrames(delta);
+}
+
+void Viewer::printPlaybackStats() const {
+    if (!player_) return;
+    
+    ImageProcessing::SequencePlayer::Stats stats = player_->stats();
+    std::cout << "Frame " << player_->currentFrame() << ": shown " << stats.shown
+              << ", dropped " << stats.dropped
+              << ", cache hit rate " << stats.cache.hitRate() * 100.0 << "%"
+              << " (" << player_->cache().size() << " frames, "
+              << player_->cache().bytesUsed() / (1024 * 1024) << " MB)" << std::endl;
+}
+
+void Viewer::setWindowSize(int width, int height) {
+    window_width_ = width;
+    window_height_ = height;
+    
+    // Only a change of pyramid level needs the preview rebuilt
+    ImageProcessing::FrameCache::FramePtr source = sourceFrame();
+    if (!source) return;
+    int level = ImageProcessing::ImagePyramid::levelForSize(source->width, source->height, width, height);
+    if (level != preview_level_) {
+        refreshPreview();
+    }
+}
+
 void Viewer::setExposure(float exposure) {
     exposure_ = exposure;
 }
@@ -265,44 +387,333 @@ void Viewer::toggleTonemapping() {
     show_tonemapped_ = !show_tonemapped_;
 }
 
+bool Viewer::setDisplayLUT(const std::string& cube_path) {
+    ImageProcessing::ColorLUT lut;
+    if (!lut.loadCube(cube_path)) {
+        return false;
+    }
+    display_lut_ = std::move(lut);
+    if (initialized_) {
+        uploadDisplayLUT();
+    }
+    std::cout << "Display LUT: " << (display_lut_.title().empty() ? cube_path : display_lut_.title())
+              << " (" << (display_lut_.type() == ImageProcessing::ColorLUT::LUT_3D ? "3D" : "1D")
+              << ", " << display_lut_.size() << ")" << std::endl;
+    return true;
+}
+
+void Viewer::clearDisplayLUT() {
+    display_lut_ = ImageProcessing::ColorLUT();
+    if (lut_texture_) {
+        glDeleteTextures(1, &lut_texture_);
+        lut_texture_ = 0;
+    }
+}
+
+void Viewer::uploadDisplayLUT() {
+    if (lut_texture_) {
+        glDeleteTextures(1, &lut_texture_);
+        lut_texture_ = 0;
+    }
+    if (display_lut_.empty()) return;
+    
+    // The table is already in GL order: red fastest, then green, then blue
+    GLenum target = (display_lut_.type() == ImageProcessing::ColorLUT::LUT_3D) ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+    int n = display_lut_.size();
+    glGenTextures(1, &lut_texture_);
+    glBindTexture(target, lut_texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (target == GL_TEXTURE_3D) {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB32F, n, n, n, 0, GL_RGB, GL_FLOAT, display_lut_.table().data());
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, n, 1, 0, GL_RGB, GL_FLOAT, display_lut_.table().data());
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(target, 0);
+}
+
+void Viewer::setProxyFilter(ImageProcessing::ResampleFilter filter) {
+    if (filter == proxy_filter_) return;
+    proxy_filter_ = filter;
+    refreshPreview();
+}
+
+void Viewer::setHalfFloatUpload(bool enabled) {
+    texture_.setUploadFormat(enabled ? TextureUploadFormat::HALF16 : TextureUploadFormat::FLOAT32);
+    if (initialized_) {
+        refreshPreview();
+    }
+}
+
+bool Viewer::halfFloatUpload() const {
+    return texture_.uploadFormat() == TextureUploadFormat::HALF16;
+}
+
 void Viewer::applyFilter(const std::string& filter_type) {
+    ViewerEdit edit;
+    edit.filter = filter_type;
+    edit.exposure = exposure_;
+    edit.gamma = gamma_;
+    pushEdit(edit);
+    
+    std::cout << (gpu_active_ ? "Applied filter on GPU" : "Queued filter") << ": " << filter_type
+              << " (preview level " << preview_level_ << ")" << std::endl;
+}
+
+void Viewer::applyBlend(const ImageProcessing::ImageData& overlay,
+                        ImageProcessing::Compositor::BlendMode mode, float opacity) {
     using namespace ImageProcessing;
     
-    EXRProcessor processor;
-    ImageData filtered = current_image_;
-    
-    if (filter_type == "blur") {
-        processor.applyGaussianBlur(filtered, 2.0f);
-    } else if (filter_type == "sharpen") {
-        processor.applySharpen(filtered, 0.5f);
-    } else if (filter_type == "edges") {
-        processor.applyEdgeDetection(filtered);
-    } else if (filter_type == "tonemap") {
-        processor.applyToneMapping(filtered, exposure_, gamma_);
+    FrameCache::FramePtr source = sourceFrame();
+    if (!source || overlay.width != source->width || overlay.height != source->height) {
+        std::cerr << "Blend layer size does not match the current image" << std::endl;
+        return;
     }
     
-    current_image_ = std::move(filtered);
-    loadImageToTexture(current_image_);
-    
-    std::cout << "Applied filter: " << filter_type << std::endl;
+    ViewerEdit edit;
+    edit.filter = "blend";
+    edit.overlay = std::make_shared<const ImageData>(overlay);
+    auto pyramid = std::make_shared<ImagePyramid>();
+    pyramid->build(overlay);
+    edit.overlay_pyramid = pyramid;
+    edit.mode = mode;
+    edit.opacity = opacity;
+    pushEdit(edit);
+}
+
+void Viewer::setGPUProcessing(bool enabled) {
+    gpu_enabled_ = enabled && gpu_.available();
+    refreshPreview();
 }
 
 void Viewer::resetImage() {
-    // Reset to original loaded image
-    loadImageToTexture(current_image_);
+    // The source frame is never edited, so dropping the edits restores it
+    edits_.clear();
+    redo_.clear();
+    refreshPreview();
+}
+
+bool Viewer::undo() {
+    if (edits_.empty()) return false;
+    
+    redo_.push_back(edits_.back());
+    edits_.pop_back();
+    restartPreview();
+    std::cout << "Undo " << redo_.back().filter << " (" << edits_.size() << " edits)" << std::endl;
+    return true;
+}
+
+bool Viewer::redo() {
+    if (redo_.empty() || !sourceFrame()) return false;
+    
+    // Same chain as before the undo, so its checkpoints still apply
+    edits_.push_back(redo_.back());
+    redo_.pop_back();
+    restartPreview();
+    std::cout << "Redo " << edits_.back().filter << " (" << edits_.size() << " edits)" << std::endl;
+    return true;
+}
+
+void Viewer::setHistoryBudget(size_t bytes) {
+    history_->setBudget(bytes);
 }
 
 void Viewer::saveCurrentImage(const std::string& filepath) {
     using namespace ImageProcessing;
     
+    // Export is the only place the full-resolution result is produced
+    ImageData full;
+    renderFullResolution(full);
+    
     EXRProcessor processor;
-    if (processor.saveEXR(filepath, current_image_)) {
+    if (processor.saveEXR(filepath, full)) {
         std::cout << "Saved image to: " << filepath << std::endl;
     } else {
         std::cerr << "Failed to save image to: " << filepath << std::endl;
     }
 }
 
+ImageProcessing::FrameCache::FramePtr Viewer::sourceFrame() const {
+    return playback_frame_ ? playback_frame_ : current_image_;
+}
+
+void Viewer::pushEdit(const ViewerEdit& edit) {
+    if (!sourceFrame()) return;
+    
+    // A new edit after an undo starts another branch; checkpoints past this point belong to the old one
+    if (!redo_.empty()) {
+        redo_.clear();
+        history_->truncate(edits_.size());
+    }
+    edits_.push_back(edit);
+    
+    // The GPU runs only the new edit on the resident frame, in the render thread's context
+    if (gpu_enabled_) {
+        // Still reducing the source; collectPreview() replays the edit list when it arrives
+        if (!preview_) return;
+        if (!gpu_active_ && preview_steps_ + 1 == edits_.size()) {
+            gpu_active_ = gpu_.setSource(texture_.textureId(), preview_->width, preview_->height, preview_->channels);
+        }
+        if (gpu_active_ && applyEditOnGPU(edit, preview_level_)) return;
+    }
+    
+    // Extends the current generation, so the worker only runs the edits it has not applied
+    gpu_active_ = false;
+    submitPreview(true);
+}
+
+void Viewer::refreshPreview() {
+    using namespace ImageProcessing;
+    
+    // Checkpoints are of the old frame or level
+    history_->clear();
+    FrameCache::FramePtr source = sourceFrame();
+    if (source) {
+        // Filters and display work on the smallest level that still fills the window
+        preview_level_ = ImagePyramid::levelForSize(source->width, source->height, window_width_, window_height_);
+    }
+    restartPreview();
+}
+
+void Viewer::restartPreview() {
+    // Every earlier job is stale; the old frame stays on screen until the new one is ready
+    ++preview_generation_;
+    preview_.reset();
+    preview_steps_ = 0;
+    if (!sourceFrame()) {
+        preview_worker_.cancel();
+        gpu_active_ = false;
+        return;
+    }
+    submitPreview(!gpu_enabled_);
+}
+
+void Viewer::submitPreview(bool cpu_edits) {
+    ImageProcessing::PreviewWorker::Request request;
+    request.generation = preview_generation_;
+    request.source = sourceFrame();
+    request.level = preview_level_;
+    request.reduce_filter = proxy_filter_;
+    if (cpu_edits) {
+        // Each step leaves a checkpoint; a restarted generation resumes from the deepest one
+        std::shared_ptr<ImageProcessing::ImageHistory> history = history_;
+        uint64_t epoch = history->epoch();
+        int level = preview_level_;
+        for (size_t i = 0; i < edits_.size(); ++i) {
+            ViewerEdit edit = edits_[i];
+            request.steps.push_back([edit, level, history, epoch, i](ImageProcessing::ImageData& image) {
+                applyEdit(edit, image, level);
+                history->store(epoch, i + 1, image);
+            });
+        }
+        size_t count = edits_.size();
+        request.resume = [history, count](ImageProcessing::ImageData& image) -> size_t {
+            size_t steps = 0;
+            return history->restore(count, steps, image) ? steps : 0;
+        };
+    }
+    preview_worker_.submit(std::move(request));
+}
+
+void Viewer::collectPreview() {
+    using namespace ImageProcessing;
+    
+    PreviewWorker::Result result;
+    if (!preview_worker_.takeResult(result) || result.generation != preview_generation_) return;
+    
+    ProfileScope scope("viewer.collect_preview");
+    preview_ = result.image;
+    preview_steps_ = result.steps;
+    gpu_active_ = false;
+    loadImageToTexture(*preview_);
+    
+    // Edits the worker did not run go to the GPU; if it refuses one, the worker takes them all
+    if (gpu_enabled_ && preview_steps_ < edits_.size()) {
+        gpu_active_ = gpu_.setSource(texture_.textureId(), preview_->width, preview_->height, preview_->channels);
+        for (size_t i = preview_steps_; gpu_active_ && i < edits_.size(); ++i) {
+            gpu_active_ = applyEditOnGPU(edits_[i], preview_level_);
+        }
+        if (!gpu_active_) {
+            submitPreview(true);
+        }
+    }
+}
+
+void Viewer::applyEdit(const ViewerEdit& edit, ImageProcessing::ImageData& image, int level) {
+    using namespace ImageProcessing;
+    
+    ProfileScope scope("viewer.apply_edit", image);
+    
+    // Radii are given at full resolution and shrink with the preview level
+    float scale = 1.0f / static_cast<float>(1 << level);
+    EXRProcessor processor;
+    
+    if (edit.filter == "blur") {
+        ImageFilters::gaussianBlur(image, 2.0f * scale);
+    } else if (edit.filter == "sharpen") {
+        ImageFilters::unsharpMask(image, 1.0f * scale, 0.5f, 0.0f); // EXRProcessor::applySharpen at level 0
+    } else if (edit.filter == "edges") {
+        processor.applyEdgeDetection(image);
+    } else if (edit.filter == "tonemap") {
+        processor.applyToneMapping(image, edit.exposure, edit.gamma);
+    } else if (edit.filter == "blend" && edit.overlay) {
+        ImageData blended;
+        if (level > 0 && edit.overlay_pyramid) {
+            Compositor::blend(image, edit.overlay_pyramid->level(level), blended, edit.mode, edit.opacity);
+        } else {
+            Compositor::blend(image, *edit.overlay, blended, edit.mode, edit.opacity);
+        }
+        image = std::move(blended);
+    }
+}
+
+bool Viewer::applyEditOnGPU(const ViewerEdit& edit, int level) {
+    using namespace ImageProcessing;
+    
+    float scale = 1.0f / static_cast<float>(1 << level);
+    
+    if (edit.filter == "blur") {
+        gpu_.gaussianBlur(2.0f * scale);
+    } else if (edit.filter == "sharpen") {
+        gpu_.unsharpMask(1.0f * scale, 0.5f, 0.0f);
+    } else if (edit.filter == "edges") {
+        gpu_.sobelEdgeDetection();
+    } else if (edit.filter == "tonemap") {
+        gpu_.toneMapping(edit.exposure, edit.gamma);
+    } else if (edit.filter == "blend" && edit.overlay) {
+        bool uploaded;
+        if (level > 0 && edit.overlay_pyramid) {
+            uploaded = overlay_texture_.upload(edit.overlay_pyramid->level(level));
+        } else {
+            uploaded = overlay_texture_.upload(*edit.overlay);
+        }
+        if (!uploaded) return false;
+        gpu_.blend(overlay_texture_.textureId(), std::min(edit.overlay->channels, 4), edit.mode, edit.opacity);
+    }
+    return true;
+}
+
+void Viewer::renderFullResolution(ImageProcessing::ImageData& output) {
+    ImageProcessing::FrameCache::FramePtr source = sourceFrame();
+    if (!source) return;
+    
+    // A full-resolution GPU frame already holds the result; otherwise replay the edits
+    if (gpu_active_ && preview_ && preview_level_ == 0) {
+        gpu_.readback(output, source->layout);
+        return;
+    }
+    
+    // Export needs the full frame before it returns, so it does not go through the worker
+    output = *source;
+    for (const auto& edit : edits_) {
+        applyEdit(edit, output, 0);
+    }
+}
+
 unsigned int Viewer::compileShader(unsigned int type, const std::string& source) {
     unsigned int shader = glCreateShader(type);
     const char* src = source.c_str();
@@ -391,27 +802,27 @@ void Viewer::setupQuad() {
 
 void Viewer::loadImageToTexture(const ImageProcessing::ImageData& image) {
     if (image.data.empty()) return;
+    ImageProcessing::ProfileScope scope("viewer.upload");
+    scope.addImageRead(image);
+    scope.addPixels(static_cast<uint64_t>(image.width) * image.height);
     
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
-    
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    // Upload texture data
-    GLenum format = (image.channels == 4) ? GL_RGBA : 
-                   (image.channels == 3) ? GL_RGB : 
-                   (image.channels == 1) ? GL_RED : GL_RGBA;
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, image.width, image.height, 0, format, GL_FLOAT, image.data.data());
-    
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // Reuses the texture storage and streams through the PBO ring
+    if (!texture_.upload(image)) {
+        std::cerr << "Failed to upload image to texture" << std::endl;
+    }
 }
 
 void Viewer::updateUniforms() {
     glUniform1f(glGetUniformLocation(shader_program_, "exposure"), exposure_);
     glUniform1f(glGetUniformLocation(shader_program_, "gamma"), gamma_);
     glUniform1i(glGetUniformLocation(shader_program_, "showTonemapped"), show_tonemapped_);
+    
+    int lut_type = 0;
+    if (lut_texture_) {
+        lut_type = (display_lut_.type() == ImageProcessing::ColorLUT::LUT_3D) ? 2 : 1;
+        glUniform1i(glGetUniformLocation(shader_program_, "lutSize"), display_lut_.size());
+        glUniform3fv(glGetUniformLocation(shader_program_, "lutDomainMin"), 1, display_lut_.domainMin());
+        glUniform3fv(glGetUniformLocation(shader_program_, "lutDomainMax"), 1, display_lut_.domainMax());
+    }
+    glUniform1i(glGetUniformLocation(shader_program_, "lutType"), lut_type);
 }
\ No newline at end of file
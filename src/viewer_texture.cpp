@@ -0,0 +1,229 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <glad/glad.h>
+#include "viewer_texture.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Channel count sent to GL; extra channels beyond RGBA are not displayed
+int uploadChannels(const ImageProcessing::ImageData& image) {
+    return std::min(image.channels, 4);
+}
+
+GLenum pixelFormat(int channels) {
+    return (channels == 4) ? GL_RGBA :
+           (channels == 3) ? GL_RGB :
+           (channels == 2) ? GL_RG : GL_RED;
+}
+
+// Writes interleaved rows of the first `channels` channels into the mapped buffer
+void packRows(const ImageProcessing::ImageData& image, int channels, float* dst) {
+    using namespace ImageProcessing;
+    size_t row_samples = static_cast<size_t>(image.width) * channels;
+
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            float* out = dst + y * row_samples;
+            if (image.layout == PixelLayout::INTERLEAVED && channels == image.channels) {
+                std::memcpy(out, &image.data[image.index(0, y, 0)], row_samples * sizeof(float));
+                continue;
+            }
+            for (int x = 0; x < image.width; ++x) {
+                for (int c = 0; c < channels; ++c) {
+                    out[x * channels + c] = image(x, y, c);
+                }
+            }
+        }
+    });
+}
+
+void packRows(const ImageProcessing::ImageData& image, int channels, half* dst) {
+    using namespace ImageProcessing;
+    size_t row_samples = static_cast<size_t>(image.width) * channels;
+
+    parallelFor(0, image.height, [&](int y_begin, int y_end) {
+        std::vector<float> row(row_samples);
+        for (int y = y_begin; y < y_end; ++y) {
+            const float* src = &image.data[image.index(0, y, 0)];
+            if (image.layout != PixelLayout::INTERLEAVED || channels != image.channels) {
+                for (int x = 0; x < image.width; ++x) {
+                    for (int c = 0; c < channels; ++c) {
+                        row[x * channels + c] = image(x, y, c);
+                    }
+                }
+                src = row.data();
+            }
+            floatToHalf(src, dst + y * row_samples, row_samples);
+        }
+    });
+}
+
+} // namespace
+
+StreamingTexture::StreamingTexture()
+    : next_(0), texture_id_(0), width_(0), height_(0),
+      format_(TextureUploadFormat::FLOAT32), storage_format_(TextureUploadFormat::FLOAT32),
+      persistent_(false), immutable_storage_(false) {
+}
+
+StreamingTexture::~StreamingTexture() {
+    cleanup();
+}
+
+void StreamingTexture::initialize(int ring_size) {
+    cleanup();
+
+    persistent_ = GLAD_GL_VERSION_4_4 != 0;
+    immutable_storage_ = GLAD_GL_VERSION_4_2 != 0;
+    ring_.resize(std::max(1, ring_size));
+    next_ = 0;
+
+    if (!persistent_) {
+        std::cout << "Persistent buffer mapping unavailable, using orphaned PBO uploads" << std::endl;
+    }
+}
+
+void StreamingTexture::cleanup() {
+    for (auto& slot : ring_) {
+        releaseBuffer(slot);
+    }
+    ring_.clear();
+
+    if (texture_id_) {
+        glDeleteTextures(1, &texture_id_);
+        texture_id_ = 0;
+    }
+    width_ = height_ = 0;
+}
+
+bool StreamingTexture::upload(const ImageProcessing::ImageData& image) {
+    if (image.data.empty() || ring_.empty()) return false;
+
+    int channels = uploadChannels(image);
+    bool use_half = format_ == TextureUploadFormat::HALF16;
+    size_t sample_bytes = use_half ? sizeof(half) : sizeof(float);
+    size_t bytes = static_cast<size_t>(image.width) * image.height * channels * sample_bytes;
+
+    ensureStorage(image.width, image.height, format_);
+
+    UploadBuffer& slot = ring_[next_];
+    next_ = (next_ + 1) % ring_.size();
+
+    void* dst = acquireBuffer(slot, bytes);
+    if (!dst) {
+        std::cerr << "Failed to map texture upload buffer" << std::endl;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+
+    if (use_half) {
+        packRows(image, channels, static_cast<half*>(dst));
+    } else {
+        packRows(image, channels, static_cast<float*>(dst));
+    }
+
+    if (!persistent_) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    // Sourced from the bound unpack buffer, so this returns without waiting for the copy
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height,
+                    pixelFormat(channels), use_half ? GL_HALF_FLOAT : GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (persistent_) {
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    return true;
+}
+
+void StreamingTexture::ensureStorage(int width, int height, TextureUploadFormat format) {
+    if (texture_id_ && width == width_ && height == height_ && format == storage_format_) return;
+
+    // Immutable storage cannot be resized, so a new frame size gets a new texture
+    if (texture_id_) {
+        glDeleteTextures(1, &texture_id_);
+    }
+    glGenTextures(1, &texture_id_);
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    GLenum internal_format = (format == TextureUploadFormat::HALF16) ? GL_RGBA16F : GL_RGBA32F;
+    if (immutable_storage_) {
+        glTexStorage2D(GL_TEXTURE_2D, 1, internal_format, width, height);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    width_ = width;
+    height_ = height;
+    storage_format_ = format;
+}
+
+void* StreamingTexture::acquireBuffer(UploadBuffer& slot, size_t bytes) {
+    if (!persistent_) {
+        if (!slot.buffer) {
+            glGenBuffers(1, &slot.buffer);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        // Orphaning gives the driver fresh memory instead of stalling on the last transfer
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        slot.capacity = bytes;
+        return glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+
+    waitForFence(slot);
+
+    if (slot.capacity < bytes) {
+        releaseBuffer(slot);
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, flags);
+        slot.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+        slot.capacity = slot.mapped ? bytes : 0;
+        return slot.mapped;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    return slot.mapped;
+}
+
+void StreamingTexture::waitForFence(UploadBuffer& slot) {
+    if (!slot.fence) return;
+
+    GLsync fence = static_cast<GLsync>(slot.fence);
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+    }
+    glDeleteSync(fence);
+    slot.fence = nullptr;
+}
+
+void StreamingTexture::releaseBuffer(UploadBuffer& slot) {
+    waitForFence(slot);
+
+    if (slot.buffer) {
+        if (slot.mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    slot = UploadBuffer();
+}
@@ -0,0 +1,200 @@
+// Checks that IncrementalCompositor stays bit-identical to
+// Compositor::compositeLayers as layers, masks, modes and opacities change,
+// over 1-4 channels, both layouts, with and without clamping and partials.
+// Exits non-zero on failure; run through ctest.
+#include "exr_processor.h"
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace ImageProcessing;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++g_failures;
+    }
+}
+
+// Spans several 16K-pixel blocks, with a partial one at the end
+const int kWidth = 301;
+const int kHeight = 131;
+const int kLayers = 4;
+
+void fill(ImageData& image, std::mt19937& rng) {
+    std::uniform_real_distribution<float> value(-0.25f, 3.0f);
+    for (float& sample : image.data) sample = value(rng);
+}
+
+// Rewrites a small rectangle of one image, touching one or two blocks
+void touch(ImageData& image, std::mt19937& rng) {
+    std::uniform_real_distribution<float> value(-0.25f, 3.0f);
+    int x0 = static_cast<int>(rng() % (kWidth - 8));
+    int y0 = static_cast<int>(rng() % (kHeight - 4));
+    for (int y = y0; y < y0 + 4; ++y) {
+        for (int x = x0; x < x0 + 8; ++x) {
+            for (int c = 0; c < image.channels; ++c) image(x, y, c) = value(rng);
+        }
+    }
+}
+
+bool identical(const ImageData& a, const ImageData& b) {
+    return a.hasShape(b.width, b.height, b.channels, b.layout) && a.x_offset == b.x_offset &&
+           a.y_offset == b.y_offset && a.data.size() == b.data.size() &&
+           std::memcmp(a.data.data(), b.data.data(), a.data.size() * sizeof(float)) == 0;
+}
+
+struct Case {
+    PixelLayout layout;
+    bool clamp;
+    bool keep_partials;
+    unsigned seed;
+
+    std::string label() const {
+        return std::string(layout == PixelLayout::PLANAR ? "planar" : "interleaved") +
+               (clamp ? " clamp" : " hdr") + (keep_partials ? " partials" : " result-only") +
+               " seed " + std::to_string(seed);
+    }
+};
+
+void runCase(const Case& test) {
+    std::mt19937 rng(test.seed);
+    std::vector<ImageData> images(kLayers);
+    std::vector<ImageData> masks(kLayers);
+    std::vector<Compositor::Layer> layers(kLayers);
+    for (int i = 0; i < kLayers; ++i) {
+        images[i] = ImageData(kWidth, kHeight, 1 + static_cast<int>(rng() % 4), test.layout);
+        images[i].x_offset = 5;
+        images[i].y_offset = -3;
+        fill(images[i], rng);
+        layers[i] = {&images[i], static_cast<Compositor::BlendMode>(rng() % 10), 0.25f + 0.25f * (rng() % 4),
+                     nullptr};
+        if (rng() % 2) {
+            masks[i] = ImageData(kWidth, kHeight, 1 + static_cast<int>(rng() % 4), test.layout);
+            fill(masks[i], rng);
+            layers[i].mask = &masks[i];
+        }
+    }
+
+    IncrementalCompositor incremental(test.keep_partials);
+    ImageData reference;
+    for (int step = 0; step < 24; ++step) {
+        std::string what = test.label() + " step " + std::to_string(step);
+        std::vector<size_t> changed;
+        bool pixels_only = false;
+        if (step > 0) {
+            size_t layer = rng() % kLayers;
+            changed.push_back(layer);
+            switch (rng() % 4) {
+            case 0:
+                layers[layer].mode = static_cast<Compositor::BlendMode>(rng() % 10);
+                break;
+            case 1:
+                layers[layer].opacity = 0.25f * (rng() % 5);
+                break;
+            case 2:
+                if (layers[layer].mask) {
+                    touch(masks[layer], rng);
+                    pixels_only = true;
+                } else {
+                    masks[layer] = ImageData(kWidth, kHeight, 1, test.layout);
+                    fill(masks[layer], rng);
+                    layers[layer].mask = &masks[layer];
+                }
+                break;
+            default:
+                touch(images[layer], rng);
+                pixels_only = true;
+                break;
+            }
+        }
+
+        // Every other step tells the compositor which layer moved
+        bool ok = (step % 2) ? incremental.update(layers, changed, test.clamp)
+                             : incremental.composite(layers, test.clamp);
+        check(ok, what + ": incremental composite succeeds");
+        check(Compositor::compositeLayers(layers, reference, test.clamp), what + ": reference composite");
+        check(identical(incremental.result(), reference), what + ": bit-identical to compositeLayers");
+
+        const IncrementalCompositor::Stats& stats = incremental.lastStats();
+        if (pixels_only) {
+            check(!stats.full && stats.dirty_blocks < stats.blocks, what + ": a small edit redoes few blocks");
+        }
+    }
+
+    // Another clamp starts over and still matches
+    check(incremental.composite(layers, !test.clamp), test.label() + ": composite after clamp change");
+    check(Compositor::compositeLayers(layers, reference, !test.clamp), test.label() + ": reference after clamp change");
+    check(identical(incremental.result(), reference), test.label() + ": bit-identical after clamp change");
+}
+
+} // namespace
+
+int main() {
+    unsigned seed = 1;
+    for (PixelLayout layout : {PixelLayout::INTERLEAVED, PixelLayout::PLANAR}) {
+        for (bool clamp : {true, false}) {
+            for (bool keep_partials : {true, false}) {
+                for (int repeat = 0; repeat < 3; ++repeat) {
+                    runCase({layout, clamp, keep_partials, seed++});
+                }
+            }
+        }
+    }
+
+    // A layer that is the result itself is rejected rather than composited
+    ImageData image(kWidth, kHeight, 3);
+    std::mt19937 rng(99);
+    fill(image, rng);
+    IncrementalCompositor incremental;
+    std::vector<Compositor::Layer> layers = {{&image, Compositor::NORMAL, 1.0f, nullptr},
+                                             {&image, Compositor::SCREEN, 0.5f, nullptr}};
+    check(incremental.composite(layers), "plain stack composites");
+    layers[1].image = &incremental.result();
+    check(!incremental.composite(layers), "a stack reading result() is rejected");
+
+    // EXRProcessor with incremental compositing matches a processor without it,
+    // including when the output is one of its own passes
+    EXRProcessor plain;
+    EXRProcessor tracked;
+    tracked.setIncrementalCompositing(true);
+    for (EXRProcessor* processor : {&plain, &tracked}) {
+        std::mt19937 pass_rng(7);
+        for (const char* name : {"diffuse", "specular", "emission"}) {
+            processor->addRenderPass(name, kWidth, kHeight, 3);
+            fill(processor->getRenderPass(name)->image, pass_rng);
+        }
+    }
+    std::vector<PassLayer> stack = {PassLayer("diffuse"), PassLayer("specular", Compositor::SCREEN, 0.5f),
+                                    PassLayer("emission")};
+    for (int round = 0; round < 3; ++round) {
+        std::string what = "processor round " + std::to_string(round);
+        ImageData expected;
+        ImageData actual;
+        check(plain.compositeLayers(stack, expected), what + ": plain compositeLayers");
+        check(tracked.compositeLayers(stack, actual), what + ": incremental compositeLayers");
+        check(identical(actual, expected), what + ": processors agree");
+
+        plain.compositePasses({"diffuse", "specular", "emission"}, expected);
+        tracked.compositePasses({"diffuse", "specular", "emission"}, actual);
+        check(identical(actual, expected), what + ": compositePasses agree");
+
+        std::mt19937 edit_rng(round);
+        touch(plain.getRenderPass("specular")->image, edit_rng);
+        edit_rng.seed(round);
+        touch(tracked.getRenderPass("specular")->image, edit_rng);
+    }
+    ImageData& into_plain = plain.getRenderPass("diffuse")->image;
+    ImageData& into_tracked = tracked.getRenderPass("diffuse")->image;
+    check(plain.compositeLayers(stack, into_plain), "plain compositeLayers into a pass");
+    check(tracked.compositeLayers(stack, into_tracked), "incremental compositeLayers into a pass");
+    check(identical(into_tracked, into_plain), "compositing into a pass agrees");
+
+    if (g_failures == 0) std::cout << "incremental_compositor_test: all checks passed" << std::endl;
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+// Checks that scopes run on pool workers are attributed to the frame that
+// queued the work. Exits non-zero on failure; run through ctest.
+#include "profiler.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <thread>
+
+using namespace ImageProcessing;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++g_failures;
+    }
+}
+
+// Long enough that idle workers pick up some of the work
+void busyWork() {
+    ProfileScope scope("test.work");
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+// Events of the scope, with the threads they ran on
+std::vector<Profiler::Event> workEvents(std::set<int>& threads) {
+    std::vector<Profiler::Event> events;
+    for (const Profiler::Event& event : Profiler::global().events()) {
+        if (std::strcmp(event.name, "test.work") != 0) continue;
+        events.push_back(event);
+        threads.insert(event.thread);
+    }
+    return events;
+}
+
+void testParallelFor(ThreadPool& pool) {
+    Profiler::global().reset();
+    {
+        FrameScope frame_scope(7);
+        pool.parallelFor(0, 64, 1, [](int begin, int end) {
+            for (int i = begin; i < end; ++i) busyWork();
+        });
+    }
+
+    std::set<int> threads;
+    std::vector<Profiler::Event> events = workEvents(threads);
+    check(events.size() == 64, "parallelFor records one scope per index");
+    check(threads.size() > 1, "parallelFor ran on more than the calling thread");
+    for (const Profiler::Event& event : events) {
+        check(event.frame == 7, "parallelFor worker scope is attributed to frame 7");
+    }
+}
+
+void testTaskGroup(ThreadPool& pool, int max_concurrency) {
+    Profiler::global().reset();
+    {
+        TaskGroup group(max_concurrency, pool);
+        for (int frame = 0; frame < 4; ++frame) {
+            FrameScope frame_scope(frame);
+            for (int i = 0; i < 8; ++i) group.run(&busyWork);
+        }
+        // Waiting outside any frame must not relabel the tasks this thread runs
+        group.wait();
+    }
+
+    std::set<int> threads;
+    std::vector<Profiler::Event> events = workEvents(threads);
+    check(events.size() == 32, "task group records one scope per task");
+    check(threads.size() > 1, "task group ran on more than the calling thread");
+    int per_frame[4] = {0, 0, 0, 0};
+    for (const Profiler::Event& event : events) {
+        check(event.frame >= 0 && event.frame < 4, "task scope is attributed to a frame");
+        if (event.frame >= 0 && event.frame < 4) ++per_frame[event.frame];
+    }
+    for (int frame = 0; frame < 4; ++frame) {
+        check(per_frame[frame] == 8, "each frame gets the tasks queued under it");
+    }
+    check(Profiler::currentFrame() == -1, "the waiting thread's frame is restored");
+}
+
+} // namespace
+
+int main() {
+    Profiler::global().setEnabled(true);
+    ThreadPool pool(3);
+
+    testParallelFor(pool);
+    testTaskGroup(pool, 0);
+    testTaskGroup(pool, 2);
+
+    if (g_failures == 0) std::cout << "profiler_test: all checks passed" << std::endl;
+    return g_failures == 0 ? 0 : 1;
+}
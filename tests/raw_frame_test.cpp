@@ -0,0 +1,89 @@
+// Raw frames round-trip, and open() rejects pass records whose sizes do not
+// add up, including ones whose width * height * channels * sample size
+// wraps around to the stored byte count. Exits non-zero on failure; run
+// through ctest.
+#include "raw_frame.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace ImageProcessing;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++g_failures;
+    }
+}
+
+// The first pass record follows the 64-byte file header; width, height and
+// channels are its i32 fields after the 64-byte name
+const long kWidthOffset = 64 + 64;
+
+void writeDimensions(const std::string& path, int32_t width, int32_t height, int32_t channels) {
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    if (!file) return;
+    int32_t fields[3] = {width, height, channels};
+    std::fseek(file, kWidthOffset, SEEK_SET);
+    std::fwrite(fields, sizeof(int32_t), 3, file);
+    std::fclose(file);
+}
+
+} // namespace
+
+int main() {
+    const char* tmp = std::getenv("TMPDIR");
+    std::string path = std::string((tmp && *tmp) ? tmp : "/tmp") + "/scbw_raw_frame_" +
+                       std::to_string(static_cast<long>(getpid())) + ".scbwraw";
+
+    // 4 x 4 x 1 floats: 64 bytes of samples
+    ImageData image(4, 4, 1);
+    for (size_t i = 0; i < image.data.size(); ++i) image.data[i] = static_cast<float>(i);
+    check(saveRawFrame(path, "depth", image), "raw frame is written");
+
+    {
+        RawFrame frame;
+        ImageData loaded;
+        check(frame.open(path), "raw frame opens");
+        check(frame.readPass("depth", loaded, PixelLayout::INTERLEAVED) && loaded.data == image.data,
+              "pass round-trips");
+    }
+
+    // 80 * 107367629 * 536903681 = 2^62 + 16, so the product with 4-byte
+    // samples wraps to exactly the 64 bytes the record stores
+    writeDimensions(path, 80, 107367629, 536903681);
+    {
+        RawFrame frame;
+        check(!frame.open(path), "record whose size wraps around is rejected");
+        check(!frame.isOpen(), "rejected frame is closed");
+    }
+
+    // Large without wrapping, and simply inconsistent
+    writeDimensions(path, 1 << 30, 1 << 30, 4);
+    {
+        RawFrame frame;
+        check(!frame.open(path), "record larger than the file is rejected");
+    }
+    writeDimensions(path, 8, 4, 1);
+    {
+        RawFrame frame;
+        check(!frame.open(path), "record whose size does not match is rejected");
+    }
+
+    writeDimensions(path, 4, 4, 1);
+    {
+        RawFrame frame;
+        check(frame.open(path), "restored record opens again");
+    }
+    std::remove(path.c_str());
+
+    if (g_failures == 0) std::cout << "raw_frame_test: all checks passed" << std::endl;
+    return g_failures == 0 ? 0 : 1;
+}
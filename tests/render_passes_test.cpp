@@ -0,0 +1,87 @@
+// Saves a pass set with 1-, 3- and 4-channel passes through saveRenderPasses
+// and reads each file back. Exits non-zero on failure; run through ctest.
+#include "exr_processor.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace ImageProcessing;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++g_failures;
+    }
+}
+
+struct PassSpec {
+    const char* name;
+    int channels;
+};
+
+const PassSpec kPasses[] = {
+    {"beauty", 4}, {"depth", 1}, {"normal", 3}, {"albedo", 3}, {"specular", 3}, {"emission", 3},
+};
+
+// Eighths are exact in half and float, so the read-back compares exactly
+float sampleValue(int pass, int x, int y, int c) {
+    return static_cast<float>((pass * 7 + x * 3 + y * 5 + c) % 64) / 8.0f;
+}
+
+} // namespace
+
+int main() {
+    const char* tmp = std::getenv("TMPDIR");
+    std::string prefix = std::string((tmp && *tmp) ? tmp : "/tmp") + "/scbw_passes_" +
+                         std::to_string(static_cast<long>(getpid())) + "_";
+    const int width = 37;
+    const int height = 21;
+    const int pass_count = static_cast<int>(sizeof(kPasses) / sizeof(kPasses[0]));
+
+    EXRProcessor processor;
+    for (int p = 0; p < pass_count; ++p) {
+        processor.addRenderPass(kPasses[p].name, width, height, kPasses[p].channels);
+        RenderPass* pass = processor.getRenderPass(kPasses[p].name);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                for (int c = 0; c < kPasses[p].channels; ++c) {
+                    pass->image(x, y, c) = sampleValue(p, x, y, c);
+                }
+            }
+        }
+    }
+
+    check(processor.saveRenderPasses(prefix, 2), "saveRenderPasses writes every pass");
+
+    for (int p = 0; p < pass_count; ++p) {
+        std::string path = prefix + kPasses[p].name + ".exr";
+        std::vector<RenderPass> loaded;
+        bool ok = processor.loadMultiPlaneEXR(path, loaded);
+        check(ok && loaded.size() == 1, std::string("one layer read back from ") + path);
+        if (ok && loaded.size() == 1) {
+            const ImageData& image = loaded[0].image;
+            check(image.width == width && image.height == height && image.channels == kPasses[p].channels,
+                  std::string(kPasses[p].name) + " keeps its shape and channel count");
+
+            bool same = image.hasShape(width, height, kPasses[p].channels, image.layout);
+            for (int y = 0; y < height && same; ++y) {
+                for (int x = 0; x < width && same; ++x) {
+                    for (int c = 0; c < kPasses[p].channels && same; ++c) {
+                        same = image(x, y, c) == sampleValue(p, x, y, c);
+                    }
+                }
+            }
+            check(same, std::string(kPasses[p].name) + " pixels round-trip");
+        }
+        std::remove(path.c_str());
+    }
+
+    if (g_failures == 0) std::cout << "render_passes_test: all checks passed" << std::endl;
+    return g_failures == 0 ? 0 : 1;
+}
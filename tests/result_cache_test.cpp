@@ -0,0 +1,181 @@
+// Disk tier of ResultCache: blobs round-trip, corrupt blobs are dropped
+// rather than served, and concurrent inserts and finds keep the budget and
+// the stats consistent. Exits non-zero on failure; run through ctest.
+#include "result_cache.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace ImageProcessing;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++g_failures;
+    }
+}
+
+ImageData makeImage(int width, int height, int channels, float seed) {
+    ImageData image(width, height, channels, PixelLayout::PLANAR);
+    image.x_offset = -2;
+    image.y_offset = 3;
+    for (size_t i = 0; i < image.data.size(); ++i) {
+        image.data[i] = seed + static_cast<float>(i % 97) / 97.0f;
+    }
+    return image;
+}
+
+bool sameImage(const ImageData& a, const ImageData& b) {
+    return a.hasShape(b.width, b.height, b.channels, b.layout) && a.x_offset == b.x_offset &&
+           a.y_offset == b.y_offset && a.data == b.data;
+}
+
+bool exists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+void removeDirectory(const std::string& directory) {
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") std::remove((directory + "/" + name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(directory.c_str());
+}
+
+// Overwrites one int32 of a blob's header (offsets past the 8-byte magic)
+void patchHeader(const std::string& path, long offset, int32_t value) {
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    if (!file) return;
+    std::fseek(file, offset, SEEK_SET);
+    std::fwrite(&value, sizeof(value), 1, file);
+    std::fclose(file);
+}
+
+void testRoundTrip(const std::string& directory) {
+    ImageData image = makeImage(17, 9, 3, 1.0f);
+    {
+        ResultCache cache;
+        check(cache.setDiskCache(directory, size_t(1) << 24), "disk cache enables");
+        cache.insert(1, image);
+    }
+
+    // A new cache adopts the blob and serves it from disk, then from memory
+    ResultCache cache;
+    cache.setDiskCache(directory, size_t(1) << 24);
+    ResultCache::ResultPtr found = cache.find(1);
+    check(found && sameImage(*found, image), "blob round-trips through the disk tier");
+    check(cache.find(1) != nullptr, "disk hit is promoted to memory");
+    ResultCache::Stats stats = cache.stats();
+    check(stats.disk_hits == 1 && stats.memory_hits == 1 && stats.misses == 0, "round-trip stats");
+}
+
+void testCorruptBlobs(const std::string& directory) {
+    struct Corruption {
+        const char* what;
+        long offset;
+        int32_t value;
+    };
+    const Corruption corruptions[] = {
+        {"huge width", 8, 1 << 30},
+        {"huge height", 12, 1 << 30},
+        {"unknown layout", 20, 7},
+        {"width that does not match the size", 8, 18},
+    };
+
+    ResultCache::Key key = 100;
+    for (const Corruption& corruption : corruptions) {
+        {
+            ResultCache cache;
+            cache.setDiskCache(directory, size_t(1) << 24);
+            cache.insert(key, makeImage(8, 4, 3, 0.5f));
+        }
+        std::string path = directory + "/" + ResultCache::keyString(key) + ".scbw";
+        patchHeader(path, corruption.offset, corruption.value);
+
+        ResultCache cache;
+        cache.setDiskCache(directory, size_t(1) << 24);
+        check(cache.find(key) == nullptr, std::string("blob with ") + corruption.what + " is not served");
+        check(!exists(path), std::string("blob with ") + corruption.what + " is deleted");
+        check(cache.stats().misses == 1, std::string("blob with ") + corruption.what + " counts as a miss");
+        ++key;
+    }
+}
+
+void testConcurrentAccess(const std::string& directory) {
+    const int keys = 48;
+    ImageData sample = makeImage(64, 32, 4, 0.0f);
+    size_t blob_bytes = sample.data.size() * sizeof(float) + 64;
+    size_t budget = blob_bytes * 16;
+
+    ResultCache cache(0);   // No memory tier, so every find goes to disk
+    cache.setDiskCache(directory, budget);
+
+    std::atomic<int> wrong(0);
+    std::atomic<int> lookups(0);
+    TaskGroup group;
+    for (int t = 0; t < 8; ++t) {
+        group.run([&, t]() {
+            for (int i = 0; i < 200; ++i) {
+                // Each key is stored, then looked up, while other threads evict it
+                int k = (i / 2 + t * 5) % keys;
+                if (i % 2 == 0) {
+                    cache.insert(1000 + k, makeImage(64, 32, 4, static_cast<float>(k)));
+                } else {
+                    lookups.fetch_add(1);
+                    ResultCache::ResultPtr found = cache.find(1000 + k);
+                    if (found && !sameImage(*found, makeImage(64, 32, 4, static_cast<float>(k)))) {
+                        wrong.fetch_add(1);
+                    }
+                }
+            }
+        });
+    }
+    group.wait();
+
+    ResultCache::Stats stats = cache.stats();
+    check(wrong.load() == 0, "concurrent finds return the blob stored under their key");
+    check(stats.memory_hits + stats.disk_hits + stats.misses == static_cast<size_t>(lookups.load()),
+          "every concurrent lookup is counted once");
+    check(stats.disk_hits > 0, "concurrent finds hit the disk tier");
+    check(cache.diskBytesUsed() <= budget, "concurrent inserts stay inside the disk budget");
+}
+
+} // namespace
+
+int main() {
+    ThreadPool::global().setThreadCount(4);
+
+    const char* tmp = std::getenv("TMPDIR");
+    std::string pattern = std::string((tmp && *tmp) ? tmp : "/tmp") + "/scbw_result_cache_XXXXXX";
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back('\0');
+    if (!mkdtemp(buffer.data())) {
+        std::cerr << "Failed to create a scratch directory" << std::endl;
+        return 1;
+    }
+    std::string directory = buffer.data();
+
+    testRoundTrip(directory);
+    testCorruptBlobs(directory);
+    testConcurrentAccess(directory);
+    removeDirectory(directory);
+
+    if (g_failures == 0) std::cout << "result_cache_test: all checks passed" << std::endl;
+    return g_failures == 0 ? 0 : 1;
+}